@@ -0,0 +1,958 @@
+#include <graphics/engine.hpp>
+#include <render/mesh_file.hpp>
+#include <render/transform_batch.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr float kPi{3.14159265358979f};
+
+/// Benchmark parameters, every one of them can be set from the command line.
+struct BenchmarkOptions final {
+  /// Measured frames, rendered after the warm-up frames.
+  std::uint32_t frames{1000};
+  std::uint32_t warmupFrames{100};
+  /// Workload: N instances split evenly into M x K draws of M meshes with K
+  /// pipelines.
+  std::uint32_t instances{65536};
+  std::uint32_t meshes{2};
+  std::uint32_t pipelines{1};
+  std::uint32_t recordingThreads{std::thread::hardware_concurrency() / 2};
+  /// Frames recorded ahead of the GPU.
+  std::uint32_t framesInFlight{2};
+  /// Uploads and draws the meshes in the PackedVertex layout.
+  bool packedVertices{false};
+  /// Writes the meshes as mesh files into the directory and uploads them from
+  /// the memory mapped files, the way meshes loaded from disk are uploaded.
+  std::string meshDirectory{};
+  /// Culls the instances against the frustum in a compute pass, the draws
+  /// become indirect draws of the visible instances. Needs one pipeline.
+  bool culling{false};
+  /// Reads the instances from a bindless storage buffer selected by a push
+  /// constant instead of the instance vertex binding. Excludes culling.
+  bool bindless{false};
+  /// Paces the frames with a timeline semaphore where supported, fences
+  /// otherwise.
+  bool timelineSemaphores{true};
+  /// Grid scale, roughly 1 / S^2 of the instances are in the view.
+  float sceneScale{1.0f};
+  /// Spins the instances every frame. Their matrices are written by the
+  /// threaded TransformBatch straight into the uniform ring, which the draws
+  /// read the instances from. Excludes culling and bindless.
+  bool animate{false};
+  /// Pins the GPU by index or UUID, see ContextOptions. The highest rated
+  /// GPU is used otherwise.
+  std::optional<std::uint32_t> deviceIndex{};
+  std::string deviceUuid{};
+  /// Renders without a window, so vsync and the compositor don't limit the
+  /// frame rate. Windowed runs render into a hidden window.
+  bool offscreen{true};
+  /// Copies every offscreen frame back to the host.
+  bool readback{false};
+  /// Draws through the render graph of the Context: one graphics pass renders
+  /// into the imported frame image with a transient depth image. Excludes
+  /// culling and the readback.
+  bool renderGraph{false};
+  std::string shaderDirectory{"../../../shaders"};
+  /// Measures the model matrix updates of the instances on the CPU instead
+  /// of rendering, once per frame with every transform kernel. The threads
+  /// run the parallel kernel.
+  bool transforms{false};
+  /// JSON report file, "-" prints it to stdout after the engine log.
+  std::string output{"render_benchmark.json"};
+};
+
+struct BenchmarkResult final {
+  double framesPerSecond{};
+  double cpuMillisecondsPerFrame{};
+  double gpuMillisecondsPerFrame{};
+  double uploadMegabytesPerSecond{};
+  double pipelineCreationMilliseconds{};
+  /// True if the frames were paced with a timeline semaphore.
+  bool timelineSemaphores{false};
+  render::FrameStatsReport frameStats{};
+};
+
+/// Milliseconds per update of all the instance matrices.
+struct TransformBenchmarkResult final {
+  /// glm::translate * glm::mat4_cast * glm::scale per instance.
+  double glmMilliseconds{};
+  double scalarMilliseconds{};
+  double simdMilliseconds{};
+  /// SIMD kernel split over the worker threads.
+  double threadedMilliseconds{};
+};
+
+void PrintUsage() {
+  std::cerr << "Usage: render_benchmark [--frames F] [--warmup W] "
+               "[--instances N] [--meshes M] [--pipelines K] [--threads T] "
+               "[--frames-in-flight F] [--packed 0|1] [--mesh-files DIR] "
+               "[--culling 0|1] [--bindless 0|1] [--timeline 0|1] "
+               "[--scene-scale S] [--animate 0|1] [--offscreen 0|1] "
+               "[--readback 0|1] "
+               "[--render-graph 0|1] [--device INDEX] [--device-uuid UUID] "
+               "[--shaders DIR] "
+               "[--transforms 0|1] [--output FILE]"
+            << std::endl;
+}
+
+/// Parses the arguments into the options.
+///
+/// @return False if the arguments are invalid.
+bool ParseArguments(int argc, char **argv, BenchmarkOptions &options) {
+  for (int i{1}; i < argc; ++i) {
+    const std::string argument{argv[i]};
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const std::string value{argv[++i]};
+    try {
+      if (argument == "--frames") {
+        options.frames = static_cast<std::uint32_t>(std::stoul(value));
+      } else if (argument == "--warmup") {
+        options.warmupFrames = static_cast<std::uint32_t>(std::stoul(value));
+      } else if (argument == "--instances") {
+        options.instances = static_cast<std::uint32_t>(std::stoul(value));
+      } else if (argument == "--meshes") {
+        options.meshes = static_cast<std::uint32_t>(std::stoul(value));
+      } else if (argument == "--pipelines") {
+        options.pipelines = static_cast<std::uint32_t>(std::stoul(value));
+      } else if (argument == "--threads") {
+        options.recordingThreads =
+            static_cast<std::uint32_t>(std::stoul(value));
+      } else if (argument == "--frames-in-flight") {
+        options.framesInFlight = static_cast<std::uint32_t>(std::stoul(value));
+      } else if (argument == "--packed") {
+        options.packedVertices = std::stoul(value) != 0;
+      } else if (argument == "--mesh-files") {
+        options.meshDirectory = value;
+      } else if (argument == "--culling") {
+        options.culling = std::stoul(value) != 0;
+      } else if (argument == "--bindless") {
+        options.bindless = std::stoul(value) != 0;
+      } else if (argument == "--timeline") {
+        options.timelineSemaphores = std::stoul(value) != 0;
+      } else if (argument == "--scene-scale") {
+        options.sceneScale = std::stof(value);
+      } else if (argument == "--animate") {
+        options.animate = std::stoul(value) != 0;
+      } else if (argument == "--offscreen") {
+        options.offscreen = std::stoul(value) != 0;
+      } else if (argument == "--readback") {
+        options.readback = std::stoul(value) != 0;
+      } else if (argument == "--render-graph") {
+        options.renderGraph = std::stoul(value) != 0;
+      } else if (argument == "--device") {
+        options.deviceIndex = static_cast<std::uint32_t>(std::stoul(value));
+      } else if (argument == "--device-uuid") {
+        options.deviceUuid = value;
+      } else if (argument == "--shaders") {
+        options.shaderDirectory = value;
+      } else if (argument == "--transforms") {
+        options.transforms = std::stoul(value) != 0;
+      } else if (argument == "--output") {
+        options.output = value;
+      } else {
+        return false;
+      }
+    } catch (const std::exception &) {
+      return false;
+    }
+  }
+  return options.frames > 0 && options.framesInFlight > 0 &&
+         options.meshes > 0 && options.pipelines > 0 &&
+         options.instances >= options.meshes * options.pipelines &&
+         options.sceneScale > 0.0f &&
+         (!options.culling || options.pipelines == 1) &&
+         !(options.culling && options.bindless) &&
+         !(options.animate && (options.culling || options.bindless)) &&
+         !(options.renderGraph && (options.culling || options.readback));
+}
+
+/// Vertex and index storage of a generated mesh.
+struct MeshData final {
+  std::vector<render::Vertex> vertices{};
+  std::vector<render::PackedVertex> packedVertices{};
+  std::vector<std::uint16_t> indices{};
+};
+
+/// Creates a regular polygon as a triangle fan around its center, mesh i of
+/// the benchmark has 3 + i % 16 sides.
+MeshData CreatePolygonMesh(std::uint32_t sideCount) {
+  MeshData mesh{};
+  mesh.vertices.push_back({{0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}});
+  for (std::uint32_t i{0}; i < sideCount; ++i) {
+    const float angle = 2.0f * kPi * i / sideCount;
+    mesh.vertices.push_back(
+        {{0.5f * std::cos(angle), 0.5f * std::sin(angle)},
+         {0.5f + 0.5f * std::cos(angle), 0.5f + 0.5f * std::sin(angle), 0.5f}});
+    mesh.indices.push_back(0);
+    mesh.indices.push_back(static_cast<std::uint16_t>(1 + i));
+    mesh.indices.push_back(static_cast<std::uint16_t>(1 + (i + 1) % sideCount));
+  }
+  return mesh;
+}
+
+/// Places the instances on a square grid covering [-S, S] x [-S, S].
+std::vector<render::InstanceData> CreateInstances(std::uint32_t count,
+                                                  float scale) {
+  const auto gridSize = static_cast<std::uint32_t>(
+      std::ceil(std::sqrt(static_cast<double>(count))));
+  const float cellSize = 2.0f * scale / gridSize;
+  std::vector<render::InstanceData> instances{};
+  instances.reserve(count);
+  for (std::uint32_t i{0}; i < count; ++i) {
+    const auto x = i % gridSize;
+    const auto y = i / gridSize;
+    const glm::vec3 position{-scale + (x + 0.5f) * cellSize,
+                             -scale + (y + 0.5f) * cellSize, 0.0f};
+    render::InstanceData instance{};
+    instance.model = glm::scale(glm::translate(glm::mat4(1.0f), position),
+                                glm::vec3(0.8f * cellSize));
+    instance.color = glm::vec4(static_cast<float>(x) / gridSize,
+                               static_cast<float>(y) / gridSize, 1.0f, 1.0f);
+    instances.push_back(instance);
+  }
+  return instances;
+}
+
+/// Compute pass culling the instances of the draws, see
+/// shaders/shader_cull.comp.
+struct CullingPass final {
+  VkPipeline pipeline{VK_NULL_HANDLE};
+  VkPipelineLayout pipelineLayout{VK_NULL_HANDLE};
+  VkDescriptorSet descriptorSet{VK_NULL_HANDLE};
+  /// Draw commands with zero instance counts, copied over the indirect
+  /// buffer before every dispatch.
+  VkBuffer commandTemplates{VK_NULL_HANDLE};
+  VkBuffer indirectBuffer{VK_NULL_HANDLE};
+  VkDeviceSize indirectSize{};
+  /// Visible instances, the instance buffer of the draws.
+  VkBuffer instanceBuffer{VK_NULL_HANDLE};
+  std::uint32_t instanceCount{};
+  std::uint32_t drawCount{};
+};
+
+/// Creates the culling pass of the draw items, every draw gets an indirect
+/// command drawing its visible instances.
+CullingPass
+CreateCullingPass(render::Context &context, const BenchmarkOptions &options,
+                  const std::vector<render::InstanceData> &instances,
+                  const std::vector<render::DrawItem> &drawItems,
+                  float meshRadius) {
+  if (!context.GetDrawIndirectSupport().firstInstance) {
+    throw std::runtime_error("failed to create culling pass, the device "
+                             "doesn't support indirect first instances!");
+  }
+  CullingPass pass{};
+  pass.instanceCount = static_cast<std::uint32_t>(instances.size());
+  pass.drawCount = static_cast<std::uint32_t>(drawItems.size());
+
+  // The draws cover the instances in any order, cull instance i is
+  // instance i:
+  std::vector<render::CullInstance> cullInstances(instances.size());
+  std::vector<VkDrawIndexedIndirectCommand> commands{};
+  for (std::uint32_t draw{0}; draw < pass.drawCount; ++draw) {
+    const auto &item = drawItems[draw];
+    for (std::uint32_t i{item.firstInstance};
+         i < item.firstInstance + item.instanceCount; ++i) {
+      cullInstances[i] =
+          render::GetCullInstance(instances[i], meshRadius, draw);
+    }
+    render::MeshRange mesh{};
+    mesh.firstIndex = item.firstIndex;
+    mesh.indexCount = item.indexCount;
+    mesh.vertexOffset = item.vertexOffset;
+    commands.push_back(render::GetDrawCommand(mesh, 0, item.firstInstance));
+  }
+  const auto instanceBytes =
+      render::AsBytes(render::Span<const render::InstanceData>(instances));
+  const auto commandBytes = render::AsBytes(
+      render::Span<const VkDrawIndexedIndirectCommand>(commands));
+  pass.indirectSize = commandBytes.size();
+
+  render::StorageBufferOptions instancesOptions{};
+  instancesOptions.data = instanceBytes;
+  const auto instanceStorage =
+      context.GetBuffer(context.CreateStorageBuffer(instancesOptions));
+  render::StorageBufferOptions cullInstancesOptions{};
+  cullInstancesOptions.data =
+      render::AsBytes(render::Span<const render::CullInstance>(cullInstances));
+  const auto cullInstanceStorage =
+      context.GetBuffer(context.CreateStorageBuffer(cullInstancesOptions));
+  render::StorageBufferOptions templatesOptions{};
+  templatesOptions.data = commandBytes;
+  templatesOptions.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  pass.commandTemplates =
+      context.GetBuffer(context.CreateStorageBuffer(templatesOptions));
+  render::StorageBufferOptions indirectOptions{};
+  indirectOptions.size = commandBytes.size();
+  indirectOptions.usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+  pass.indirectBuffer =
+      context.GetBuffer(context.CreateStorageBuffer(indirectOptions));
+  render::StorageBufferOptions visibleOptions{};
+  visibleOptions.size = instanceBytes.size();
+  visibleOptions.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+  pass.instanceBuffer =
+      context.GetBuffer(context.CreateStorageBuffer(visibleOptions));
+
+  // Binding 0 is the uniform ring, bindings 1-4 the storage buffers:
+  render::DescriptorSetLayoutOptions layoutOptions{};
+  layoutOptions.bindings.push_back(
+      {0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1,
+       VK_SHADER_STAGE_COMPUTE_BIT, nullptr});
+  for (std::uint32_t binding{1}; binding <= 4; ++binding) {
+    layoutOptions.bindings.push_back({binding,
+                                      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                                      VK_SHADER_STAGE_COMPUTE_BIT, nullptr});
+  }
+  const auto descriptorSetLayout = context.GetDescriptorSetLayout(
+      context.CreateDescriptorSetLayout(layoutOptions));
+  render::PipelineLayoutOptions pipelineLayoutOptions{};
+  pipelineLayoutOptions.descriptorSetLayout = descriptorSetLayout;
+  pipelineLayoutOptions.pushConstantRanges.push_back(
+      {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(std::uint32_t)});
+  pass.pipelineLayout = context.GetPipelineLayout(
+      context.CreatePipelineLayout(pipelineLayoutOptions));
+
+  const auto shaderCode =
+      graphics::MapFile(options.shaderDirectory + "/cull.spv");
+  render::ComputePipelineOptions pipelineOptions{};
+  pipelineOptions.computeShader =
+      context.CreateShaderModule(shaderCode.GetData());
+  pipelineOptions.pipelineLayout = pass.pipelineLayout;
+  pass.pipeline =
+      context.GetPipeline(context.CreateComputePipeline(pipelineOptions));
+
+  render::DescriptorPoolOptions poolOptions{};
+  poolOptions.poolSizes.push_back(
+      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1});
+  poolOptions.poolSizes.push_back({VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4});
+  poolOptions.maxSets = 1;
+  render::DescriptorSetOptions setOptions{};
+  setOptions.descriptorPool =
+      context.GetDescriptorPool(context.CreateDescriptorPool(poolOptions));
+  setOptions.descriptorSetLayout = descriptorSetLayout;
+  pass.descriptorSet = context.CreateDescriptorSet(setOptions);
+  const std::array<VkBuffer, 5> buffers{
+      context.GetUniformRingBuffer(), instanceStorage, cullInstanceStorage,
+      pass.indirectBuffer, pass.instanceBuffer};
+  for (std::uint32_t binding{0}; binding < buffers.size(); ++binding) {
+    render::UpdateDescriptorSetOptions updateOptions{};
+    updateOptions.descriptorSet = pass.descriptorSet;
+    updateOptions.binding = binding;
+    updateOptions.descriptorType =
+        binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC
+                     : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    updateOptions.uniformBuffer = buffers[binding];
+    updateOptions.range =
+        binding == 0 ? sizeof(render::UniformBufferObject) : VK_WHOLE_SIZE;
+    context.UpdateDescriptorSet(updateOptions);
+  }
+  return pass;
+}
+
+BenchmarkResult RunBenchmark(const BenchmarkOptions &options) {
+  render::ContextOptions contextOptions{};
+  contextOptions.enableValidationLayers = false;
+  contextOptions.title = "Render Benchmark";
+  contextOptions.windowVisible = false;
+  contextOptions.offscreen = options.offscreen;
+  contextOptions.offscreenReadback = options.readback;
+  contextOptions.recordingThreadCount = options.recordingThreads;
+  contextOptions.framesInFlight = options.framesInFlight;
+  contextOptions.gpuProfiling = true;
+  contextOptions.frameStatsCapacity = options.frames;
+  contextOptions.bindless = options.bindless;
+  contextOptions.timelineSemaphores = options.timelineSemaphores;
+  contextOptions.deviceIndex = options.deviceIndex;
+  contextOptions.deviceUuid = options.deviceUuid;
+  if (options.animate) {
+    contextOptions.uniformRingFrameSize +=
+        static_cast<VkDeviceSize>(options.instances) *
+        sizeof(render::InstanceData);
+  }
+  render::Context context{};
+  context.Initialize(contextOptions);
+  if (options.bindless && !context.IsBindlessEnabled()) {
+    throw std::runtime_error("failed to run bindless benchmark, the device "
+                             "doesn't support descriptor indexing!");
+  }
+
+  render::RenderPassOptions renderPassOptions{};
+  renderPassOptions.format = context.GetSwapChainImageFormat();
+  renderPassOptions.depthFormat = context.GetDepthFormat();
+  const auto renderPassHandle = context.CreateRenderPass(renderPassOptions);
+  const auto renderPass = context.GetRenderPass(renderPassHandle);
+
+  // The graph is declared for the swapchain extent, so it is declared again
+  // whenever the swapchain is recreated. Its pass draws with the options of
+  // the current frame:
+  render::RecordCommandBufferOptions graphDrawOptions{};
+  render::RenderGraphResource graphFrameImage{};
+  render::RenderGraphPass graphScenePass{};
+  const auto declareRenderGraph = [&context, &graphDrawOptions,
+                                   &graphFrameImage, &graphScenePass] {
+    auto &graph = context.GetRenderGraph();
+    graph.Reset();
+    const auto extent = context.GetSwapChainExtent();
+    render::RenderGraphImportedImageOptions frameImageOptions{};
+    frameImageOptions.format = context.GetSwapChainImageFormat();
+    frameImageOptions.extent = extent;
+    frameImageOptions.finalLayout = context.GetFrameImageLayout();
+    graphFrameImage = graph.ImportImage(frameImageOptions);
+    render::RenderGraphImageOptions depthImageOptions{};
+    depthImageOptions.format = context.GetDepthFormat();
+    depthImageOptions.extent = extent;
+    depthImageOptions.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    const auto depthImage = graph.CreateImage(depthImageOptions);
+
+    render::RenderGraphPassOptions passOptions{};
+    passOptions.name = "Scene";
+    render::RenderGraphAccess colorAccess{};
+    colorAccess.resource = graphFrameImage;
+    colorAccess.usage = render::RenderGraphUsage::ColorAttachment;
+    colorAccess.clear = true;
+    render::RenderGraphAccess depthAccess{};
+    depthAccess.resource = depthImage;
+    depthAccess.usage = render::RenderGraphUsage::DepthAttachment;
+    depthAccess.clear = true;
+    depthAccess.clearValue.depthStencil = {1.0f, 0};
+    passOptions.accesses = {colorAccess, depthAccess};
+    passOptions.record = [&context, &graphDrawOptions](
+                             const render::RenderGraphPassContext &pass) {
+      auto drawOptions = graphDrawOptions;
+      drawOptions.commandBuffer = pass.commandBuffer;
+      drawOptions.renderPass = pass.renderPass;
+      context.RecordDraws(drawOptions);
+    };
+    graphScenePass = graph.AddPass(std::move(passOptions));
+    context.CompileRenderGraph();
+  };
+  if (options.renderGraph) {
+    declareRenderGraph();
+  }
+  render::DescriptorSetLayoutOptions descriptorSetLayoutOptions{};
+  descriptorSetLayoutOptions.binding = 0;
+  descriptorSetLayoutOptions.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  descriptorSetLayoutOptions.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  const auto descriptorSetLayout = context.GetDescriptorSetLayout(
+      context.CreateDescriptorSetLayout(descriptorSetLayoutOptions));
+  render::PipelineLayoutOptions pipelineLayoutOptions{};
+  pipelineLayoutOptions.descriptorSetLayout = descriptorSetLayout;
+  if (options.bindless) {
+    pipelineLayoutOptions.descriptorSetLayouts = {
+        descriptorSetLayout, context.GetBindlessSetLayout()};
+    pipelineLayoutOptions.pushConstantRanges = {
+        {VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(std::uint32_t)}};
+  }
+  const auto pipelineLayout = context.GetPipelineLayout(
+      context.CreatePipelineLayout(pipelineLayoutOptions));
+
+  // All pipelines share the state, they are still separate pipeline objects
+  // bound by separate draws:
+  const auto vertexShaderCode = graphics::MapFile(
+      options.shaderDirectory +
+      (options.bindless ? "/vert_bindless.spv" : "/vert_instanced.spv"));
+  const auto fragmentShaderCode =
+      graphics::MapFile(options.shaderDirectory + "/frag.spv");
+  render::GraphicsPipelineOptions pipelineOptions{};
+  pipelineOptions.pipelineLayout = pipelineLayout;
+  // The graph pass has the attachments of the render pass, but it is a render
+  // pass of its own:
+  pipelineOptions.renderPass =
+      options.renderGraph
+          ? context.GetRenderGraph().GetRenderPass(graphScenePass)
+          : renderPass;
+  pipelineOptions.vertexShader =
+      context.CreateShaderModule(vertexShaderCode.GetData());
+  pipelineOptions.fragmentShader =
+      context.CreateShaderModule(fragmentShaderCode.GetData());
+  pipelineOptions.viewportExtent = context.GetSwapChainExtent();
+  pipelineOptions.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  pipelineOptions.polygonMode = VK_POLYGON_MODE_FILL;
+  pipelineOptions.vertexFormat = options.packedVertices
+                                     ? render::VertexFormat::Packed
+                                     : render::VertexFormat::Float;
+  pipelineOptions.instanced = !options.bindless;
+  pipelineOptions.depthTest = true;
+  const auto asyncPipelines = context.CreateGraphicsPipelinesAsync(
+      std::vector<render::GraphicsPipelineOptions>(options.pipelines,
+                                                   pipelineOptions));
+  std::vector<VkPipeline> pipelines{};
+  for (const auto &pipeline : asyncPipelines) {
+    pipelines.push_back(pipeline.Wait());
+  }
+  context.CreateSwapChainFramebuffers(renderPassHandle);
+
+  // The upload rate covers the buffer creation and the staging copies:
+  std::vector<MeshData> meshes{};
+  for (std::uint32_t i{0}; i < options.meshes; ++i) {
+    meshes.push_back(CreatePolygonMesh(3 + i % 16));
+    if (options.packedVertices) {
+      meshes.back().packedVertices =
+          render::PackVertices(meshes.back().vertices);
+    }
+  }
+  std::vector<render::MeshFile> meshFiles(
+      options.meshDirectory.empty() ? 0 : meshes.size());
+  render::MeshBufferOptions meshBufferOptions{};
+  VkDeviceSize uploadBytes{0};
+  for (std::size_t i{0}; i < meshes.size(); ++i) {
+    render::Mesh view{};
+    if (options.packedVertices) {
+      view.packedVertices = meshes[i].packedVertices;
+    } else {
+      view.vertices = meshes[i].vertices;
+    }
+    view.indices = meshes[i].indices;
+    if (!meshFiles.empty()) {
+      const auto path =
+          options.meshDirectory + "/mesh_" + std::to_string(i) + ".bin";
+      render::WriteMeshFile(path, view);
+      meshFiles[i].Open(path);
+      view = meshFiles[i].GetMesh();
+    }
+    uploadBytes += view.GetVertexCount() * render::GetVertexSize(
+                                               view.GetVertexFormat()) +
+                   view.indices.size_bytes();
+    meshBufferOptions.meshes.push_back(view);
+  }
+  const auto instances = CreateInstances(options.instances, options.sceneScale);
+  render::InstanceBufferOptions instanceBufferOptions{};
+  instanceBufferOptions.instances = instances;
+  uploadBytes += instanceBufferOptions.instances.size_bytes();
+  const auto uploadStart = std::chrono::steady_clock::now();
+  const auto meshBuffer = context.CreateMeshBuffer(meshBufferOptions);
+  VkBuffer instanceBuffer{VK_NULL_HANDLE};
+  std::uint32_t bindlessInstanceBuffer{};
+  if (options.bindless) {
+    render::StorageBufferOptions storageOptions{};
+    storageOptions.data = render::AsBytes(instanceBufferOptions.instances);
+    bindlessInstanceBuffer = context.AddBindlessStorageBuffer(
+        context.CreateStorageBuffer(storageOptions));
+  } else {
+    instanceBuffer =
+        context.GetBuffer(context.CreateInstanceBuffer(instanceBufferOptions));
+  }
+  context.FlushUploads();
+  context.WaitIdle();
+  const std::chrono::duration<double> uploadTime =
+      std::chrono::steady_clock::now() - uploadStart;
+
+  // Draw d uses mesh d % M and pipeline d / M, so every pipeline is bound
+  // once per frame. The draws are sorted front to back by their first
+  // instance within a pipeline:
+  const auto view = glm::lookAt(glm::vec3(0.0f, 0.0f, 2.5f), glm::vec3(0.0f),
+                                glm::vec3(0.0f, 1.0f, 0.0f));
+  const auto drawCount = options.meshes * options.pipelines;
+  std::vector<render::DrawItem> drawItems{};
+  for (std::uint32_t draw{0}; draw < drawCount; ++draw) {
+    const auto &mesh = meshBuffer.meshes[draw % options.meshes];
+    const auto firstInstance = static_cast<std::uint32_t>(
+        static_cast<std::uint64_t>(options.instances) * draw / drawCount);
+    const auto endInstance = static_cast<std::uint32_t>(
+        static_cast<std::uint64_t>(options.instances) * (draw + 1) / drawCount);
+    render::DrawItem item{};
+    item.vertexBuffer = meshBuffer.vertexBuffer;
+    item.indexBuffer = meshBuffer.indexBuffer;
+    item.indexType = meshBuffer.indexType;
+    item.instanceBuffer = instanceBuffer;
+    item.indexCount = mesh.indexCount;
+    item.instanceCount = endInstance - firstInstance;
+    item.firstIndex = mesh.firstIndex;
+    item.vertexOffset = mesh.vertexOffset;
+    item.firstInstance = firstInstance;
+    item.pipeline = pipelines[draw / options.meshes];
+    item.depth = render::GetViewDepth(view * instances[firstInstance].model,
+                                      glm::vec3(0.0f));
+    drawItems.push_back(item);
+  }
+  render::SortDrawItems(drawItems);
+
+  // The animated instances spin around their centers, the grid matrices are
+  // translations and uniform scales:
+  render::TransformBatch transformBatch{};
+  render::ThreadPool transformThreads{};
+  if (options.animate) {
+    transformBatch.Reserve(instances.size());
+    for (const auto &instance : instances) {
+      transformBatch.Add(glm::vec3(instance.model[3]),
+                         glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+                         glm::vec3(instance.model[0][0]));
+    }
+    render::ThreadPoolOptions threadOptions{};
+    threadOptions.threadCount = std::max(options.recordingThreads, 1U);
+    transformThreads.Initialize(threadOptions);
+  }
+  CullingPass cullingPass{};
+  if (options.culling) {
+    float meshRadius{0.0f};
+    for (const auto &mesh : meshes) {
+      meshRadius =
+          std::max(meshRadius, render::GetBoundingRadius(mesh.vertices));
+    }
+    cullingPass =
+        CreateCullingPass(context, options, instances, drawItems, meshRadius);
+  }
+
+  render::DescriptorPoolOptions descriptorPoolOptions{};
+  descriptorPoolOptions.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  descriptorPoolOptions.descriptorCount = 1;
+  render::DescriptorSetOptions descriptorSetOptions{};
+  descriptorSetOptions.descriptorPool = context.GetDescriptorPool(
+      context.CreateDescriptorPool(descriptorPoolOptions));
+  descriptorSetOptions.descriptorSetLayout = descriptorSetLayout;
+  const auto descriptorSet = context.CreateDescriptorSet(descriptorSetOptions);
+  render::UpdateDescriptorSetOptions updateDescriptorSetOptions{};
+  updateDescriptorSetOptions.descriptorSet = descriptorSet;
+  updateDescriptorSetOptions.descriptorType =
+      VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  updateDescriptorSetOptions.uniformBuffer = context.GetUniformRingBuffer();
+  updateDescriptorSetOptions.range = sizeof(render::UniformBufferObject);
+  context.UpdateDescriptorSet(updateDescriptorSetOptions);
+
+  // The animation only depends on the frame number, so every run renders
+  // exactly the same frames:
+  render::UniformBufferObject ubo{};
+  ubo.model = glm::mat4(1.0f);
+  ubo.view = view;
+  const auto extent = context.GetSwapChainExtent();
+  ubo.proj = glm::perspective(glm::radians(45.0f),
+                              extent.width / static_cast<float>(extent.height),
+                              0.1f, 10.0f);
+  ubo.proj[1][1] *= -1;
+
+  std::uint32_t frame{0};
+  auto measureStart = std::chrono::steady_clock::now();
+  while (frame < options.warmupFrames + options.frames) {
+    if (frame == options.warmupFrames) {
+      measureStart = std::chrono::steady_clock::now();
+    }
+    render::BeginFrameOptions beginFrameOptions{};
+    beginFrameOptions.renderPass = renderPassHandle;
+    const auto frameInfo = context.BeginFrame(beginFrameOptions);
+    if (frameInfo.ifSwapchainRecreated) {
+      if (options.renderGraph && !frameInfo.ifMinimized) {
+        declareRenderGraph();
+      }
+      continue;
+    }
+    if (options.animate) {
+      // The colors are copied, the matrices are written over them:
+      const auto instanceBytes = instances.size() * sizeof(instances[0]);
+      const auto allocation =
+          frameInfo.frame->AllocateUniformData(instanceBytes);
+      std::memcpy(allocation.data, instances.data(), instanceBytes);
+      const float angle = 0.01f * frame;
+      const auto rotationZ =
+          transformBatch.GetComponent(render::TransformComponent::RotationZ);
+      const auto rotationW =
+          transformBatch.GetComponent(render::TransformComponent::RotationW);
+      std::fill(rotationZ.begin(), rotationZ.end(), std::sin(0.5f * angle));
+      std::fill(rotationW.begin(), rotationW.end(), std::cos(0.5f * angle));
+      render::TransformWriteOptions writeOptions{};
+      writeOptions.matrices =
+          &static_cast<render::InstanceData *>(allocation.data)->model;
+      writeOptions.stride = sizeof(render::InstanceData);
+      writeOptions.threads = &transformThreads;
+      transformBatch.Write(writeOptions);
+      for (auto &item : drawItems) {
+        item.instanceBuffer = context.GetUniformRingBuffer();
+        item.instanceBufferOffset = allocation.offset;
+      }
+    }
+    render::RecordCommandBufferOptions recordOptions{};
+    recordOptions.descriptorSet = descriptorSet;
+    recordOptions.dynamicUniforms = true;
+    recordOptions.dynamicOffset = frameInfo.frame->PushUniformData(ubo);
+    if (options.bindless) {
+      recordOptions.bindless = true;
+      recordOptions.pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT;
+      recordOptions.pushConstants = &bindlessInstanceBuffer;
+      recordOptions.pushConstantsSize = sizeof(bindlessInstanceBuffer);
+    }
+    render::ComputeDispatch cullDispatch{};
+    if (options.culling) {
+      cullDispatch.pipeline = cullingPass.pipeline;
+      cullDispatch.pipelineLayout = cullingPass.pipelineLayout;
+      cullDispatch.descriptorSet = cullingPass.descriptorSet;
+      cullDispatch.dynamicUniforms = true;
+      cullDispatch.dynamicOffset = recordOptions.dynamicOffset;
+      cullDispatch.pushConstants = &cullingPass.instanceCount;
+      cullDispatch.pushConstantsSize = sizeof(cullingPass.instanceCount);
+      cullDispatch.resetSource = cullingPass.commandTemplates;
+      cullDispatch.resetBuffer = cullingPass.indirectBuffer;
+      cullDispatch.resetSize = cullingPass.indirectSize;
+      cullDispatch.groupCountX = (cullingPass.instanceCount + 63) / 64;
+      recordOptions.computeDispatches = &cullDispatch;
+      recordOptions.computeDispatchCount = 1;
+      recordOptions.vertexBuffer = meshBuffer.vertexBuffer;
+      recordOptions.indexBuffer = meshBuffer.indexBuffer;
+      recordOptions.indexType = meshBuffer.indexType;
+      recordOptions.instanceBuffer = cullingPass.instanceBuffer;
+      recordOptions.indirectBuffer = cullingPass.indirectBuffer;
+      recordOptions.drawCount = cullingPass.drawCount;
+    } else {
+      recordOptions.drawItems = drawItems.data();
+      recordOptions.drawItemCount =
+          static_cast<std::uint32_t>(drawItems.size());
+    }
+    recordOptions.commandBuffer = frameInfo.commandBuffer;
+    recordOptions.renderPass = renderPass;
+    recordOptions.pipelineLayout = pipelineLayout;
+    recordOptions.pipeline = pipelines[0];
+    recordOptions.clearColor = VkClearValue{0, 0, 0, 0};
+    if (options.renderGraph) {
+      graphDrawOptions = recordOptions;
+      context.GetRenderGraph().SetImportedImage(graphFrameImage,
+                                                context.GetFrameImage(),
+                                                context.GetFrameImageView());
+      context.RecordRenderGraph(frameInfo.commandBuffer);
+    } else {
+      context.RecordCommandBuffer(recordOptions);
+    }
+    render::EndFrameOptions endFrameOptions{};
+    endFrameOptions.renderPass = renderPassHandle;
+    endFrameOptions.commandBuffer = frameInfo.commandBuffer;
+    context.EndFrame(endFrameOptions);
+    ++frame;
+  }
+  const std::chrono::duration<double> measureTime =
+      std::chrono::steady_clock::now() - measureStart;
+  context.WaitIdle();
+  transformThreads.Cleanup();
+
+  // CPU time is the frame time without the waits for the GPU and the
+  // presentation engine:
+  BenchmarkResult result{};
+  const auto timings = context.GetFrameStats().Snapshot();
+  for (const auto &timing : timings) {
+    const auto phase = [&timing](render::FramePhase framePhase) {
+      return timing.phaseMilliseconds[static_cast<std::size_t>(framePhase)];
+    };
+    result.cpuMillisecondsPerFrame +=
+        timing.frameMilliseconds - phase(render::FramePhase::FenceWait) -
+        phase(render::FramePhase::Acquire) - phase(render::FramePhase::Present);
+    result.gpuMillisecondsPerFrame += timing.gpuMilliseconds;
+  }
+  if (!timings.empty()) {
+    result.cpuMillisecondsPerFrame /= timings.size();
+    result.gpuMillisecondsPerFrame /= timings.size();
+  }
+  result.framesPerSecond = options.frames / measureTime.count();
+  result.uploadMegabytesPerSecond =
+      uploadBytes / (1024.0 * 1024.0) / uploadTime.count();
+  result.pipelineCreationMilliseconds =
+      context.GetPipelineCacheStats().creationMilliseconds;
+  result.frameStats = context.GetFrameStats().Report();
+  result.timelineSemaphores = context.IsTimelineEnabled();
+
+  context.Cleanup();
+  return result;
+}
+
+TransformBenchmarkResult
+RunTransformBenchmark(const BenchmarkOptions &options) {
+  // Grid instances spinning around their centers with varying scales:
+  const auto gridSize = static_cast<std::uint32_t>(
+      std::ceil(std::sqrt(static_cast<double>(options.instances))));
+  const float cellSize = 2.0f * options.sceneScale / gridSize;
+  render::TransformBatch batch{};
+  batch.Reserve(options.instances);
+  std::vector<glm::vec3> positions{};
+  std::vector<glm::quat> rotations{};
+  std::vector<glm::vec3> scales{};
+  for (std::uint32_t i{0}; i < options.instances; ++i) {
+    const float x = -options.sceneScale + (i % gridSize + 0.5f) * cellSize;
+    const float y = -options.sceneScale + (i / gridSize + 0.5f) * cellSize;
+    positions.emplace_back(x, y, 0.0f);
+    rotations.push_back(glm::angleAxis(0.01f * i, glm::vec3(0.0f, 0.0f, 1.0f)));
+    scales.emplace_back((0.6f + 0.2f * std::sin(0.1f * i)) * cellSize);
+    batch.Add(positions.back(), rotations.back(), scales.back());
+  }
+
+  std::vector<render::InstanceData> instances(options.instances);
+  const auto measure = [&options](const auto &update) {
+    for (std::uint32_t frame{0}; frame < options.warmupFrames; ++frame) {
+      update();
+    }
+    const auto start = std::chrono::steady_clock::now();
+    for (std::uint32_t frame{0}; frame < options.frames; ++frame) {
+      update();
+    }
+    const std::chrono::duration<double, std::milli> time =
+        std::chrono::steady_clock::now() - start;
+    return time.count() / options.frames;
+  };
+
+  TransformBenchmarkResult result{};
+  result.glmMilliseconds = measure([&] {
+    for (std::uint32_t i{0}; i < options.instances; ++i) {
+      instances[i].model =
+          glm::translate(glm::mat4(1.0f), positions[i]) *
+          glm::mat4_cast(rotations[i]) * glm::scale(glm::mat4(1.0f), scales[i]);
+    }
+  });
+  const auto reference = instances;
+
+  // Every kernel has to match glm. The matrices are cleared after each
+  // check, so a kernel leaving some of them unwritten can't pass on the
+  // results of the previous one:
+  const auto clear = [&instances] {
+    for (auto &instance : instances) {
+      instance.model = glm::mat4(0.0f);
+    }
+  };
+  const auto verify = [&instances, &reference, &clear](const char *kernel) {
+    for (std::size_t i{0}; i < instances.size(); ++i) {
+      for (int column{0}; column < 4; ++column) {
+        for (int row{0}; row < 4; ++row) {
+          if (std::abs(instances[i].model[column][row] -
+                       reference[i].model[column][row]) > 1e-4f) {
+            throw std::runtime_error(std::string{"failed to verify the "} +
+                                     kernel + " transform kernel!");
+          }
+        }
+      }
+    }
+    clear();
+  };
+  clear();
+
+  render::TransformWriteOptions writeOptions{};
+  writeOptions.matrices = &instances[0].model;
+  writeOptions.stride = sizeof(render::InstanceData);
+  writeOptions.simd = false;
+  result.scalarMilliseconds = measure([&] { batch.Write(writeOptions); });
+  verify("scalar");
+  writeOptions.simd = true;
+  result.simdMilliseconds = measure([&] { batch.Write(writeOptions); });
+  verify("SIMD");
+  render::ThreadPool threads{};
+  render::ThreadPoolOptions threadOptions{};
+  threadOptions.threadCount = std::max(options.recordingThreads, 1U);
+  threads.Initialize(threadOptions);
+  writeOptions.threads = &threads;
+  result.threadedMilliseconds = measure([&] { batch.Write(writeOptions); });
+  threads.Cleanup();
+  verify("threaded SIMD");
+  return result;
+}
+
+void WriteTransformJson(std::ostream &out, const BenchmarkOptions &options,
+                        const TransformBenchmarkResult &result) {
+  out << "{\n";
+  out << "  \"workload\": {\"frames\": " << options.frames
+      << ", \"warmup_frames\": " << options.warmupFrames
+      << ", \"instances\": " << options.instances
+      << ", \"threads\": " << std::max(options.recordingThreads, 1U)
+      << ", \"simd\": \"" << render::TransformBatch::GetSimdName()
+      << "\"},\n";
+  out << "  \"transform_ms\": {\"glm\": " << result.glmMilliseconds
+      << ", \"scalar\": " << result.scalarMilliseconds
+      << ", \"simd\": " << result.simdMilliseconds
+      << ", \"simd_threads\": " << result.threadedMilliseconds << "},\n";
+  out << "  \"matrices_per_second\": "
+      << options.instances / (result.threadedMilliseconds / 1000.0) << "\n";
+  out << "}" << std::endl;
+}
+
+void WritePercentiles(std::ostream &out, const char *name,
+                      const render::FramePercentiles &percentiles) {
+  out << "    \"" << name << "\": {\"p50\": " << percentiles.p50
+      << ", \"p95\": " << percentiles.p95 << ", \"p99\": " << percentiles.p99
+      << "}";
+}
+
+void WriteJson(std::ostream &out, const BenchmarkOptions &options,
+               const BenchmarkResult &result) {
+  const auto &stats = result.frameStats;
+  out << "{\n";
+  out << "  \"workload\": {\"frames\": " << options.frames
+      << ", \"warmup_frames\": " << options.warmupFrames
+      << ", \"instances\": " << options.instances
+      << ", \"meshes\": " << options.meshes
+      << ", \"pipelines\": " << options.pipelines
+      << ", \"recording_threads\": " << options.recordingThreads
+      << ", \"frames_in_flight\": " << options.framesInFlight
+      << ", \"packed_vertices\": "
+      << (options.packedVertices ? "true" : "false")
+      << ", \"mesh_files\": "
+      << (options.meshDirectory.empty() ? "false" : "true")
+      << ", \"culling\": " << (options.culling ? "true" : "false")
+      << ", \"bindless\": " << (options.bindless ? "true" : "false")
+      << ", \"timeline_semaphores\": "
+      << (result.timelineSemaphores ? "true" : "false")
+      << ", \"scene_scale\": " << options.sceneScale
+      << ", \"animate\": " << (options.animate ? "true" : "false")
+      << ", \"offscreen\": " << (options.offscreen ? "true" : "false")
+      << ", \"readback\": " << (options.readback ? "true" : "false")
+      << ", \"render_graph\": " << (options.renderGraph ? "true" : "false")
+      << "},\n";
+  out << "  \"frames_per_second\": " << result.framesPerSecond << ",\n";
+  out << "  \"cpu_ms_per_frame\": " << result.cpuMillisecondsPerFrame << ",\n";
+  out << "  \"gpu_ms_per_frame\": " << result.gpuMillisecondsPerFrame << ",\n";
+  out << "  \"upload_mb_per_second\": " << result.uploadMegabytesPerSecond
+      << ",\n";
+  out << "  \"pipeline_creation_ms\": " << result.pipelineCreationMilliseconds
+      << ",\n";
+  out << "  \"frame_ms\": {\n";
+  WritePercentiles(out, "frame", stats.frameMilliseconds);
+  out << ",\n";
+  WritePercentiles(out, "gpu", stats.gpuMilliseconds);
+  for (std::size_t i{0}; i < render::kFramePhaseCount; ++i) {
+    out << ",\n";
+    WritePercentiles(
+        out, render::GetFramePhaseName(static_cast<render::FramePhase>(i)),
+        stats.phaseMilliseconds[i]);
+  }
+  out << "\n  },\n";
+  out << "  \"frame_bound\": {\"cpu\": " << stats.cpuBoundFrames
+      << ", \"gpu\": " << stats.gpuBoundFrames
+      << ", \"present\": " << stats.presentBoundFrames << "}\n";
+  out << "}" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  BenchmarkOptions options{};
+  if (!ParseArguments(argc, argv, options)) {
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  try {
+    std::ofstream file{};
+    if (options.output != "-") {
+      file.open(options.output);
+      if (!file.is_open()) {
+        throw std::runtime_error("failed to open benchmark output file!");
+      }
+    }
+    auto &out = options.output == "-" ? std::cout : file;
+    if (options.transforms) {
+      WriteTransformJson(out, options, RunTransformBenchmark(options));
+    } else {
+      WriteJson(out, options, RunBenchmark(options));
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
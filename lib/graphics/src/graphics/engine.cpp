@@ -13,4 +13,10 @@ std::vector<char> ReadFile(fs::path path) {
   return result;
 }
 
+render::MappedFile MapFile(const fs::path &path) {
+  render::MappedFile file{};
+  file.Open(path.string());
+  return file;
+}
+
 } // namespace graphics
\ No newline at end of file
@@ -1,10 +1,13 @@
 #pragma once
 
 #include <render/context.hpp>
+#include <render/mapped_file.hpp>
 
 #include <chrono>
+#include <cmath>
 #include <filesystem>
 #include <fstream>
+#include <thread>
 
 namespace graphics {
 
@@ -12,6 +15,17 @@ namespace fs = std::filesystem;
 
 const std::string kVertexShaderPath{"../../../shaders/vert.spv"};
 const std::string kFragmentShaderPath{"../../../shaders/frag.spv"};
+const std::string kInstancedVertexShaderPath{
+    "../../../shaders/vert_instanced.spv"};
+/// GLSL sources of the shaders, recompiled when they are edited.
+const std::string kVertexShaderSourcePath{"../../../shaders/shader.vert"};
+const std::string kFragmentShaderSourcePath{"../../../shaders/shader.frag"};
+const std::string kInstancedVertexShaderSourcePath{
+    "../../../shaders/shader_instanced.vert"};
+const std::string kPipelineCachePath{"pipeline_cache.bin"};
+
+/// The demo draws a grid of kInstanceGridSize x kInstanceGridSize quads.
+constexpr std::uint32_t kInstanceGridSize{256};
 
 /// Helper function to load the binary data from the files.
 ///
@@ -20,6 +34,14 @@ const std::string kFragmentShaderPath{"../../../shaders/frag.spv"};
 /// @return Loaded binary data.
 std::vector<char> ReadFile(fs::path path);
 
+/// Maps the file into memory instead of reading it into a heap buffer, e.g.
+/// for SPIR-V passed straight to Context::CreateShaderModule.
+///
+/// @param path  Path to file.
+///
+/// @return Mapped file.
+render::MappedFile MapFile(const fs::path &path);
+
 /// Vulkan Engine.
 class Engine final {
 public:
@@ -27,133 +49,180 @@ public:
     render::ContextOptions options{};
     options.enableValidationLayers = true;
     options.title = "Graphics Engine";
+    options.recordingThreadCount = std::thread::hardware_concurrency() / 2;
+    options.pipelineCachePath = kPipelineCachePath;
+    options.gpuProfiling = true;
+    options.shaderHotReload = true;
     std::cout << "Initializing the engine..." << std::endl;
     context_.Initialize(options);
 
     std::cout << "Creating a render pass..." << std::endl;
     render::RenderPassOptions renderPassOptions{};
     renderPassOptions.format = context_.GetSwapChainImageFormat();
-    const auto renderPass = context_.CreateRenderPass(renderPassOptions);
+    renderPassOptions.depthFormat = context_.GetDepthFormat();
+    const auto renderPassHandle = context_.CreateRenderPass(renderPassOptions);
+    const auto renderPass = context_.GetRenderPass(renderPassHandle);
 
     std::cout << "Creating a descriptor set layout..." << std::endl;
     render::DescriptorSetLayoutOptions descriptorSetLayoutOptions{};
     descriptorSetLayoutOptions.binding = 0;
-    descriptorSetLayoutOptions.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    descriptorSetLayoutOptions.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     descriptorSetLayoutOptions.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-    const auto descriptorSetLayout =
-        context_.CreateDescriptorSetLayout(descriptorSetLayoutOptions);
+    const auto descriptorSetLayout = context_.GetDescriptorSetLayout(
+        context_.CreateDescriptorSetLayout(descriptorSetLayoutOptions));
 
     std::cout << "Creating a pipeline layout..." << std::endl;
     render::PipelineLayoutOptions pipelineLayoutOptions{};
     pipelineLayoutOptions.descriptorSetLayout = descriptorSetLayout;
-    const auto pipelineLayout =
-        context_.CreatePipelineLayout(pipelineLayoutOptions);
+    const auto pipelineLayout = context_.GetPipelineLayout(
+        context_.CreatePipelineLayout(pipelineLayoutOptions));
 
-    std::cout << "Loading vertex shader: " << kVertexShaderPath << std::endl;
-    auto vertexShaderCode = ReadFile(kVertexShaderPath);
-    const auto vertexShaderModule =
-        context_.CreateShaderModule(vertexShaderCode);
+    // The instanced shader has to be compiled with shaders/compile.sh, the
+    // demo draws a single quad without it:
+    const bool instanced = fs::exists(kInstancedVertexShaderPath);
+    const auto vertexShaderPath =
+        instanced ? kInstancedVertexShaderPath : kVertexShaderPath;
+    // Edits of the sources are compiled and swapped in while running:
+    std::cout << "Loading vertex shader: " << vertexShaderPath << std::endl;
+    render::ShaderFileOptions vertexShaderOptions{};
+    vertexShaderOptions.spirvPath = vertexShaderPath;
+    vertexShaderOptions.sourcePath =
+        instanced ? kInstancedVertexShaderSourcePath : kVertexShaderSourcePath;
+    const auto vertexShader = context_.LoadShader(vertexShaderOptions);
     std::cout << "Loading fragment shader: " << kFragmentShaderPath
               << std::endl;
-    auto fragmentShaderCode = ReadFile(kFragmentShaderPath);
-    const auto fragmentShaderModule =
-        context_.CreateShaderModule(fragmentShaderCode);
-
-    std::cout << "Creating a graphics pipeline..." << std::endl;
-    render::GraphicsPipelineOptions pipelineOptions{};
-    pipelineOptions.pipelineLayout = pipelineLayout;
-    pipelineOptions.renderPass = renderPass;
-    pipelineOptions.vertexShader = vertexShaderModule;
-    pipelineOptions.fragmentShader = fragmentShaderModule;
-    pipelineOptions.viewportExtent = context_.GetSwapChainExtent();
-    pipelineOptions.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    pipelineOptions.polygonMode = VK_POLYGON_MODE_FILL;
-    const auto pipeline = context_.CreateGraphicsPipeline(pipelineOptions);
+    render::ShaderFileOptions fragmentShaderOptions{};
+    fragmentShaderOptions.spirvPath = kFragmentShaderPath;
+    fragmentShaderOptions.sourcePath = kFragmentShaderSourcePath;
+    const auto fragmentShader = context_.LoadShader(fragmentShaderOptions);
+
+    std::cout << "Compiling a graphics pipeline..." << std::endl;
+    render::ReloadablePipelineOptions pipelineOptions{};
+    pipelineOptions.vertexShader = vertexShader;
+    pipelineOptions.fragmentShader = fragmentShader;
+    pipelineOptions.pipeline.pipelineLayout = pipelineLayout;
+    pipelineOptions.pipeline.renderPass = renderPass;
+    pipelineOptions.pipeline.viewportExtent = context_.GetSwapChainExtent();
+    pipelineOptions.pipeline.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    pipelineOptions.pipeline.polygonMode = VK_POLYGON_MODE_FILL;
+    pipelineOptions.pipeline.instanced = instanced;
+    pipelineOptions.pipeline.depthTest = true;
+    // Rendering starts right away, frames are only cleared until the
+    // pipeline is compiled:
+    const auto pipeline = context_.CreateReloadablePipeline(pipelineOptions);
 
     std::cout << "Creating framebuffers..." << std::endl;
-    context_.CreateSwapChainFramebuffers(renderPass);
+    context_.CreateSwapChainFramebuffers(renderPassHandle);
 
-    std::cout << "Creating a command pool..." << std::endl;
-    render::CommandPoolOptions commandPoolOptions{};
-    const auto commandPool = context_.CreateCommandPool(commandPoolOptions);
+    std::cout << "Creating a mesh buffer..." << std::endl;
+    render::MeshBufferOptions meshBufferOptions{};
+    meshBufferOptions.meshes.push_back(render::Mesh{vertices_, indices_});
+    meshBufferOptions.meshes.push_back(
+        render::Mesh{triangleVertices_, triangleIndices_});
+    const auto meshBuffer = context_.CreateMeshBuffer(meshBufferOptions);
+
+    VkBuffer instanceBuffer{VK_NULL_HANDLE};
+    std::uint32_t instanceCount{1};
+    if (instanced) {
+      std::cout << "Creating an instance buffer..." << std::endl;
+      const auto instances = CreateInstanceGrid();
+      render::InstanceBufferOptions instanceBufferOptions{};
+      instanceBufferOptions.instances = instances;
+      instanceCount = static_cast<std::uint32_t>(instances.size());
+      instanceBuffer = context_.GetBuffer(
+          context_.CreateInstanceBuffer(instanceBufferOptions));
+    }
+    std::cout << "Drawing " << instanceCount << " instances per frame"
+              << std::endl;
 
-    std::cout << "Creating a vertex buffer..." << std::endl;
-    render::VertexBufferOptions vertexBufferOptions{};
-    vertexBufferOptions.commandPool = commandPool;
-    vertexBufferOptions.vertices = vertices_;
-    const auto vertexBuffer = context_.CreateVertexBuffer(vertexBufferOptions);
+    // Every grid row is a separate draw of one of the meshes, all of them are
+    // submitted with a single indirect call:
+    VkBuffer indirectBuffer{VK_NULL_HANDLE};
+    std::uint32_t drawCount{0};
+    if (instanced && context_.GetDrawIndirectSupport().firstInstance) {
+      std::cout << "Creating an indirect buffer..." << std::endl;
+      std::vector<VkDrawIndexedIndirectCommand> commands{};
+      for (std::uint32_t row{0}; row < kInstanceGridSize; ++row) {
+        const auto &mesh = meshBuffer.meshes[row % meshBuffer.meshes.size()];
+        commands.push_back(render::GetDrawCommand(mesh, kInstanceGridSize,
+                                                  row * kInstanceGridSize));
+      }
+      render::IndirectBufferOptions indirectBufferOptions{};
+      indirectBufferOptions.commands = commands;
+      drawCount = static_cast<std::uint32_t>(commands.size());
+      indirectBuffer = context_.GetBuffer(
+          context_.CreateIndirectBuffer(indirectBufferOptions));
+    }
 
-    std::cout << "Creating a index buffer..." << std::endl;
-    render::IndexBufferOptions indexBufferOptions{};
-    indexBufferOptions.commandPool = commandPool;
-    indexBufferOptions.indices = indices_;
-    const auto indexBuffer = context_.CreateIndexBuffer(indexBufferOptions);
+    // Without indirect first instance support the rows are drawn from a draw
+    // list recorded by the recording threads:
+    std::vector<render::DrawItem> drawItems{};
+    if (instanced && indirectBuffer == VK_NULL_HANDLE) {
+      for (std::uint32_t row{0}; row < kInstanceGridSize; ++row) {
+        const auto &mesh = meshBuffer.meshes[row % meshBuffer.meshes.size()];
+        render::DrawItem item{};
+        item.vertexBuffer = meshBuffer.vertexBuffer;
+        item.indexBuffer = meshBuffer.indexBuffer;
+        item.indexType = meshBuffer.indexType;
+        item.instanceBuffer = instanceBuffer;
+        item.indexCount = mesh.indexCount;
+        item.instanceCount = kInstanceGridSize;
+        item.firstIndex = mesh.firstIndex;
+        item.vertexOffset = mesh.vertexOffset;
+        item.firstInstance = row * kInstanceGridSize;
+        drawItems.push_back(item);
+      }
+    }
 
+    // Every frame slot has a descriptor set covering the uniform ring, the
+    // uniform data of every draw is selected with the dynamic offset:
     std::cout << "Creating a descriptor pool..." << std::endl;
     render::DescriptorPoolOptions descriptorPoolOptions{};
-    descriptorPoolOptions.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    descriptorPoolOptions.descriptorCount = render::kMaxFramesInFlight;
-    const auto descriptorPool =
-        context_.CreateDescriptorPool(descriptorPoolOptions);
-
-    std::cout << "Creating descriptor sets..." << std::endl;
-    std::vector<VkDescriptorSet> descriptorSets{};
-    for (std::size_t id{0}; id < render::kMaxFramesInFlight; ++id) {
-      render::DescriptorSetOptions descriptorSetOptions{};
-      descriptorSetOptions.descriptorPool = descriptorPool;
-      descriptorSetOptions.descriptorSetLayout = descriptorSetLayout;
-      const auto descriptorSet =
-          context_.CreateDescriptorSet(descriptorSetOptions);
-      descriptorSets.push_back(descriptorSet);
-    }
+    descriptorPoolOptions.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    descriptorPoolOptions.descriptorCount = context_.GetFramesInFlight();
+    const auto descriptorPool = context_.GetDescriptorPool(
+        context_.CreateDescriptorPool(descriptorPoolOptions));
 
-    std::cout << "Creating an uniform buffer..." << std::endl;
-    std::vector<VkBuffer> uniformBuffers{};
-    for (const auto &descriptorSet : descriptorSets) {
-      const auto uniformBuffer = context_.CreateUniformBuffer();
-      uniformBuffers.push_back(uniformBuffer);
+    std::cout << "Creating frame descriptor sets..." << std::endl;
+    render::DescriptorSetOptions descriptorSetOptions{};
+    descriptorSetOptions.descriptorPool = descriptorPool;
+    descriptorSetOptions.descriptorSetLayout = descriptorSetLayout;
+    for (const auto descriptorSet :
+         context_.CreateFrameDescriptorSets(descriptorSetOptions)) {
       render::UpdateDescriptorSetOptions updateDescriptorSetOptions{};
       updateDescriptorSetOptions.descriptorSet = descriptorSet;
       updateDescriptorSetOptions.descriptorType =
-          VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-      updateDescriptorSetOptions.uniformBuffer = uniformBuffer;
+          VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+      updateDescriptorSetOptions.uniformBuffer =
+          context_.GetUniformRingBuffer();
+      updateDescriptorSetOptions.range = sizeof(render::UniformBufferObject);
       context_.UpdateDescriptorSet(updateDescriptorSetOptions);
     }
 
-    std::cout << "Creating command buffers..." << std::endl;
-    std::vector<VkCommandBuffer> commandBuffers{};
-    for (std::size_t id{0}; id < render::kMaxFramesInFlight; ++id) {
-      render::CommandBufferOptions commandBufferOptions{};
-      commandBufferOptions.commandPool = commandPool;
-      const auto commandBuffer =
-          context_.CreateCommandBuffer(commandBufferOptions);
-      commandBuffers.push_back(commandBuffer);
-    }
-
     const auto window = context_.GetWindow();
+    // The rows are sorted front to back every frame, the draw list keeps the
+    // row order:
+    std::vector<render::DrawItem> sortedDrawItems{};
 
     /// Main engine loop.
     const auto startTime = std::chrono::high_resolution_clock::now();
-    std::uint32_t bufferId{0};
     while (!glfwWindowShouldClose(window)) {
       glfwPollEvents();
 
       render::BeginFrameOptions beginFrameOptions{};
-      beginFrameOptions.renderPass = renderPass;
-      context_.BeginFrame(beginFrameOptions);
-
-      render::RecordCommandBufferOptions recordOptions{};
-      recordOptions.vertexBuffer = vertexBuffer;
-      recordOptions.indexBuffer = indexBuffer;
-      recordOptions.indexCount = indices_.size();
-      recordOptions.descriptorSet = descriptorSets[bufferId];
-      recordOptions.commandBuffer = commandBuffers[bufferId];
-      recordOptions.renderPass = renderPass;
-      recordOptions.pipelineLayout = pipelineLayout;
-      recordOptions.pipeline = pipeline;
-      recordOptions.clearColor = VkClearValue{127, 127, 127, 127};
-      context_.RecordCommandBuffer(recordOptions);
+      beginFrameOptions.renderPass = renderPassHandle;
+      const auto frameInfo = context_.BeginFrame(beginFrameOptions);
+      if (frameInfo.ifMinimized) {
+        // Sleeps until the window is restored:
+        glfwWaitEvents();
+      }
+      if (frameInfo.ifSwapchainRecreated) {
+        continue;
+      }
+      auto &frame = *frameInfo.frame;
 
+      // Uniform data is pushed before the recording, which needs the offsets.
+      // The GPU has finished reading the uniform slice of the frame:
       const auto swapChainExtent = context_.GetSwapChainExtent();
       const auto currentTime = std::chrono::high_resolution_clock::now();
       const float time =
@@ -171,28 +240,119 @@ public:
           swapChainExtent.width / static_cast<float>(swapChainExtent.height),
           0.1f, 10.0f);
       ubo.proj[1][1] *= -1;
-      context_.UpdateUniformBuffer(
-          render::UpdateUniformBufferOptions{bufferId, ubo});
+      const auto uniformOffset = frame.PushUniformData(ubo);
+      // Draw list rows sway with their own phase, using per-row uniforms:
+      const float cellSize = 2.0f / kInstanceGridSize;
+      sortedDrawItems = drawItems;
+      for (std::size_t row{0}; row < sortedDrawItems.size(); ++row) {
+        auto rowUbo = ubo;
+        rowUbo.model = glm::translate(
+            ubo.model, glm::vec3(0.05f * std::sin(time + 0.1f * row), 0.0f,
+                                 0.0f));
+        sortedDrawItems[row].dynamicOffset = frame.PushUniformData(rowUbo);
+        const glm::vec3 rowCenter{0.0f, -1.0f + (row + 0.5f) * cellSize, 0.0f};
+        sortedDrawItems[row].depth =
+            render::GetViewDepth(ubo.view * rowUbo.model, rowCenter);
+      }
+      render::SortDrawItems(sortedDrawItems);
+
+      render::RecordCommandBufferOptions recordOptions{};
+      recordOptions.vertexBuffer = meshBuffer.vertexBuffer;
+      recordOptions.indexBuffer = meshBuffer.indexBuffer;
+      recordOptions.indexType = meshBuffer.indexType;
+      recordOptions.indexCount = meshBuffer.meshes[0].indexCount;
+      recordOptions.instanceBuffer = instanceBuffer;
+      recordOptions.instanceCount = instanceCount;
+      recordOptions.indirectBuffer = indirectBuffer;
+      recordOptions.drawCount = drawCount;
+      recordOptions.drawItems = sortedDrawItems.data();
+      recordOptions.drawItemCount =
+          static_cast<std::uint32_t>(sortedDrawItems.size());
+      recordOptions.descriptorSet = frame.GetDescriptorSet();
+      recordOptions.dynamicUniforms = true;
+      recordOptions.dynamicOffset = uniformOffset;
+      recordOptions.commandBuffer = frameInfo.commandBuffer;
+      recordOptions.renderPass = renderPass;
+      recordOptions.pipelineLayout = pipelineLayout;
+      recordOptions.pipeline = context_.GetPipeline(pipeline);
+      recordOptions.clearColor = VkClearValue{127, 127, 127, 127};
+      context_.RecordCommandBuffer(recordOptions);
 
       render::EndFrameOptions endFrameOptions{};
-      endFrameOptions.renderPass = renderPass;
-      endFrameOptions.commandBuffer = commandBuffers[bufferId];
+      endFrameOptions.renderPass = renderPassHandle;
+      endFrameOptions.commandBuffer = frameInfo.commandBuffer;
       context_.EndFrame(endFrameOptions);
+    }
 
-      bufferId = (bufferId + 1) % render::kMaxFramesInFlight;
+    const auto cacheStats = context_.GetPipelineCacheStats();
+    std::cout << "Pipeline cache hits: " << cacheStats.cacheHits << "/"
+              << cacheStats.pipelineCount << ", creation time "
+              << cacheStats.creationMilliseconds << " ms" << std::endl;
+    for (const auto &scope : context_.GetGpuTimings()) {
+      std::cout << "GPU time: " << std::string(2 * scope.depth, ' ')
+                << scope.name << " " << scope.milliseconds << " ms";
+      if (scope.hasStatistics) {
+        std::cout << ", " << scope.statistics.vertexShaderInvocations
+                  << " vertex and "
+                  << scope.statistics.fragmentShaderInvocations
+                  << " fragment shader invocations";
+      }
+      std::cout << std::endl;
+    }
+    const auto frameReport = context_.GetFrameStats().Report();
+    std::cout << "Frame time over " << frameReport.frameCount
+              << " frames: p50 " << frameReport.frameMilliseconds.p50
+              << " ms, p95 " << frameReport.frameMilliseconds.p95
+              << " ms, p99 " << frameReport.frameMilliseconds.p99 << " ms"
+              << std::endl;
+    for (std::size_t i{0}; i < render::kFramePhaseCount; ++i) {
+      const auto &phase = frameReport.phaseMilliseconds[i];
+      std::cout << "  "
+                << render::GetFramePhaseName(static_cast<render::FramePhase>(i))
+                << ": p50 " << phase.p50 << " ms, p95 " << phase.p95
+                << " ms, p99 " << phase.p99 << " ms" << std::endl;
     }
+    std::cout << "Frames bound by CPU " << frameReport.cpuBoundFrames
+              << ", GPU " << frameReport.gpuBoundFrames << ", present "
+              << frameReport.presentBoundFrames << std::endl;
 
     context_.WaitIdle();
     context_.Cleanup();
   }
 
 private:
+  /// Places the quads on a grid covering [-1, 1] x [-1, 1].
+  std::vector<render::InstanceData> CreateInstanceGrid() const {
+    std::vector<render::InstanceData> instances{};
+    instances.reserve(kInstanceGridSize * kInstanceGridSize);
+    const float cellSize = 2.0f / kInstanceGridSize;
+    for (std::uint32_t y{0}; y < kInstanceGridSize; ++y) {
+      for (std::uint32_t x{0}; x < kInstanceGridSize; ++x) {
+        const glm::vec3 position{-1.0f + (x + 0.5f) * cellSize,
+                                 -1.0f + (y + 0.5f) * cellSize, 0.0f};
+        render::InstanceData instance{};
+        instance.model = glm::scale(glm::translate(glm::mat4(1.0f), position),
+                                    glm::vec3(0.8f * cellSize));
+        instance.color = glm::vec4(
+            static_cast<float>(x) / kInstanceGridSize,
+            static_cast<float>(y) / kInstanceGridSize, 1.0f, 1.0f);
+        instances.push_back(instance);
+      }
+    }
+    return instances;
+  }
+
   const std::vector<render::Vertex> vertices_{
       {{-0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}},
       {{0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}},
       {{0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}},
       {{-0.5f, 0.5f}, {1.0f, 1.0f, 1.0f}}};
   const std::vector<std::uint16_t> indices_{0, 1, 2, 2, 3, 0};
+  const std::vector<render::Vertex> triangleVertices_{
+      {{0.0f, -0.5f}, {1.0f, 1.0f, 0.0f}},
+      {{0.5f, 0.5f}, {0.0f, 1.0f, 1.0f}},
+      {{-0.5f, 0.5f}, {1.0f, 0.0f, 1.0f}}};
+  const std::vector<std::uint16_t> triangleIndices_{0, 1, 2};
   render::Context context_{};
 };
 
@@ -0,0 +1,171 @@
+#include "render/bindless_table.hpp"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace render {
+
+void BindlessTable::Initialize(const BindlessTableOptions &options) {
+  device_ = options.device;
+  // Pool sizes must not be zero:
+  storageBuffers_ = Slots{std::max(options.storageBufferCount, 1U)};
+  textures_ = Slots{std::max(options.textureCount, 1U)};
+
+  std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+  bindings[0].binding = kBindlessStorageBufferBinding;
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  bindings[0].descriptorCount = storageBuffers_.capacity;
+  bindings[0].stageFlags = options.stageFlags;
+  bindings[1].binding = kBindlessTextureBinding;
+  bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  bindings[1].descriptorCount = textures_.capacity;
+  bindings[1].stageFlags = options.stageFlags;
+  const VkDescriptorBindingFlagsEXT bindingFlag =
+      VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+      VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT;
+  const std::array<VkDescriptorBindingFlagsEXT, 2> bindingFlags{bindingFlag,
+                                                                bindingFlag};
+  VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo{};
+  bindingFlagsInfo.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+  bindingFlagsInfo.bindingCount =
+      static_cast<std::uint32_t>(bindingFlags.size());
+  bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.pNext = &bindingFlagsInfo;
+  layoutInfo.flags =
+      VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+  layoutInfo.bindingCount = static_cast<std::uint32_t>(bindings.size());
+  layoutInfo.pBindings = bindings.data();
+  if (vkCreateDescriptorSetLayout(device_, &layoutInfo, nullptr,
+                                  &descriptorSetLayout_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create bindless set layout!");
+  }
+
+  std::array<VkDescriptorPoolSize, 2> poolSizes{};
+  poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  poolSizes[0].descriptorCount = storageBuffers_.capacity;
+  poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  poolSizes[1].descriptorCount = textures_.capacity;
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+  poolInfo.maxSets = 1;
+  poolInfo.poolSizeCount = static_cast<std::uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+  if (vkCreateDescriptorPool(device_, &poolInfo, nullptr, &descriptorPool_) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create bindless descriptor pool!");
+  }
+
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = descriptorPool_;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &descriptorSetLayout_;
+  if (vkAllocateDescriptorSets(device_, &allocInfo, &descriptorSet_) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate bindless descriptor set!");
+  }
+}
+
+void BindlessTable::Cleanup() {
+  // The set is freed with the pool:
+  vkDestroyDescriptorPool(device_, descriptorPool_, nullptr);
+  descriptorPool_ = VK_NULL_HANDLE;
+  descriptorSet_ = VK_NULL_HANDLE;
+  vkDestroyDescriptorSetLayout(device_, descriptorSetLayout_, nullptr);
+  descriptorSetLayout_ = VK_NULL_HANDLE;
+  storageBuffers_ = Slots{};
+  textures_ = Slots{};
+}
+
+std::uint32_t BindlessTable::AddStorageBuffer(VkBuffer buffer,
+                                              VkDeviceSize offset,
+                                              VkDeviceSize range) {
+  const auto index = Acquire(storageBuffers_);
+  VkDescriptorBufferInfo bufferInfo{};
+  bufferInfo.buffer = buffer;
+  bufferInfo.offset = offset;
+  bufferInfo.range = range;
+  VkWriteDescriptorSet descriptorWrite{};
+  descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrite.dstSet = descriptorSet_;
+  descriptorWrite.dstBinding = kBindlessStorageBufferBinding;
+  descriptorWrite.dstArrayElement = index;
+  descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  descriptorWrite.descriptorCount = 1;
+  descriptorWrite.pBufferInfo = &bufferInfo;
+  vkUpdateDescriptorSets(device_, 1, &descriptorWrite, 0, nullptr);
+  return index;
+}
+
+std::uint32_t BindlessTable::AddTexture(VkImageView imageView,
+                                        VkSampler sampler) {
+  const auto index = Acquire(textures_);
+  VkDescriptorImageInfo imageInfo{};
+  imageInfo.sampler = sampler;
+  imageInfo.imageView = imageView;
+  imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  VkWriteDescriptorSet descriptorWrite{};
+  descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrite.dstSet = descriptorSet_;
+  descriptorWrite.dstBinding = kBindlessTextureBinding;
+  descriptorWrite.dstArrayElement = index;
+  descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  descriptorWrite.descriptorCount = 1;
+  descriptorWrite.pImageInfo = &imageInfo;
+  vkUpdateDescriptorSets(device_, 1, &descriptorWrite, 0, nullptr);
+  return index;
+}
+
+void BindlessTable::RemoveStorageBuffer(std::uint32_t index) {
+  Remove(storageBuffers_, index);
+}
+
+void BindlessTable::RemoveTexture(std::uint32_t index) {
+  Remove(textures_, index);
+}
+
+void BindlessTable::ReleaseStorageBuffer(std::uint32_t index) {
+  Release(storageBuffers_, index);
+}
+
+void BindlessTable::ReleaseTexture(std::uint32_t index) {
+  Release(textures_, index);
+}
+
+std::uint32_t BindlessTable::Acquire(Slots &slots) {
+  if (!slots.freeIndices.empty()) {
+    const auto index = slots.freeIndices.back();
+    slots.freeIndices.pop_back();
+    slots.live[index] = true;
+    return index;
+  }
+  if (slots.next == slots.capacity) {
+    throw std::runtime_error("failed to add to full bindless array!");
+  }
+  slots.live.push_back(true);
+  return slots.next++;
+}
+
+void BindlessTable::Remove(Slots &slots, std::uint32_t index) {
+  // A repeated remove would free the slot twice and hand it out twice:
+  if (index >= slots.next || !slots.live[index]) {
+    throw std::runtime_error("failed to remove unused bindless slot!");
+  }
+  slots.live[index] = false;
+}
+
+void BindlessTable::Release(Slots &slots, std::uint32_t index) {
+  if (index >= slots.next || slots.live[index]) {
+    throw std::runtime_error("failed to release unremoved bindless slot!");
+  }
+  // The stale descriptor stays written, partially bound arrays only require
+  // the slots accessed by shaders to be valid:
+  slots.freeIndices.push_back(index);
+}
+
+} // namespace render
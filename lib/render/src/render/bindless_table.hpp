@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace render {
+
+/// Bindings of the bindless descriptor set.
+enum BindlessBinding : std::uint32_t {
+  /// `readonly buffer ... buffers[]`, indexed by AddStorageBuffer.
+  kBindlessStorageBufferBinding = 0,
+  /// `uniform sampler2D textures[]`, indexed by AddTexture.
+  kBindlessTextureBinding = 1
+};
+
+struct BindlessTableOptions final {
+  VkDevice device{VK_NULL_HANDLE};
+  /// Array sizes, at most the update-after-bind limits of the device.
+  std::uint32_t storageBufferCount{};
+  std::uint32_t textureCount{};
+  VkShaderStageFlags stageFlags{VK_SHADER_STAGE_VERTEX_BIT |
+                                VK_SHADER_STAGE_FRAGMENT_BIT};
+};
+
+/// One descriptor set holding large arrays of all the storage buffers and
+/// textures, needs VK_EXT_descriptor_indexing.
+///
+/// The set is bound once per command buffer, and shaders select the
+/// resources of a draw by their indices, e.g. read from per object data
+/// addressed by gl_InstanceIndex. So any number of materials and objects
+/// share one set instead of a pool and a set each.
+///
+/// The arrays are partially bound, slots that are never added may stay
+/// empty. The bindings are update-after-bind, so resources are added while
+/// the set is bound in command buffers in flight, as long as those do not
+/// access the added slots. The same holds for removing: a released slot is
+/// reused by the next add, so it has to be released only after the frames
+/// using it have finished.
+class BindlessTable final {
+public:
+  /// Creates the set layout, the pool and the set.
+  void Initialize(const BindlessTableOptions &options);
+
+  /// Destroys the pool and the set layout.
+  void Cleanup();
+
+  /// Writes the buffer range into a free storage buffer slot.
+  ///
+  /// @return Index of the slot in the storage buffer array.
+  std::uint32_t AddStorageBuffer(VkBuffer buffer, VkDeviceSize offset = 0,
+                                 VkDeviceSize range = VK_WHOLE_SIZE);
+
+  /// Writes the combined image sampler into a free texture slot, the image
+  /// has to be in SHADER_READ_ONLY_OPTIMAL layout when sampled.
+  ///
+  /// @return Index of the slot in the texture array.
+  std::uint32_t AddTexture(VkImageView imageView, VkSampler sampler);
+
+  /// Marks the added slot removed, throws if it is not added.
+  void RemoveStorageBuffer(std::uint32_t index);
+  void RemoveTexture(std::uint32_t index);
+
+  /// Frees the removed slot, it is reused by the next add.
+  void ReleaseStorageBuffer(std::uint32_t index);
+  void ReleaseTexture(std::uint32_t index);
+
+  VkDescriptorSetLayout GetDescriptorSetLayout() const {
+    return descriptorSetLayout_;
+  }
+
+  VkDescriptorSet GetDescriptorSet() const { return descriptorSet_; }
+
+private:
+  /// Slots of one array binding, freed slots are reused first.
+  struct Slots final {
+    std::uint32_t capacity{};
+    std::uint32_t next{};
+    std::vector<std::uint32_t> freeIndices{};
+    /// Whether each of the first next slots is added and not removed.
+    std::vector<bool> live{};
+  };
+
+  static std::uint32_t Acquire(Slots &slots);
+  static void Remove(Slots &slots, std::uint32_t index);
+  static void Release(Slots &slots, std::uint32_t index);
+
+  VkDevice device_{VK_NULL_HANDLE};
+  VkDescriptorSetLayout descriptorSetLayout_{VK_NULL_HANDLE};
+  VkDescriptorPool descriptorPool_{VK_NULL_HANDLE};
+  VkDescriptorSet descriptorSet_{VK_NULL_HANDLE};
+  Slots storageBuffers_{};
+  Slots textures_{};
+};
+
+} // namespace render
@@ -1,100 +1,292 @@
 #include "render/context.hpp"
 
+#include <cctype>
+#include <cmath>
+#include <functional>
+
 namespace render {
 
-void Context::Cleanup() {
-  CleanupSwapChain();
+namespace {
 
-  for (const auto &uniformBuffer : uniformBuffers_) {
-    vkDestroyBuffer(device_, uniformBuffer, nullptr);
-  }
-  uniformBuffers_.clear();
-  for (const auto &uniformBufferMemory : uniformBufferMemories_) {
-    vkFreeMemory(device_, uniformBufferMemory, nullptr);
-  }
-  uniformBufferMemories_.clear();
-  uniformBufferMappedMemories_.clear();
+/// Smallest slice of a draw list worth recording on a separate thread.
+constexpr std::uint32_t kMinDrawItemsPerThread{64};
 
-  for (const auto &descriptorPool : descriptorPools_) {
-    vkDestroyDescriptorPool(device_, descriptorPool, nullptr);
-  }
-  descriptorPools_.clear();
+using Clock = std::chrono::steady_clock;
 
-  for (const auto &descriptorSetLayout : descriptorSetLayouts_) {
-    vkDestroyDescriptorSetLayout(device_, descriptorSetLayout, nullptr);
+const char *GetPresentModeName(VkPresentModeKHR presentMode) {
+  switch (presentMode) {
+  case VK_PRESENT_MODE_IMMEDIATE_KHR:
+    return "VK_PRESENT_MODE_IMMEDIATE_KHR";
+  case VK_PRESENT_MODE_MAILBOX_KHR:
+    return "VK_PRESENT_MODE_MAILBOX_KHR";
+  case VK_PRESENT_MODE_FIFO_KHR:
+    return "VK_PRESENT_MODE_FIFO_KHR";
+  case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+    return "VK_PRESENT_MODE_FIFO_RELAXED_KHR";
+  default:
+    return "unknown present mode";
   }
-  descriptorSetLayouts_.clear();
+}
 
-  for (const auto &graphicsPipeline : pipelines_) {
-    vkDestroyPipeline(device_, graphicsPipeline, nullptr);
-  }
-  pipelines_.clear();
+VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return alignment > 1 ? (value + alignment - 1) / alignment * alignment
+                       : value;
+}
 
-  for (const auto &pipelineLayout : pipelineLayouts_) {
-    vkDestroyPipelineLayout(device_, pipelineLayout, nullptr);
+/// Returns the bytes per texel of an uncompressed color format, 0 for the
+/// formats the readback does not support.
+VkDeviceSize GetTexelSize(VkFormat format) {
+  switch (format) {
+  case VK_FORMAT_R8_UNORM:
+  case VK_FORMAT_R8_SRGB:
+    return 1;
+  case VK_FORMAT_R8G8_UNORM:
+  case VK_FORMAT_R8G8_SRGB:
+  case VK_FORMAT_R5G6B5_UNORM_PACK16:
+  case VK_FORMAT_R16_SFLOAT:
+    return 2;
+  case VK_FORMAT_R8G8B8A8_UNORM:
+  case VK_FORMAT_R8G8B8A8_SRGB:
+  case VK_FORMAT_B8G8R8A8_UNORM:
+  case VK_FORMAT_B8G8R8A8_SRGB:
+  case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+  case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+  case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+  case VK_FORMAT_R16G16_SFLOAT:
+  case VK_FORMAT_R32_SFLOAT:
+    return 4;
+  case VK_FORMAT_R16G16B16A16_UNORM:
+  case VK_FORMAT_R16G16B16A16_SFLOAT:
+  case VK_FORMAT_R32G32_SFLOAT:
+    return 8;
+  case VK_FORMAT_R32G32B32A32_SFLOAT:
+    return 16;
+  default:
+    return 0;
   }
-  pipelineLayouts_.clear();
+}
 
-  for (const auto &framebuffer : framebuffers_) {
-    vkDestroyFramebuffer(device_, framebuffer, nullptr);
-  }
-  framebuffers_.clear();
+/// Converts a float in [0, 1] into an 8-bit normalized value.
+std::uint8_t PackUnorm8(float value) {
+  return static_cast<std::uint8_t>(
+      std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
 
-  for (const auto &renderPass : renderPasses_) {
-    vkDestroyRenderPass(device_, renderPass, nullptr);
+/// Formats a UUID as lowercase hex in the usual 8-4-4-4-12 groups.
+std::string FormatUuid(const std::uint8_t (&uuid)[VK_UUID_SIZE]) {
+  constexpr char kDigits[]{"0123456789abcdef"};
+  std::string text{};
+  for (std::uint32_t i{0}; i < VK_UUID_SIZE; ++i) {
+    if (i == 4 || i == 6 || i == 8 || i == 10) {
+      text += '-';
+    }
+    text += kDigits[uuid[i] >> 4];
+    text += kDigits[uuid[i] & 0xF];
   }
-  renderPasses_.clear();
+  return text;
+}
 
-  for (const auto &shaderModule : shaderModules_) {
-    vkDestroyShaderModule(device_, shaderModule, nullptr);
+/// Strips the dashes and lowercases a hex UUID for comparisons.
+std::string NormalizeUuid(const std::string &uuid) {
+  std::string text{};
+  for (const char c : uuid) {
+    if (c != '-') {
+      text += static_cast<char>(
+          std::tolower(static_cast<unsigned char>(c)));
+    }
   }
-  shaderModules_.clear();
+  return text;
+}
 
-  for (const auto &imageView : imageViews_) {
-    vkDestroyImageView(device_, imageView, nullptr);
-  }
-  imageViews_.clear();
+} // namespace
+
+std::uint16_t PackHalf(float value) {
+  std::uint32_t bits{};
+  std::memcpy(&bits, &value, sizeof(bits));
+  const auto sign = static_cast<std::uint16_t>((bits >> 16) & 0x8000U);
+  const std::uint32_t exponent = (bits >> 23) & 0xFFU;
+  std::uint32_t mantissa = bits & 0x7FFFFFU;
+  if (exponent == 0xFFU) {
+    // Infinity stays infinity, NaN stays a quiet NaN:
+    return static_cast<std::uint16_t>(sign | 0x7C00U |
+                                      (mantissa != 0 ? 0x200U : 0U));
+  }
+  const int halfExponent = static_cast<int>(exponent) - 127 + 15;
+  if (halfExponent >= 0x1F) {
+    return static_cast<std::uint16_t>(sign | 0x7C00U);
+  }
+  // The dropped mantissa bits round the result, ties to even. A carry out of
+  // the mantissa correctly increases the exponent:
+  const auto round = [](std::uint32_t half, std::uint32_t dropped,
+                        std::uint32_t halfway) {
+    return dropped > halfway || (dropped == halfway && (half & 1U) != 0)
+               ? half + 1
+               : half;
+  };
+  if (halfExponent <= 0) {
+    // Subnormal half, the implicit leading bit becomes explicit:
+    if (halfExponent < -10) {
+      return sign;
+    }
+    mantissa |= 0x800000U;
+    const auto shift = static_cast<std::uint32_t>(14 - halfExponent);
+    const auto half = round(mantissa >> shift, mantissa & ((1U << shift) - 1),
+                            1U << (shift - 1));
+    return static_cast<std::uint16_t>(sign | half);
+  }
+  const auto half =
+      round((static_cast<std::uint32_t>(halfExponent) << 10) | (mantissa >> 13),
+            mantissa & 0x1FFFU, 0x1000U);
+  return static_cast<std::uint16_t>(sign | half);
+}
 
-  for (std::size_t i{0}; i < kMaxFramesInFlight; ++i) {
-    vkDestroySemaphore(device_, imageAvailableSemaphores_[i], nullptr);
-    vkDestroySemaphore(device_, renderFinishedSemaphores_[i], nullptr);
-    vkDestroyFence(device_, inFlightFences_[i], nullptr);
+PackedVertex PackVertex(const Vertex &vertex) {
+  PackedVertex packed{};
+  packed.pos = {PackHalf(vertex.pos.x), PackHalf(vertex.pos.y)};
+  packed.color = {PackUnorm8(vertex.color.x), PackUnorm8(vertex.color.y),
+                  PackUnorm8(vertex.color.z), 255};
+  return packed;
+}
+
+std::vector<PackedVertex> PackVertices(Span<const Vertex> vertices) {
+  std::vector<PackedVertex> packed{};
+  packed.reserve(vertices.size());
+  for (const auto &vertex : vertices) {
+    packed.push_back(PackVertex(vertex));
   }
+  return packed;
+}
 
-  for (const auto &commandPool : commandPools_) {
-    vkDestroyCommandPool(device_, commandPool, nullptr);
+void SortDrawItems(Span<DrawItem> drawItems) {
+  std::stable_sort(drawItems.begin(), drawItems.end(),
+                   [](const DrawItem &lhs, const DrawItem &rhs) {
+                     if (lhs.pipeline != rhs.pipeline) {
+                       return std::less<VkPipeline>{}(lhs.pipeline,
+                                                      rhs.pipeline);
+                     }
+                     return lhs.depth < rhs.depth;
+                   });
+}
+
+void Context::Cleanup() {
+  // Pipelines that are still compiling need the device:
+  pipelineThreads_.Cleanup();
+
+  CleanupSwapChain();
+  deletionQueue_.Cleanup();
+  renderGraph_.Cleanup();
+
+  for (auto &acquire : frameUploadAcquires_) {
+    stagingRing_.RecycleAcquire(acquire);
   }
-  commandPools_.clear();
+  frameUploadAcquires_.clear();
+  stagingRing_.Cleanup();
 
-  for (const auto &buffer : vertexBuffers_) {
+  buffers_.ForEach([this](BufferHandle, VkBuffer buffer, VkDeviceSize,
+                          void *, const Allocation &allocation) {
     vkDestroyBuffer(device_, buffer, nullptr);
+    allocator_.Free(allocation);
+  });
+  buffers_.Clear();
+
+  descriptorPools_.ForEach(
+      [this](DescriptorPoolHandle, VkDescriptorPool descriptorPool) {
+        vkDestroyDescriptorPool(device_, descriptorPool, nullptr);
+      });
+  descriptorPools_.Clear();
+  if (bindlessEnabled_) {
+    bindlessTable_.Cleanup();
+    bindlessEnabled_ = false;
+  }
+
+  descriptorSetLayouts_.ForEach([this](DescriptorSetLayoutHandle,
+                                       VkDescriptorSetLayout layout) {
+    vkDestroyDescriptorSetLayout(device_, layout, nullptr);
+  });
+  descriptorSetLayouts_.Clear();
+
+  pipelines_.ForEach([this](PipelineHandle, VkPipeline pipeline) {
+    vkDestroyPipeline(device_, pipeline, nullptr);
+  });
+  pipelines_.Clear();
+
+  pipelineLayouts_.ForEach(
+      [this](PipelineLayoutHandle, VkPipelineLayout pipelineLayout) {
+        vkDestroyPipelineLayout(device_, pipelineLayout, nullptr);
+      });
+  pipelineLayouts_.Clear();
+
+  framebuffers_.ForEach(
+      [this](FramebufferHandle, VkFramebuffer framebuffer) {
+        vkDestroyFramebuffer(device_, framebuffer, nullptr);
+      });
+  framebuffers_.Clear();
+
+  renderPasses_.ForEach(
+      [this](RenderPassHandle, VkRenderPass renderPass, VkFormat) {
+        vkDestroyRenderPass(device_, renderPass, nullptr);
+      });
+  renderPasses_.Clear();
+
+  reloadablePipelines_.clear();
+  shaderLibrary_.Cleanup();
+
+  imageViews_.ForEach([this](ImageViewHandle, VkImageView imageView) {
+    vkDestroyImageView(device_, imageView, nullptr);
+  });
+  imageViews_.Clear();
+
+  for (const auto &semaphore : imageAvailableSemaphores_) {
+    vkDestroySemaphore(device_, semaphore, nullptr);
   }
-  vertexBuffers_.clear();
-  for (const auto &memory : vertexBufferMemories_) {
-    vkFreeMemory(device_, memory, nullptr);
+  imageAvailableSemaphores_.clear();
+  for (const auto &fence : inFlightFences_) {
+    vkDestroyFence(device_, fence, nullptr);
   }
-  vertexBufferMemories_.clear();
-
-  for (const auto &buffer : indexBuffers_) {
-    vkDestroyBuffer(device_, buffer, nullptr);
+  inFlightFences_.clear();
+  if (frameTimeline_.IsInitialized()) {
+    frameTimeline_.Cleanup();
+  }
+  frameTimelineValues_.clear();
+  for (const auto &semaphore : renderFinishedSemaphores_) {
+    vkDestroySemaphore(device_, semaphore, nullptr);
   }
-  indexBuffers_.clear();
-  for (const auto &memory : indexBufferMemories_) {
-    vkFreeMemory(device_, memory, nullptr);
+  renderFinishedSemaphores_.clear();
+
+  commandPools_.ForEach(
+      [this](CommandPoolHandle, VkCommandPool commandPool) {
+        vkDestroyCommandPool(device_, commandPool, nullptr);
+      });
+  commandPools_.Clear();
+
+  recordingThreads_.Cleanup();
+  for (auto &frame : frames_) {
+    frame.Cleanup();
   }
-  indexBufferMemories_.clear();
+  frames_.clear();
+
+  gpuProfiler_.Cleanup();
+  frameStats_.Cleanup();
+  uniformRing_.Cleanup();
+  allocator_.Cleanup();
+  pipelineCache_.Cleanup();
 
   vkDestroyDevice(device_, nullptr);
-  vkDestroySurfaceKHR(instance_, surface_, nullptr);
+  if (surface_ != VK_NULL_HANDLE) {
+    vkDestroySurfaceKHR(instance_, surface_, nullptr);
+  }
   vkDestroyInstance(instance_, nullptr);
 
-  glfwDestroyWindow(window_);
-  glfwTerminate();
+  if (window_ != nullptr) {
+    glfwDestroyWindow(window_);
+    glfwTerminate();
+  }
 }
 
-void Context::InitWindow() {
+void Context::InitWindow(const ContextOptions &options) {
   glfwInit();
   glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+  glfwWindowHint(GLFW_VISIBLE, options.windowVisible ? GLFW_TRUE : GLFW_FALSE);
 
   window_ = glfwCreateWindow(width_, height_, "Vulkan", nullptr, nullptr);
 
@@ -104,8 +296,16 @@ void Context::InitWindow() {
 }
 
 void Context::Initialize(const ContextOptions &options) {
-  // 0) Init window
-  InitWindow();
+  // 0) Init window, there is none in offscreen mode:
+  offscreen_ = options.offscreen;
+  width_ = options.width;
+  height_ = options.height;
+  framesInFlight_ = std::max(options.framesInFlight, 1U);
+  presentModes_ = options.presentModes;
+  swapchainImageCount_ = options.swapchainImageCount;
+  if (!offscreen_) {
+    InitWindow(options);
+  }
 
   // 0) Check validation layers:
   if (options.enableValidationLayers && !CheckValidationLayerSupport()) {
@@ -119,16 +319,30 @@ void Context::Initialize(const ContextOptions &options) {
   appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
   appInfo.pEngineName = "No Engine";
   appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-  appInfo.apiVersion = VK_API_VERSION_1_0;
+  // Descriptor indexing needs the Vulkan 1.1 feature queries. Loaders of
+  // Vulkan 1.0 don't have vkEnumerateInstanceVersion and reject newer
+  // versions:
+  const auto enumerateInstanceVersion =
+      reinterpret_cast<PFN_vkEnumerateInstanceVersion>(
+          vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+  std::uint32_t instanceVersion{VK_API_VERSION_1_0};
+  if (enumerateInstanceVersion != nullptr) {
+    enumerateInstanceVersion(&instanceVersion);
+  }
+  apiVersion_ = instanceVersion >= VK_API_VERSION_1_1 ? VK_API_VERSION_1_1
+                                                      : VK_API_VERSION_1_0;
+  appInfo.apiVersion = apiVersion_;
   VkInstanceCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
   createInfo.pApplicationInfo = &appInfo;
   // Retrieve extension to interface with the window system:
-  std::uint32_t glfwExtensionCount = 0;
-  const char **glfwExtensions =
-      glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-  createInfo.enabledExtensionCount = glfwExtensionCount;
-  createInfo.ppEnabledExtensionNames = glfwExtensions;
+  if (!offscreen_) {
+    std::uint32_t glfwExtensionCount = 0;
+    const char **glfwExtensions =
+        glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    createInfo.enabledExtensionCount = glfwExtensionCount;
+    createInfo.ppEnabledExtensionNames = glfwExtensions;
+  }
   // Set validation layers:
   if (options.enableValidationLayers) {
     createInfo.enabledLayerCount =
@@ -142,37 +356,25 @@ void Context::Initialize(const ContextOptions &options) {
   }
 
   // 2) Window surface creation:
-  if (glfwCreateWindowSurface(instance_, window_, nullptr, &surface_) !=
-      VK_SUCCESS) {
+  if (!offscreen_ && glfwCreateWindowSurface(instance_, window_, nullptr,
+                                             &surface_) != VK_SUCCESS) {
     throw std::runtime_error("failed to create window surface!");
   }
 
   // 3) Pick physical device:
-  // List the graphics cards:
-  std::uint32_t deviceCount = 0;
-  vkEnumeratePhysicalDevices(instance_, &deviceCount, nullptr);
-  if (deviceCount == 0) {
-    throw std::runtime_error("failed to find GPUs with Vulkan support!");
-  }
-  std::vector<VkPhysicalDevice> devices(deviceCount);
-  vkEnumeratePhysicalDevices(instance_, &deviceCount, devices.data());
-  // Pick the suitable one:
-  for (const auto &device : devices) {
-    if (IsDeviceSuitable(device)) {
-      physicalDevice_ = device;
-      break;
-    }
-  }
-  if (physicalDevice_ == VK_NULL_HANDLE) {
-    throw std::runtime_error("failed to find a suitable GPU!");
-  }
+  physicalDevice_ = PickPhysicalDevice(options);
 
   // 4) Create logical device:
   // 4.1) Specifying the queues to be created:
   QueueFamilyIndices indices = FindQueueFamilies(physicalDevice_);
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-  std::set<std::uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(),
-                                                 indices.presentFamily.value()};
+  std::set<std::uint32_t> uniqueQueueFamilies{indices.graphicsFamily.value()};
+  if (indices.presentFamily.has_value()) {
+    uniqueQueueFamilies.insert(indices.presentFamily.value());
+  }
+  if (indices.transferFamily.has_value()) {
+    uniqueQueueFamilies.insert(indices.transferFamily.value());
+  }
   float queuePriority = 1.0f;
   for (std::uint32_t queueFamily : uniqueQueueFamilies) {
     VkDeviceQueueCreateInfo queueCreateInfo{};
@@ -183,19 +385,88 @@ void Context::Initialize(const ContextOptions &options) {
     queueCreateInfos.push_back(queueCreateInfo);
   }
   // 4.2) Set up logical device:
-  // Specifying used device features:
+  // Specifying used device features, optional ones are enabled if supported:
+  VkPhysicalDeviceFeatures supportedFeatures{};
+  vkGetPhysicalDeviceFeatures(physicalDevice_, &supportedFeatures);
   VkPhysicalDeviceFeatures deviceFeatures{};
+  deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+  deviceFeatures.drawIndirectFirstInstance =
+      supportedFeatures.drawIndirectFirstInstance;
+  deviceFeatures.pipelineStatisticsQuery =
+      options.gpuProfiling ? supportedFeatures.pipelineStatisticsQuery
+                           : VK_FALSE;
+  drawIndirectSupport_.multiDraw =
+      supportedFeatures.multiDrawIndirect == VK_TRUE;
+  drawIndirectSupport_.firstInstance =
+      supportedFeatures.drawIndirectFirstInstance == VK_TRUE;
+  // Specifying used device extensions:
+  std::vector<const char *> enabledExtensions{};
+  if (!offscreen_) {
+    enabledExtensions = deviceExtensions_;
+  }
+  drawIndirectSupport_.drawCount = IsDeviceExtensionSupported(
+      physicalDevice_, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+  if (drawIndirectSupport_.drawCount) {
+    enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+  }
+  const bool creationFeedback = IsDeviceExtensionSupported(
+      physicalDevice_, VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+  if (creationFeedback) {
+    enabledExtensions.push_back(
+        VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+  }
+  // Bindless descriptors, only the features used by the bindless set:
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT supportedIndexingFeatures{};
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+  indexingFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+  bindlessEnabled_ =
+      options.bindless &&
+      IsBindlessSupported(physicalDevice_, supportedIndexingFeatures);
+  if (bindlessEnabled_) {
+    enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+    indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+    indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    // Per-object texture indices may differ within a draw:
+    indexingFeatures.shaderSampledImageArrayNonUniformIndexing =
+        supportedIndexingFeatures.shaderSampledImageArrayNonUniformIndexing;
+  } else if (options.bindless) {
+    std::cout << "Context: Bindless descriptors are not supported"
+              << std::endl;
+  }
+  // Timeline semaphores for frame pacing and upload completion:
+  VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{};
+  timelineFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+  const bool timelineEnabled =
+      options.timelineSemaphores && IsTimelineSupported(physicalDevice_);
+  if (timelineEnabled) {
+    enabledExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+    timelineFeatures.timelineSemaphore = VK_TRUE;
+  }
+  // Chaining the enabled feature structures:
+  void *enabledFeatures{nullptr};
+  if (bindlessEnabled_) {
+    indexingFeatures.pNext = enabledFeatures;
+    enabledFeatures = &indexingFeatures;
+  }
+  if (timelineEnabled) {
+    timelineFeatures.pNext = enabledFeatures;
+    enabledFeatures = &timelineFeatures;
+  }
   // Creating the logical device:
   VkDeviceCreateInfo deviceCreateInfo{};
   deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  deviceCreateInfo.pNext = enabledFeatures;
   deviceCreateInfo.queueCreateInfoCount =
       static_cast<uint32_t>(queueCreateInfos.size());
   deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
-  deviceCreateInfo.queueCreateInfoCount = 1;
   deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
   deviceCreateInfo.enabledExtensionCount =
-      static_cast<uint32_t>(deviceExtensions_.size());
-  deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions_.data();
+      static_cast<uint32_t>(enabledExtensions.size());
+  deviceCreateInfo.ppEnabledExtensionNames = enabledExtensions.data();
   if (options.enableValidationLayers) {
     deviceCreateInfo.enabledLayerCount =
         static_cast<std::uint32_t>(validationLayers_.size());
@@ -207,16 +478,137 @@ void Context::Initialize(const ContextOptions &options) {
       VK_SUCCESS) {
     throw std::runtime_error("failed to create logical device!");
   }
+  if (drawIndirectSupport_.drawCount) {
+    cmdDrawIndexedIndirectCount_ =
+        reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+            vkGetDeviceProcAddr(device_, "vkCmdDrawIndexedIndirectCountKHR"));
+    drawIndirectSupport_.drawCount = cmdDrawIndexedIndirectCount_ != nullptr;
+  }
+  if (timelineEnabled) {
+    timelineFunctions_.getSemaphoreCounterValue =
+        reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(
+            vkGetDeviceProcAddr(device_, "vkGetSemaphoreCounterValueKHR"));
+    timelineFunctions_.waitSemaphores =
+        reinterpret_cast<PFN_vkWaitSemaphoresKHR>(
+            vkGetDeviceProcAddr(device_, "vkWaitSemaphoresKHR"));
+  }
+  std::cout << "Context: Timeline semaphores "
+            << timelineFunctions_.IsLoaded() << std::endl;
+  std::cout << "Context: Indirect draws: multi draw "
+            << drawIndirectSupport_.multiDraw << ", first instance "
+            << drawIndirectSupport_.firstInstance << ", draw count "
+            << drawIndirectSupport_.drawCount << std::endl;
 
   // 5) Retrieving queue handles:
   vkGetDeviceQueue(device_, indices.graphicsFamily.value(), 0, &graphicsQueue_);
-  vkGetDeviceQueue(device_, indices.presentFamily.value(), 0, &presentQueue_);
+  if (indices.presentFamily.has_value()) {
+    vkGetDeviceQueue(device_, indices.presentFamily.value(), 0,
+                     &presentQueue_);
+  }
+  const auto transferFamily =
+      indices.transferFamily.value_or(indices.graphicsFamily.value());
+  vkGetDeviceQueue(device_, transferFamily, 0, &transferQueue_);
+  std::cout << "Context: Uploads use queue family " << transferFamily
+            << (indices.transferFamily.has_value() ? " (dedicated)" : "")
+            << std::endl;
 
-  // 6) Create default swapchain.
-  CreateSwapChain();
+  // 6) Create memory allocator.
+  MemoryAllocatorOptions allocatorOptions{};
+  allocatorOptions.physicalDevice = physicalDevice_;
+  allocatorOptions.device = device_;
+  allocator_.Initialize(allocatorOptions);
+  StagingRingOptions stagingRingOptions{};
+  stagingRingOptions.device = device_;
+  stagingRingOptions.allocator = &allocator_;
+  stagingRingOptions.queue = transferQueue_;
+  stagingRingOptions.queueFamilyIndex = transferFamily;
+  stagingRingOptions.dstQueueFamilyIndex = indices.graphicsFamily.value();
+  stagingRingOptions.timelineFunctions = timelineFunctions_;
+  stagingRing_.Initialize(stagingRingOptions);
+  UniformRingOptions uniformRingOptions{};
+  uniformRingOptions.physicalDevice = physicalDevice_;
+  uniformRingOptions.device = device_;
+  uniformRingOptions.allocator = &allocator_;
+  uniformRingOptions.frameCount = framesInFlight_;
+  uniformRingOptions.frameSize = options.uniformRingFrameSize;
+  uniformRing_.Initialize(uniformRingOptions);
+  RenderGraphOptions renderGraphOptions{};
+  renderGraphOptions.physicalDevice = physicalDevice_;
+  renderGraphOptions.device = device_;
+  renderGraphOptions.allocator = &allocator_;
+  renderGraph_.Initialize(renderGraphOptions);
+
+  PipelineCacheOptions pipelineCacheOptions{};
+  pipelineCacheOptions.physicalDevice = physicalDevice_;
+  pipelineCacheOptions.device = device_;
+  pipelineCacheOptions.path = options.pipelineCachePath;
+  pipelineCacheOptions.creationFeedback = creationFeedback;
+  pipelineCache_.Initialize(pipelineCacheOptions);
+  ShaderLibraryOptions shaderLibraryOptions{};
+  shaderLibraryOptions.device = device_;
+  shaderLibraryOptions.hotReload = options.shaderHotReload;
+  shaderLibraryOptions.compiler = options.shaderCompiler;
+  shaderLibrary_.Initialize(shaderLibraryOptions);
+  if (bindlessEnabled_) {
+    CreateBindlessTable(options);
+  }
+  if (options.gpuProfiling) {
+    GpuProfilerOptions profilerOptions{};
+    profilerOptions.physicalDevice = physicalDevice_;
+    profilerOptions.device = device_;
+    profilerOptions.queueFamilyIndex = indices.graphicsFamily.value();
+    profilerOptions.frameCount = framesInFlight_;
+    profilerOptions.pipelineStatistics =
+        deviceFeatures.pipelineStatisticsQuery == VK_TRUE;
+    gpuProfiler_.Initialize(profilerOptions);
+  }
+  FrameStatsOptions frameStatsOptions{};
+  frameStatsOptions.capacity = options.frameStatsCapacity;
+  frameStats_.Initialize(frameStatsOptions);
+  ThreadPoolOptions pipelineThreadOptions{};
+  pipelineThreadOptions.threadCount =
+      options.pipelineThreadCount > 0
+          ? options.pipelineThreadCount
+          : std::max(std::thread::hardware_concurrency(), 1U);
+  pipelineThreads_.Initialize(pipelineThreadOptions);
+
+  // 7) Create default swapchain.
+  depthFormat_ = FindDepthFormat();
+  if (offscreen_) {
+    CreateOffscreenTargets(options);
+  } else {
+    CreateSwapChain();
+  }
 
-  // 7) Create sync objects.
+  // 8) Create sync objects.
   CreateSyncObjects();
+
+  // 9) Create frame contexts and recording threads.
+  CreateFrameContexts(options.recordingThreadCount);
+}
+
+void Context::CreateFrameContexts(std::uint32_t threadCount) {
+  FrameContextOptions frameOptions{};
+  frameOptions.device = device_;
+  frameOptions.queueFamilyIndex =
+      FindQueueFamilies(physicalDevice_).graphicsFamily.value();
+  frameOptions.threadCount = threadCount;
+  frameOptions.uniformRing = &uniformRing_;
+  frames_.resize(framesInFlight_);
+  for (std::uint32_t i{0}; i < framesInFlight_; ++i) {
+    frameOptions.index = i;
+    frames_[i].Initialize(frameOptions);
+  }
+
+  recordingThreadCount_ = threadCount;
+  if (threadCount == 0) {
+    return;
+  }
+  ThreadPoolOptions threadPoolOptions{};
+  threadPoolOptions.threadCount = threadCount;
+  recordingThreads_.Initialize(threadPoolOptions);
+  std::cout << "Context: Recording with " << threadCount << " threads"
+            << std::endl;
 }
 
 bool Context::CheckValidationLayerSupport() {
@@ -245,27 +637,163 @@ bool Context::IsDeviceSuitable(VkPhysicalDevice device) {
   // Queries device properties/details:
   VkPhysicalDeviceProperties deviceProperties;
   vkGetPhysicalDeviceProperties(device, &deviceProperties);
-  VkPhysicalDeviceFeatures deviceFeatures;
-  vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
-  // Checking for swap chain support:
-  const bool extensionsSupported = CheckDeviceExtensionSupport(device);
-  bool swapChainAdequate = false;
-  if (extensionsSupported) {
+  // Checking for swap chain support, nothing is presented offscreen:
+  const bool extensionsSupported =
+      offscreen_ || CheckDeviceExtensionSupport(device);
+  bool swapChainAdequate = offscreen_;
+  if (extensionsSupported && !offscreen_) {
     SwapChainSupportDetails swapChainSupport = QuerySwapChainSupport(device);
     swapChainAdequate = !swapChainSupport.formats.empty() &&
                         !swapChainSupport.presentModes.empty();
   }
-  if (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU &&
-      deviceFeatures.geometryShader &&
-      FindQueueFamilies(device).graphicsFamily.has_value() &&
-      FindQueueFamilies(device).presentFamily.has_value() &&
-      extensionsSupported && swapChainAdequate) {
-    std::cout << "Device ID: " << deviceProperties.deviceID << std::endl;
-    std::cout << "Device name: " << std::string{deviceProperties.deviceName}
-              << std::endl;
-    return true;
+  // Any GPU type is accepted, RateDevice prefers the discrete ones:
+  const auto indices = FindQueueFamilies(device);
+  return deviceProperties.deviceType != VK_PHYSICAL_DEVICE_TYPE_CPU &&
+         indices.graphicsFamily.has_value() &&
+         (offscreen_ || indices.presentFamily.has_value()) &&
+         extensionsSupported && swapChainAdequate;
+}
+
+std::uint64_t Context::RateDevice(VkPhysicalDevice device) {
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(device, &properties);
+  std::uint64_t score{0};
+  switch (properties.deviceType) {
+  case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+    score += 3'000'000;
+    break;
+  case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+    score += 2'000'000;
+    break;
+  case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+    score += 1'000'000;
+    break;
+  default:
+    break;
+  }
+
+  // 100 points per GiB of the largest device local heap, integrated GPUs
+  // report (a part of) the system memory here:
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  vkGetPhysicalDeviceMemoryProperties(device, &memoryProperties);
+  VkDeviceSize heapSize{0};
+  for (std::uint32_t i{0}; i < memoryProperties.memoryHeapCount; ++i) {
+    const auto &heap = memoryProperties.memoryHeaps[i];
+    if (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+      heapSize = std::max(heapSize, heap.size);
+    }
   }
-  return false;
+  score += std::min<std::uint64_t>(100 * (heapSize >> 30), 900'000);
+
+  // Uploads and compute work overlap with the rendering on queues without
+  // graphics:
+  std::uint32_t queueFamilyCount{0};
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount,
+                                           queueFamilies.data());
+  bool dedicatedTransfer{false};
+  bool dedicatedCompute{false};
+  for (const auto &queueFamily : queueFamilies) {
+    if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+      continue;
+    }
+    if (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) {
+      dedicatedCompute = true;
+    } else if (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) {
+      dedicatedTransfer = true;
+    }
+  }
+  score += dedicatedTransfer ? 50 : 0;
+  score += dedicatedCompute ? 50 : 0;
+
+  // Optional features:
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+  score += IsTimelineSupported(device) ? 25 : 0;
+  score += IsBindlessSupported(device, indexingFeatures) ? 25 : 0;
+  score += IsDeviceExtensionSupported(
+               device, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)
+               ? 25
+               : 0;
+  return score;
+}
+
+VkPhysicalDevice Context::PickPhysicalDevice(const ContextOptions &options) {
+  // List the graphics cards:
+  std::uint32_t deviceCount = 0;
+  vkEnumeratePhysicalDevices(instance_, &deviceCount, nullptr);
+  if (deviceCount == 0) {
+    throw std::runtime_error("failed to find GPUs with Vulkan support!");
+  }
+  std::vector<VkPhysicalDevice> devices(deviceCount);
+  vkEnumeratePhysicalDevices(instance_, &deviceCount, devices.data());
+  if (options.deviceIndex.has_value() && *options.deviceIndex >= deviceCount) {
+    throw std::runtime_error("failed to find the pinned GPU index!");
+  }
+  if (!options.deviceUuid.empty() && apiVersion_ < VK_API_VERSION_1_1) {
+    throw std::runtime_error("failed to pin GPU by UUID, needs Vulkan 1.1!");
+  }
+
+  VkPhysicalDevice bestDevice{VK_NULL_HANDLE};
+  std::uint64_t bestScore{0};
+  VkPhysicalDevice pinnedDevice{VK_NULL_HANDLE};
+  for (std::uint32_t i{0}; i < deviceCount; ++i) {
+    const auto device = devices[i];
+    VkPhysicalDeviceIDProperties idProperties{};
+    idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    if (apiVersion_ >= VK_API_VERSION_1_1) {
+      properties.pNext = &idProperties;
+      vkGetPhysicalDeviceProperties2(device, &properties);
+    } else {
+      vkGetPhysicalDeviceProperties(device, &properties.properties);
+    }
+    const auto uuid = FormatUuid(idProperties.deviceUUID);
+    const bool suitable = IsDeviceSuitable(device);
+    const auto score = suitable ? RateDevice(device) : 0;
+    std::cout << "Context: Device " << i << " "
+              << std::string{properties.properties.deviceName} << ", UUID "
+              << uuid << ", score ";
+    if (suitable) {
+      std::cout << score << std::endl;
+    } else {
+      std::cout << "none (not suitable)" << std::endl;
+    }
+
+    const bool pinned =
+        options.deviceIndex.has_value()
+            ? *options.deviceIndex == i
+            : !options.deviceUuid.empty() &&
+                  NormalizeUuid(options.deviceUuid) == NormalizeUuid(uuid);
+    if (pinned) {
+      if (!suitable) {
+        throw std::runtime_error("failed to use the pinned GPU, it is not "
+                                 "suitable!");
+      }
+      pinnedDevice = device;
+    }
+    if (suitable && (bestDevice == VK_NULL_HANDLE || score > bestScore)) {
+      bestDevice = device;
+      bestScore = score;
+    }
+  }
+
+  const bool pinning =
+      options.deviceIndex.has_value() || !options.deviceUuid.empty();
+  if (pinning && pinnedDevice == VK_NULL_HANDLE) {
+    throw std::runtime_error("failed to find the pinned GPU UUID!");
+  }
+  const auto device = pinning ? pinnedDevice : bestDevice;
+  if (device == VK_NULL_HANDLE) {
+    throw std::runtime_error("failed to find a suitable GPU!");
+  }
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(device, &properties);
+  std::cout << "Device ID: " << properties.deviceID << std::endl;
+  std::cout << "Device name: " << std::string{properties.deviceName}
+            << std::endl;
+  return device;
 }
 
 bool Context::CheckDeviceExtensionSupport(VkPhysicalDevice device) {
@@ -285,6 +813,95 @@ bool Context::CheckDeviceExtensionSupport(VkPhysicalDevice device) {
   return requiredExtensions.empty();
 }
 
+bool Context::IsDeviceExtensionSupported(VkPhysicalDevice device,
+                                         const char *extensionName) {
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                       nullptr);
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                       availableExtensions.data());
+
+  for (const auto &extension : availableExtensions) {
+    if (std::string_view{extension.extensionName} == extensionName) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Context::IsBindlessSupported(
+    VkPhysicalDevice device,
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT &features) {
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(device, &properties);
+  if (apiVersion_ < VK_API_VERSION_1_1 ||
+      properties.apiVersion < VK_API_VERSION_1_1 ||
+      !IsDeviceExtensionSupported(device,
+                                  VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) {
+    return false;
+  }
+  features = VkPhysicalDeviceDescriptorIndexingFeaturesEXT{};
+  features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+  VkPhysicalDeviceFeatures2 features2{};
+  features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features2.pNext = &features;
+  vkGetPhysicalDeviceFeatures2(device, &features2);
+  return features.runtimeDescriptorArray == VK_TRUE &&
+         features.descriptorBindingPartiallyBound == VK_TRUE &&
+         features.descriptorBindingStorageBufferUpdateAfterBind == VK_TRUE &&
+         features.descriptorBindingSampledImageUpdateAfterBind == VK_TRUE;
+}
+
+bool Context::IsTimelineSupported(VkPhysicalDevice device) {
+  if (apiVersion_ < VK_API_VERSION_1_1 ||
+      !IsDeviceExtensionSupported(device,
+                                  VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+    return false;
+  }
+  VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{};
+  timelineFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+  VkPhysicalDeviceFeatures2 features2{};
+  features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features2.pNext = &timelineFeatures;
+  vkGetPhysicalDeviceFeatures2(device, &features2);
+  return timelineFeatures.timelineSemaphore == VK_TRUE;
+}
+
+void Context::CreateBindlessTable(const ContextOptions &options) {
+  VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties{};
+  indexingProperties.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+  VkPhysicalDeviceProperties2 properties{};
+  properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties.pNext = &indexingProperties;
+  vkGetPhysicalDeviceProperties2(physicalDevice_, &properties);
+  // Both arrays are visible to the vertex and fragment stages, and a
+  // combined image sampler counts as a sampled image and a sampler:
+  const auto resourceLimit =
+      indexingProperties.maxPerStageUpdateAfterBindResources;
+  BindlessTableOptions tableOptions{};
+  tableOptions.device = device_;
+  tableOptions.storageBufferCount = std::min(
+      {options.bindlessStorageBufferCount,
+       indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers,
+       indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+       resourceLimit / 2});
+  tableOptions.textureCount = std::min(
+      {options.bindlessTextureCount,
+       indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+       indexingProperties.maxDescriptorSetUpdateAfterBindSamplers,
+       indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+       indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+       resourceLimit - resourceLimit / 2});
+  bindlessTable_.Initialize(tableOptions);
+  std::cout << "Context: Bindless set of " << tableOptions.storageBufferCount
+            << " storage buffers and " << tableOptions.textureCount
+            << " textures" << std::endl;
+}
+
 Context::QueueFamilyIndices
 Context::FindQueueFamilies(VkPhysicalDevice device) {
   QueueFamilyIndices indices;
@@ -293,21 +910,30 @@ Context::FindQueueFamilies(VkPhysicalDevice device) {
   std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
   vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount,
                                            queueFamilies.data());
-  int i = 0;
+  std::uint32_t i = 0;
+  bool transferOnly = false;
   for (const auto &queueFamily : queueFamilies) {
     VkBool32 presentSupport = false;
-    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
-    if (presentSupport) {
+    if (surface_ != VK_NULL_HANDLE) {
+      vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_,
+                                           &presentSupport);
+    }
+    if (presentSupport && !indices.presentFamily.has_value()) {
       indices.presentFamily = i;
     }
-    if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+    if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
+        !indices.graphicsFamily.has_value()) {
       indices.graphicsFamily = i;
     }
 
-    // Is indicies complete?
-    if (indices.presentFamily.has_value() &&
-        indices.graphicsFamily.has_value()) {
-      break;
+    // Transfer family: compute families support transfers implicitly, but a
+    // transfer-only family (DMA engine) is preferred:
+    const auto flags = queueFamily.queueFlags;
+    if (!(flags & VK_QUEUE_GRAPHICS_BIT) &&
+        (flags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT)) &&
+        queueFamily.queueCount > 0 && !transferOnly) {
+      indices.transferFamily = i;
+      transferOnly = !(flags & VK_QUEUE_COMPUTE_BIT);
     }
 
     i++;
@@ -359,12 +985,12 @@ VkSurfaceFormatKHR Context::ChooseSwapSurfaceFormat(
 
 VkPresentModeKHR Context::ChooseSwapPresentMode(
     const std::vector<VkPresentModeKHR> &availablePresentModes) {
-  for (const auto &availablePresentMode : availablePresentModes) {
-    if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-      std::cout
-          << "Swap chain: Present mode: VK_PRESENT_MODE_MAILBOX_KHR is used"
-          << std::endl;
-      return availablePresentMode;
+  for (const auto &presentMode : presentModes_) {
+    if (std::find(availablePresentModes.begin(), availablePresentModes.end(),
+                  presentMode) != availablePresentModes.end()) {
+      std::cout << "Swap chain: Present mode: "
+                << GetPresentModeName(presentMode) << " is used" << std::endl;
+      return presentMode;
     }
   }
   std::cout << "Swap chain: Present mode: VK_PRESENT_MODE_FIFO_KHR is used"
@@ -400,7 +1026,7 @@ Context::ChooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities) {
   }
 }
 
-void Context::CreateSwapChain() {
+void Context::CreateSwapChain(VkSwapchainKHR oldSwapChain) {
   SwapChainSupportDetails swapChainSupport =
       QuerySwapChainSupport(physicalDevice_);
   VkSurfaceFormatKHR surfaceFormat =
@@ -417,6 +1043,10 @@ void Context::CreateSwapChain() {
   // another image to render to. Therefore it is recommended to request at
   // least one more image than the minimum:
   uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+  if (swapchainImageCount_ > 0) {
+    imageCount = std::max(swapchainImageCount_,
+                          swapChainSupport.capabilities.minImageCount);
+  }
   if (swapChainSupport.capabilities.maxImageCount > 0 &&
       imageCount > swapChainSupport.capabilities.maxImageCount) {
     imageCount = swapChainSupport.capabilities.maxImageCount;
@@ -456,7 +1086,7 @@ void Context::CreateSwapChain() {
   createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
   createInfo.presentMode = presentMode;
   createInfo.clipped = VK_TRUE;
-  createInfo.oldSwapchain = VK_NULL_HANDLE;
+  createInfo.oldSwapchain = oldSwapChain;
 
   if (vkCreateSwapchainKHR(device_, &createInfo, nullptr, &swapChain_) !=
       VK_SUCCESS) {
@@ -469,6 +1099,19 @@ void Context::CreateSwapChain() {
   vkGetSwapchainImagesKHR(device_, swapChain_, &imageCount,
                           swapChainImages_.data());
 
+  // Render finished semaphores are kept across recreations, there have to be
+  // as many as images:
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  while (renderFinishedSemaphores_.size() < imageCount) {
+    VkSemaphore semaphore{VK_NULL_HANDLE};
+    if (vkCreateSemaphore(device_, &semaphoreInfo, nullptr, &semaphore) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create semaphores!");
+    }
+    renderFinishedSemaphores_.push_back(semaphore);
+  }
+
   swapChainImageFormat_ = surfaceFormat.format;
   swapChainExtent_ = extent;
 
@@ -477,27 +1120,217 @@ void Context::CreateSwapChain() {
     ImageViewOptions options{};
     options.image = image;
     options.format = swapChainImageFormat_;
-    const auto imageView = CreateImageView(options);
-    imageViews_.pop_back();
-    swapChainImageViews_.push_back(imageView);
+    swapChainImageViews_.push_back(CreateVkImageView(options));
   }
 
   currentSwapchainImageIndex_ = 0;
 }
 
-void Context::CreateSwapChainFramebuffers(VkRenderPass renderPass) {
+void Context::CreateOffscreenTargets(const ContextOptions &options) {
+  swapChainImageFormat_ = options.offscreenFormat;
+  swapChainExtent_ = VkExtent2D{width_, height_};
+  // Cached memory makes the CPU reads of the readback fast, but it may not
+  // exist on every device:
+  VkMemoryPropertyFlags readbackProperties{
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+      VK_MEMORY_PROPERTY_HOST_CACHED_BIT};
+  if (!allocator_.TryFindMemoryType(~0U, readbackProperties).has_value()) {
+    readbackProperties &= ~VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+  }
+  const auto texelSize = GetTexelSize(swapChainImageFormat_);
+  if (texelSize == 0) {
+    throw std::runtime_error("failed to find texel size of offscreen format!");
+  }
+  const VkDeviceSize readbackSize =
+      static_cast<VkDeviceSize>(width_) * height_ * texelSize;
+
+  for (std::uint32_t i{0}; i < framesInFlight_; ++i) {
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = swapChainImageFormat_;
+    imageInfo.extent = VkExtent3D{width_, height_, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                      VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkImage image{VK_NULL_HANDLE};
+    if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create offscreen image!");
+    }
+    swapChainImages_.push_back(image);
+    offscreenImageAllocations_.push_back(AllocateImageMemory(image));
+
+    ImageViewOptions viewOptions{};
+    viewOptions.image = image;
+    viewOptions.format = swapChainImageFormat_;
+    swapChainImageViews_.push_back(CreateVkImageView(viewOptions));
+
+    if (options.offscreenReadback) {
+      VkBuffer buffer{VK_NULL_HANDLE};
+      Allocation bufferAllocation{};
+      CreateBuffer(readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                   readbackProperties, buffer, bufferAllocation);
+      readbackBuffers_.push_back(buffer);
+      readbackAllocations_.push_back(bufferAllocation);
+    }
+  }
+  readbackPending_.assign(framesInFlight_, false);
+  latestReadback_.reset();
+  currentSwapchainImageIndex_ = 0;
+  std::cout << "Context: Offscreen rendering into " << framesInFlight_
+            << " images of " << width_ << "x" << height_ << ", readback "
+            << options.offscreenReadback << std::endl;
+}
+
+Allocation Context::AllocateImageMemory(VkImage image) {
+  // Optimal tiling images must not share a bufferImageGranularity page with
+  // the buffers sub-allocated from the same memory block:
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice_, &properties);
+  const auto granularity = properties.limits.bufferImageGranularity;
+  VkMemoryRequirements memRequirements;
+  vkGetImageMemoryRequirements(device_, image, &memRequirements);
+  memRequirements.alignment = std::max(memRequirements.alignment, granularity);
+  memRequirements.size = AlignUp(memRequirements.size, granularity);
+  const auto allocation =
+      allocator_.Allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  vkBindImageMemory(device_, image, allocation.memory, allocation.offset);
+  return allocation;
+}
+
+VkFormat Context::FindDepthFormat() const {
+  for (const auto format : {VK_FORMAT_D32_SFLOAT,
+                            VK_FORMAT_D32_SFLOAT_S8_UINT,
+                            VK_FORMAT_D24_UNORM_S8_UINT}) {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice_, format, &properties);
+    if (properties.optimalTilingFeatures &
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+      return format;
+    }
+  }
+  throw std::runtime_error("failed to find a depth format!");
+}
+
+void Context::CreateDepthTarget() {
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.format = depthFormat_;
+  imageInfo.extent =
+      VkExtent3D{swapChainExtent_.width, swapChainExtent_.height, 1};
+  imageInfo.mipLevels = 1;
+  imageInfo.arrayLayers = 1;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  if (vkCreateImage(device_, &imageInfo, nullptr, &depthImage_) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create depth image!");
+  }
+  depthImageAllocation_ = AllocateImageMemory(depthImage_);
+
+  ImageViewOptions viewOptions{};
+  viewOptions.image = depthImage_;
+  viewOptions.format = depthFormat_;
+  viewOptions.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+  depthImageView_ = CreateVkImageView(viewOptions);
+}
+
+void Context::RecordReadback(VkCommandBuffer commandBuffer) {
+  // The render pass leaves the image in TRANSFER_SRC_OPTIMAL layout:
+  VkImageMemoryBarrier imageBarrier{};
+  imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  imageBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  imageBarrier.image = swapChainImages_[currentSwapchainImageIndex_];
+  imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  imageBarrier.subresourceRange.levelCount = 1;
+  imageBarrier.subresourceRange.layerCount = 1;
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &imageBarrier);
+
+  VkBufferImageCopy region{};
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent = VkExtent3D{swapChainExtent_.width,
+                                  swapChainExtent_.height, 1};
+  const auto buffer = readbackBuffers_[currentSwapchainImageIndex_];
+  vkCmdCopyImageToBuffer(commandBuffer,
+                         swapChainImages_[currentSwapchainImageIndex_],
+                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1,
+                         &region);
+
+  // The host reads the buffer after the frame fence:
+  VkBufferMemoryBarrier bufferBarrier{};
+  bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  bufferBarrier.buffer = buffer;
+  bufferBarrier.size = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1,
+                       &bufferBarrier, 0, nullptr);
+  readbackPending_[currentFrame_] = true;
+}
+
+OffscreenReadback Context::GetOffscreenReadback() const {
+  OffscreenReadback readback{};
+  if (!latestReadback_.has_value()) {
+    return readback;
+  }
+  const auto &allocation = readbackAllocations_[*latestReadback_];
+  readback.data = allocation.mappedData;
+  readback.size = static_cast<VkDeviceSize>(swapChainExtent_.width) *
+                  swapChainExtent_.height *
+                  GetTexelSize(swapChainImageFormat_);
+  readback.extent = swapChainExtent_;
+  readback.format = swapChainImageFormat_;
+  return readback;
+}
+
+void Context::CreateSwapChainFramebuffers(RenderPassHandle renderPass) {
+  const auto depthFormat =
+      renderPasses_.Get<kRenderPassDepthFormatField>(renderPass);
+  if (depthFormat == nullptr) {
+    throw std::runtime_error(
+        "failed to create framebuffers of stale render pass handle!");
+  }
+  const bool depth = *depthFormat != VK_FORMAT_UNDEFINED;
+  if (depth && depthImage_ == VK_NULL_HANDLE) {
+    CreateDepthTarget();
+  }
   for (const auto &imageView : swapChainImageViews_) {
     FrameBufferOptions options{};
-    options.renderPass = renderPass;
+    options.renderPass = GetRenderPass(renderPass);
     options.extent = swapChainExtent_;
     options.imageAttachment = imageView;
-    const auto framebuffer = CreateFramebuffer(options);
-    framebuffers_.pop_back();
-    swapChainFramebuffers_.push_back(framebuffer);
+    options.depthAttachment = depth ? depthImageView_ : VK_NULL_HANDLE;
+    swapChainFramebuffers_.push_back(CreateVkFramebuffer(options));
   }
 }
 
-VkImageView Context::CreateImageView(const ImageViewOptions &options) {
+ImageViewHandle Context::CreateImageView(const ImageViewOptions &options) {
+  return imageViews_.Allocate(CreateVkImageView(options));
+}
+
+VkImageView Context::CreateVkImageView(const ImageViewOptions &options) {
   VkImageViewCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
   createInfo.image = options.image;
@@ -507,7 +1340,7 @@ VkImageView Context::CreateImageView(const ImageViewOptions &options) {
   createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
   createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
   createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-  createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  createInfo.subresourceRange.aspectMask = options.aspectMask;
   createInfo.subresourceRange.baseMipLevel = 0;
   createInfo.subresourceRange.levelCount = 1;
   createInfo.subresourceRange.baseArrayLayer = 0;
@@ -517,27 +1350,18 @@ VkImageView Context::CreateImageView(const ImageViewOptions &options) {
       VK_SUCCESS) {
     throw std::runtime_error("failed to create image views!");
   }
-
-  imageViews_.push_back(imageView);
   return imageView;
 }
 
-VkShaderModule Context::CreateShaderModule(const std::vector<char> &code) {
-  VkShaderModuleCreateInfo createInfo{};
-  createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  createInfo.codeSize = code.size();
-  createInfo.pCode = reinterpret_cast<const std::uint32_t *>(code.data());
-  VkShaderModule shaderModule;
-  if (vkCreateShaderModule(device_, &createInfo, nullptr, &shaderModule) !=
-      VK_SUCCESS) {
-    throw std::runtime_error("failed to create shader module!");
-  }
+VkShaderModule Context::CreateShaderModule(Span<const char> code) {
+  return shaderLibrary_.CreateModule(code);
+}
 
-  shaderModules_.push_back(shaderModule);
-  return shaderModule;
+ShaderHandle Context::LoadShader(const ShaderFileOptions &options) {
+  return shaderLibrary_.Load(options);
 }
 
-VkRenderPass Context::CreateRenderPass(const RenderPassOptions &options) {
+RenderPassHandle Context::CreateRenderPass(const RenderPassOptions &options) {
   // Attachment description:
   VkAttachmentDescription colorAttachment{};
   colorAttachment.format = options.format;
@@ -547,7 +1371,10 @@ VkRenderPass Context::CreateRenderPass(const RenderPassOptions &options) {
   colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  // Offscreen images are copied to the readback buffers afterwards:
+  colorAttachment.finalLayout = offscreen_
+                                    ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                    : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
   // Attachment references.
   // Specifies which attachment to reference by its index in the attachment
@@ -564,6 +1391,26 @@ VkRenderPass Context::CreateRenderPass(const RenderPassOptions &options) {
   subpass.colorAttachmentCount = 1;
   subpass.pColorAttachments = &colorAttachmentRef;
 
+  // The depth is only needed during the pass, it is cleared at the start and
+  // not stored:
+  const bool depth = options.depthFormat != VK_FORMAT_UNDEFINED;
+  VkAttachmentDescription depthAttachment{};
+  depthAttachment.format = options.depthFormat;
+  depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  depthAttachment.finalLayout =
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  VkAttachmentReference depthAttachmentRef{};
+  depthAttachmentRef.attachment = 1;
+  depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  if (depth) {
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
+  }
+
   // Subpass dependencies.
   // The subpasses in a render pass automatically take care of image layout
   // transitions. These transitions are controlled by subpass dependencies,
@@ -577,12 +1424,22 @@ VkRenderPass Context::CreateRenderPass(const RenderPassOptions &options) {
   dependency.srcAccessMask = 0;
   dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
   dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  if (depth) {
+    // The frames share the depth image, the depth tests of a frame wait for
+    // the depth writes of the previous one:
+    dependency.srcStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.srcAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependency.dstStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependency.dstAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  }
 
   // Render pass.
+  const VkAttachmentDescription attachments[] = {colorAttachment,
+                                                 depthAttachment};
   VkRenderPassCreateInfo renderPassInfo{};
   renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-  renderPassInfo.attachmentCount = 1;
-  renderPassInfo.pAttachments = &colorAttachment;
+  renderPassInfo.attachmentCount = depth ? 2 : 1;
+  renderPassInfo.pAttachments = attachments;
   renderPassInfo.subpassCount = 1;
   renderPassInfo.pSubpasses = &subpass;
   renderPassInfo.dependencyCount = 1;
@@ -594,19 +1451,25 @@ VkRenderPass Context::CreateRenderPass(const RenderPassOptions &options) {
     throw std::runtime_error("failed to create render pass!");
   }
 
-  renderPasses_.push_back(renderPass);
-  return renderPass;
+  return renderPasses_.Allocate(renderPass, options.depthFormat);
+}
+
+FramebufferHandle
+Context::CreateFramebuffer(const FrameBufferOptions &options) {
+  return framebuffers_.Allocate(CreateVkFramebuffer(options));
 }
 
-VkFramebuffer Context::CreateFramebuffer(const FrameBufferOptions &options) {
-  VkImageView attachments[] = {options.imageAttachment};
+VkFramebuffer Context::CreateVkFramebuffer(const FrameBufferOptions &options) {
+  VkImageView attachments[] = {options.imageAttachment,
+                               options.depthAttachment};
   VkFramebufferCreateInfo framebufferInfo{};
   framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
   // You can only use a framebuffer with the render passes that it is
   // compatible with, which roughly means that they use the same number and
   // type of attachments.
   framebufferInfo.renderPass = options.renderPass;
-  framebufferInfo.attachmentCount = 1;
+  framebufferInfo.attachmentCount =
+      options.depthAttachment != VK_NULL_HANDLE ? 2 : 1;
   framebufferInfo.pAttachments = attachments;
   framebufferInfo.width = options.extent.width;
   framebufferInfo.height = options.extent.height;
@@ -618,12 +1481,10 @@ VkFramebuffer Context::CreateFramebuffer(const FrameBufferOptions &options) {
       VK_SUCCESS) {
     throw std::runtime_error("failed to create framebuffer!");
   }
-
-  framebuffers_.push_back(framebuffer);
   return framebuffer;
 }
 
-VkDescriptorSetLayout
+DescriptorSetLayoutHandle
 Context::CreateDescriptorSetLayout(const DescriptorSetLayoutOptions &options) {
   VkDescriptorSetLayoutBinding layoutBinding{};
   layoutBinding.binding = options.binding;
@@ -633,37 +1494,60 @@ Context::CreateDescriptorSetLayout(const DescriptorSetLayoutOptions &options) {
   layoutBinding.pImmutableSamplers = nullptr; // Optional
   VkDescriptorSetLayoutCreateInfo layoutInfo{};
   layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-  layoutInfo.bindingCount = 1;
-  layoutInfo.pBindings = &layoutBinding;
+  if (options.bindings.empty()) {
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &layoutBinding;
+  } else {
+    layoutInfo.bindingCount =
+        static_cast<std::uint32_t>(options.bindings.size());
+    layoutInfo.pBindings = options.bindings.data();
+  }
   VkDescriptorSetLayout descriptorSetLayout{VK_NULL_HANDLE};
   if (vkCreateDescriptorSetLayout(device_, &layoutInfo, nullptr,
                                   &descriptorSetLayout) != VK_SUCCESS) {
     throw std::runtime_error("failed to create descriptor set layout!");
   }
 
-  descriptorSetLayouts_.push_back(descriptorSetLayout);
-  return descriptorSetLayout;
+  return descriptorSetLayouts_.Allocate(descriptorSetLayout);
 }
 
-VkPipelineLayout
+PipelineLayoutHandle
 Context::CreatePipelineLayout(const PipelineLayoutOptions &options) {
+  // Push constants have to fit into the device limit:
+  VkPhysicalDeviceProperties deviceProperties;
+  vkGetPhysicalDeviceProperties(physicalDevice_, &deviceProperties);
+  for (const auto &range : options.pushConstantRanges) {
+    if (range.offset + range.size >
+        deviceProperties.limits.maxPushConstantsSize) {
+      throw std::runtime_error("failed to fit push constant range!");
+    }
+  }
+
   VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
   pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipelineLayoutInfo.setLayoutCount = 1;
-  pipelineLayoutInfo.pSetLayouts = &options.descriptorSetLayout;
-  pipelineLayoutInfo.pushConstantRangeCount = 0;    // Optional
-  pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
+  if (options.descriptorSetLayouts.empty()) {
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &options.descriptorSetLayout;
+  } else {
+    pipelineLayoutInfo.setLayoutCount =
+        static_cast<std::uint32_t>(options.descriptorSetLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = options.descriptorSetLayouts.data();
+  }
+  pipelineLayoutInfo.pushConstantRangeCount =
+      static_cast<std::uint32_t>(options.pushConstantRanges.size());
+  pipelineLayoutInfo.pPushConstantRanges =
+      options.pushConstantRanges.empty() ? nullptr
+                                         : options.pushConstantRanges.data();
   VkPipelineLayout pipelineLayout{VK_NULL_HANDLE};
   if (vkCreatePipelineLayout(device_, &pipelineLayoutInfo, nullptr,
                              &pipelineLayout) != VK_SUCCESS) {
     throw std::runtime_error("failed to create pipeline layout!");
   }
 
-  pipelineLayouts_.push_back(pipelineLayout);
-  return pipelineLayout;
+  return pipelineLayouts_.Allocate(pipelineLayout);
 }
 
-VkPipeline
+PipelineHandle
 Context::CreateGraphicsPipeline(const GraphicsPipelineOptions &options) {
   // Shader stage creation:
   VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
@@ -695,15 +1579,30 @@ Context::CreateGraphicsPipeline(const GraphicsPipelineOptions &options) {
   // Vertex input.
   // Describe the format of the vertex data that will be passed to the vertex
   // shader.
-  auto bindingDescription = GetBindingDescription();
-  auto attributeDescriptions = GetAttributeDescriptions();
+  const bool packed = options.vertexFormat == VertexFormat::Packed;
+  std::vector<VkVertexInputBindingDescription> bindingDescriptions{
+      packed ? GetBindingDescription<PackedVertex>()
+             : GetBindingDescription<Vertex>()};
+  const auto vertexAttributes = packed
+                                    ? GetAttributeDescriptions<PackedVertex>()
+                                    : GetAttributeDescriptions<Vertex>();
+  std::vector<VkVertexInputAttributeDescription> attributeDescriptions(
+      vertexAttributes.begin(), vertexAttributes.end());
+  if (options.instanced) {
+    bindingDescriptions.push_back(GetInstanceBindingDescription());
+    const auto instanceAttributes = GetInstanceAttributeDescriptions();
+    attributeDescriptions.insert(attributeDescriptions.end(),
+                                 instanceAttributes.begin(),
+                                 instanceAttributes.end());
+  }
   VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
   vertexInputInfo.sType =
       VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-  vertexInputInfo.vertexBindingDescriptionCount = 1;
+  vertexInputInfo.vertexBindingDescriptionCount =
+      static_cast<std::uint32_t>(bindingDescriptions.size());
   vertexInputInfo.vertexAttributeDescriptionCount =
       static_cast<std::uint32_t>(attributeDescriptions.size());
-  vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+  vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
   vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
   // Input assembly.
@@ -795,6 +1694,18 @@ Context::CreateGraphicsPipeline(const GraphicsPipelineOptions &options) {
   colorBlending.blendConstants[2] = 0.0f; // Optional
   colorBlending.blendConstants[3] = 0.0f; // Optional
 
+  // Depth testing.
+  // Fragments behind the stored depth are discarded, with the draws sorted
+  // front to back mostly before the fragment shader runs (early-Z).
+  VkPipelineDepthStencilStateCreateInfo depthStencil{};
+  depthStencil.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  depthStencil.depthTestEnable = options.depthTest ? VK_TRUE : VK_FALSE;
+  depthStencil.depthWriteEnable = options.depthTest ? VK_TRUE : VK_FALSE;
+  depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+  depthStencil.depthBoundsTestEnable = VK_FALSE;
+  depthStencil.stencilTestEnable = VK_FALSE;
+
   // Graphics pipeline:
   VkGraphicsPipelineCreateInfo pipelineInfo{};
   pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -805,7 +1716,7 @@ Context::CreateGraphicsPipeline(const GraphicsPipelineOptions &options) {
   pipelineInfo.pViewportState = &viewportState;
   pipelineInfo.pRasterizationState = &rasterizer;
   pipelineInfo.pMultisampleState = &multisampling;
-  pipelineInfo.pDepthStencilState = nullptr; // Optional
+  pipelineInfo.pDepthStencilState = &depthStencil;
   pipelineInfo.pColorBlendState = &colorBlending;
   pipelineInfo.pDynamicState = &dynamicState;
   pipelineInfo.layout = options.pipelineLayout;
@@ -813,17 +1724,103 @@ Context::CreateGraphicsPipeline(const GraphicsPipelineOptions &options) {
   pipelineInfo.subpass = 0;
   pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
   pipelineInfo.basePipelineIndex = -1;              // Optional
-  VkPipeline pipeline{VK_NULL_HANDLE};
-  if (vkCreateGraphicsPipelines(device_, VK_NULL_HANDLE, 1, &pipelineInfo,
-                                nullptr, &pipeline) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create graphics pipeline!");
+  const auto pipeline = pipelineCache_.CreateGraphicsPipeline(pipelineInfo);
+
+  std::lock_guard<std::mutex> lock{pipelinesMutex_};
+  return pipelines_.Allocate(pipeline);
+}
+
+std::vector<AsyncPipeline> Context::CreateGraphicsPipelinesAsync(
+    const std::vector<GraphicsPipelineOptions> &options, VkPipeline fallback) {
+  std::vector<AsyncPipeline> pipelines{};
+  for (const auto &pipelineOptions : options) {
+    auto future = pipelineThreads_.Submit([this, pipelineOptions] {
+      const auto pipeline = CreateGraphicsPipeline(pipelineOptions);
+      return CompiledPipeline{pipeline, GetPipeline(pipeline)};
+    });
+    pipelines.emplace_back(future.share(), fallback);
+  }
+  return pipelines;
+}
+
+ReloadablePipeline
+Context::CreateReloadablePipeline(const ReloadablePipelineOptions &options) {
+  auto pipelineOptions = options.pipeline;
+  pipelineOptions.vertexShader = GetShaderModule(options.vertexShader);
+  pipelineOptions.fragmentShader = GetShaderModule(options.fragmentShader);
+  ReloadablePipelineState state{};
+  state.options = options;
+  state.current = CreateGraphicsPipelinesAsync({pipelineOptions})[0];
+  reloadablePipelines_.push_back(std::move(state));
+  return ReloadablePipeline{
+      static_cast<std::uint32_t>(reloadablePipelines_.size() - 1)};
+}
+
+void Context::ReloadPipelines() {
+  const auto reloaded = shaderLibrary_.Poll();
+  for (auto &state : reloadablePipelines_) {
+    const bool affected = std::any_of(
+        reloaded.begin(), reloaded.end(), [&state](ShaderHandle shader) {
+          return shader.index == state.options.vertexShader.index ||
+                 shader.index == state.options.fragmentShader.index;
+        });
+    state.outdated = state.outdated || affected;
+
+    // The swap waits for the current pipeline as well, so that it can be
+    // destroyed:
+    if (state.pending.IsReady() && state.current.IsReady()) {
+      VkPipeline pipeline{VK_NULL_HANDLE};
+      try {
+        pipeline = state.pending.Get();
+      } catch (const std::runtime_error &error) {
+        std::cout << "Context: Keeping the previous pipeline, "
+                  << error.what() << std::endl;
+      }
+      if (pipeline != VK_NULL_HANDLE) {
+        try {
+          DestroyPipeline(state.current.GetHandle());
+        } catch (const std::runtime_error &) {
+          // The current pipeline failed to compile, there is nothing to
+          // destroy.
+        }
+        state.current = state.pending;
+        std::cout << "Context: Swapped in a reloaded pipeline" << std::endl;
+      }
+      state.pending = AsyncPipeline{};
+    }
+    if (state.outdated && !state.pending.IsValid()) {
+      auto pipelineOptions = state.options.pipeline;
+      pipelineOptions.vertexShader =
+          GetShaderModule(state.options.vertexShader);
+      pipelineOptions.fragmentShader =
+          GetShaderModule(state.options.fragmentShader);
+      state.pending = CreateGraphicsPipelinesAsync({pipelineOptions})[0];
+      state.outdated = false;
+    }
   }
+}
 
-  pipelines_.push_back(pipeline);
-  return pipeline;
+PipelineHandle
+Context::CreateComputePipeline(const ComputePipelineOptions &options) {
+  VkPipelineShaderStageCreateInfo stageInfo{};
+  stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  stageInfo.module = options.computeShader;
+  stageInfo.pName = "main";
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage = stageInfo;
+  pipelineInfo.layout = options.pipelineLayout;
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
+  pipelineInfo.basePipelineIndex = -1;              // Optional
+  const auto pipeline = pipelineCache_.CreateComputePipeline(pipelineInfo);
+
+  std::lock_guard<std::mutex> lock{pipelinesMutex_};
+  return pipelines_.Allocate(pipeline);
 }
 
-VkCommandPool Context::CreateCommandPool(const CommandPoolOptions &options) {
+CommandPoolHandle
+Context::CreateCommandPool(const CommandPoolOptions &options) {
   QueueFamilyIndices queueFamilyIndices = FindQueueFamilies(physicalDevice_);
   VkCommandPoolCreateInfo poolInfo{};
   poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -835,8 +1832,7 @@ VkCommandPool Context::CreateCommandPool(const CommandPoolOptions &options) {
     throw std::runtime_error("failed to create command pool!");
   }
 
-  commandPools_.push_back(commandPool);
-  return commandPool;
+  return commandPools_.Allocate(commandPool);
 }
 
 VkCommandBuffer
@@ -856,27 +1852,9 @@ Context::CreateCommandBuffer(const CommandBufferOptions &options) {
   return commandBuffer;
 }
 
-std::uint32_t Context::FindMemoryType(std::uint32_t typeFilter,
-                                      VkMemoryPropertyFlags properties) {
-  VkPhysicalDeviceMemoryProperties memProperties;
-  vkGetPhysicalDeviceMemoryProperties(physicalDevice_, &memProperties);
-  std::cout << "Vertex Buffer: Find memory type: Memory type count is "
-            << memProperties.memoryTypeCount << std::endl;
-  for (std::uint32_t i{0}; i < memProperties.memoryTypeCount; ++i) {
-    if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags &
-                                    properties) == properties) {
-      std::cout << "Vertex Buffer: Find memory type: Memory type " << i
-                << " has been chosen" << std::endl;
-      return i;
-    }
-  }
-
-  throw std::runtime_error("failed to find suitable memory type!");
-}
-
 void Context::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
                            VkMemoryPropertyFlags properties, VkBuffer &buffer,
-                           VkDeviceMemory &bufferMemory) {
+                           Allocation &allocation) {
   // Buffer creation:
   VkBufferCreateInfo bufferInfo{};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -891,147 +1869,167 @@ void Context::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
   VkMemoryRequirements memRequirements;
   vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-  // Memory allocation:
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex =
-      FindMemoryType(memRequirements.memoryTypeBits, properties);
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) !=
-      VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate buffer memory!");
-  }
-  vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+  // Memory sub-allocation:
+  allocation = allocator_.Allocate(memRequirements, properties);
+  vkBindBufferMemory(device_, buffer, allocation.memory, allocation.offset);
 }
 
-void Context::CopyBuffer(VkCommandPool commandPool, VkBuffer srcBuffer,
-                         VkBuffer dstBuffer, VkDeviceSize size) {
-  VkCommandBufferAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandPool = commandPool;
-  allocInfo.commandBufferCount = 1;
-  VkCommandBuffer commandBuffer;
-  vkAllocateCommandBuffers(device_, &allocInfo, &commandBuffer);
-
-  VkCommandBufferBeginInfo beginInfo{};
-  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-  vkBeginCommandBuffer(commandBuffer, &beginInfo);
-  VkBufferCopy copyRegion{};
-  copyRegion.srcOffset = 0; // Optional
-  copyRegion.dstOffset = 0; // Optional
-  copyRegion.size = size;
-  vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-  vkEndCommandBuffer(commandBuffer);
-
-  VkSubmitInfo submitInfo{};
-  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &commandBuffer;
-  vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-  vkQueueWaitIdle(graphicsQueue_);
-
-  vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
+BufferHandle Context::CreateDeviceBuffer(VkDeviceSize size,
+                                         VkBufferUsageFlags usage) {
+  VkBuffer buffer{VK_NULL_HANDLE};
+  Allocation allocation{};
+  CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, allocation);
+  return buffers_.Allocate(buffer, size, allocation.mappedData, allocation);
 }
 
-VkBuffer Context::CreateVertexBuffer(const VertexBufferOptions &options) {
-  VkDeviceSize bufferSize =
-      sizeof(options.vertices[0]) * options.vertices.size();
-  VkBuffer stagingBuffer{VK_NULL_HANDLE};
-  VkDeviceMemory stagingBufferMemory{VK_NULL_HANDLE};
-  CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-               stagingBuffer, stagingBufferMemory);
+BufferHandle Context::CreateVertexBuffer(const VertexBufferOptions &options) {
+  const auto vertices = options.packedVertices.empty()
+                            ? AsBytes(options.vertices)
+                            : AsBytes(options.packedVertices);
+  const auto vertexBuffer =
+      CreateDeviceBuffer(vertices.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
   // Filling the vertex buffer:
-  void *data;
-  vkMapMemory(device_, stagingBufferMemory, 0, bufferSize, 0, &data);
-  std::memcpy(data, options.vertices.data(), static_cast<size_t>(bufferSize));
-  vkUnmapMemory(device_, stagingBufferMemory);
-
-  VkBuffer vertexBuffer{VK_NULL_HANDLE};
-  VkDeviceMemory vertexBufferMemory{VK_NULL_HANDLE};
-  CreateBuffer(
-      bufferSize,
-      VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
-  CopyBuffer(options.commandPool, stagingBuffer, vertexBuffer, bufferSize);
-
-  vkDestroyBuffer(device_, stagingBuffer, nullptr);
-  vkFreeMemory(device_, stagingBufferMemory, nullptr);
-
-  vertexBuffers_.push_back(vertexBuffer);
-  vertexBufferMemories_.push_back(vertexBufferMemory);
+  stagingRing_.Upload(GetBuffer(vertexBuffer), 0, vertices.data(),
+                      vertices.size());
   return vertexBuffer;
 }
 
-VkBuffer Context::CreateIndexBuffer(const IndexBufferOptions &options) {
-  VkDeviceSize bufferSize = sizeof(options.indices[0]) * options.indices.size();
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-               stagingBuffer, stagingBufferMemory);
+BufferHandle Context::CreateIndexBuffer(const IndexBufferOptions &options) {
+  const auto indices = options.indices32.empty()
+                           ? AsBytes(options.indices)
+                           : AsBytes(options.indices32);
+  const auto indexBuffer =
+      CreateDeviceBuffer(indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+  stagingRing_.Upload(GetBuffer(indexBuffer), 0, indices.data(),
+                      indices.size());
+  return indexBuffer;
+}
 
-  void *data;
-  vkMapMemory(device_, stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, options.indices.data(), (size_t)bufferSize);
-  vkUnmapMemory(device_, stagingBufferMemory);
+BufferHandle
+Context::CreateInstanceBuffer(const InstanceBufferOptions &options) {
+  const auto instanceBuffer = CreateDeviceBuffer(
+      options.instances.size_bytes(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+  stagingRing_.Upload(GetBuffer(instanceBuffer), 0, options.instances.data(),
+                      options.instances.size_bytes());
+  return instanceBuffer;
+}
 
-  VkBuffer indexBuffer{VK_NULL_HANDLE};
-  VkDeviceMemory indexBufferMemory{VK_NULL_HANDLE};
-  CreateBuffer(
-      bufferSize,
-      VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
-  CopyBuffer(options.commandPool, stagingBuffer, indexBuffer, bufferSize);
-
-  vkDestroyBuffer(device_, stagingBuffer, nullptr);
-  vkFreeMemory(device_, stagingBufferMemory, nullptr);
-
-  indexBuffers_.push_back(indexBuffer);
-  indexBufferMemories_.push_back(indexBufferMemory);
-  return indexBuffer;
+BufferHandle
+Context::CreateIndirectBuffer(const IndirectBufferOptions &options) {
+  const auto indirectBuffer =
+      CreateDeviceBuffer(options.commands.size_bytes(),
+                         VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  stagingRing_.Upload(GetBuffer(indirectBuffer), 0, options.commands.data(),
+                      options.commands.size_bytes());
+  return indirectBuffer;
+}
+
+BufferHandle Context::CreateStorageBuffer(const StorageBufferOptions &options) {
+  const auto storageBuffer = CreateDeviceBuffer(
+      std::max<VkDeviceSize>(options.size, options.data.size()),
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | options.usage);
+  if (!options.data.empty()) {
+    stagingRing_.Upload(GetBuffer(storageBuffer), 0, options.data.data(),
+                        options.data.size());
+  }
+  return storageBuffer;
 }
 
-VkBuffer Context::CreateUniformBuffer() {
+MeshBuffer Context::CreateMeshBuffer(const MeshBufferOptions &options) {
+  MeshBuffer meshBuffer{};
+  if (!options.meshes.empty()) {
+    meshBuffer.vertexFormat = options.meshes.front().GetVertexFormat();
+    meshBuffer.indexType = options.meshes.front().GetIndexType();
+  }
+  VkDeviceSize vertexCount{0};
+  VkDeviceSize indexCount{0};
+  for (const auto &mesh : options.meshes) {
+    if (mesh.GetVertexFormat() != meshBuffer.vertexFormat ||
+        mesh.GetIndexType() != meshBuffer.indexType) {
+      throw std::runtime_error("failed to create mesh buffer of meshes with "
+                               "different vertex formats or index types!");
+    }
+    MeshRange range{};
+    range.firstIndex = static_cast<std::uint32_t>(indexCount);
+    range.indexCount = static_cast<std::uint32_t>(mesh.GetIndexCount());
+    range.vertexOffset = static_cast<std::int32_t>(vertexCount);
+    meshBuffer.meshes.push_back(range);
+    vertexCount += mesh.GetVertexCount();
+    indexCount += mesh.GetIndexCount();
+  }
+  const auto vertexSize = GetVertexSize(meshBuffer.vertexFormat);
+  const auto indexSize = GetIndexSize(meshBuffer.indexType);
+  meshBuffer.vertexBufferHandle = CreateDeviceBuffer(
+      vertexCount * vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+  meshBuffer.indexBufferHandle = CreateDeviceBuffer(
+      indexCount * indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+  meshBuffer.vertexBuffer = GetBuffer(meshBuffer.vertexBufferHandle);
+  meshBuffer.indexBuffer = GetBuffer(meshBuffer.indexBufferHandle);
+
+  // Every mesh is uploaded from where it lives into its range, nothing is
+  // gathered into an intermediate array:
+  for (std::size_t i{0}; i < options.meshes.size(); ++i) {
+    const auto &mesh = options.meshes[i];
+    const auto &range = meshBuffer.meshes[i];
+    const auto vertexOffset =
+        static_cast<VkDeviceSize>(range.vertexOffset) * vertexSize;
+    const auto indexOffset =
+        static_cast<VkDeviceSize>(range.firstIndex) * indexSize;
+    const auto vertices = meshBuffer.vertexFormat == VertexFormat::Packed
+                              ? AsBytes(mesh.packedVertices)
+                              : AsBytes(mesh.vertices);
+    const auto indices = meshBuffer.indexType == VK_INDEX_TYPE_UINT32
+                             ? AsBytes(mesh.indices32)
+                             : AsBytes(mesh.indices);
+    stagingRing_.Upload(meshBuffer.vertexBuffer, vertexOffset,
+                        vertices.data(), vertices.size());
+    stagingRing_.Upload(meshBuffer.indexBuffer, indexOffset, indices.data(),
+                        indices.size());
+  }
+  return meshBuffer;
+}
+
+BufferHandle Context::CreateUniformBuffer() {
   VkDeviceSize bufferSize = sizeof(UniformBufferObject);
   VkBuffer uniformBuffer{VK_NULL_HANDLE};
-  VkDeviceMemory uniformBufferMemory{VK_NULL_HANDLE};
+  Allocation uniformBufferAllocation{};
+  // Host visible memory is persistently mapped by the allocator:
   CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-               uniformBuffer, uniformBufferMemory);
+               uniformBuffer, uniformBufferAllocation);
 
-  void *mapped_memory{nullptr};
-  vkMapMemory(device_, uniformBufferMemory, 0, bufferSize, 0, &mapped_memory);
-
-  uniformBuffers_.push_back(uniformBuffer);
-  uniformBufferMemories_.push_back(uniformBufferMemory);
-  uniformBufferMappedMemories_.push_back(mapped_memory);
-  return uniformBuffer;
+  return buffers_.Allocate(uniformBuffer, bufferSize,
+                           uniformBufferAllocation.mappedData,
+                           uniformBufferAllocation);
 }
 
-VkDescriptorPool
+DescriptorPoolHandle
 Context::CreateDescriptorPool(const DescriptorPoolOptions &options) {
   VkDescriptorPoolSize poolSize{};
   poolSize.type = options.type;
   poolSize.descriptorCount = options.descriptorCount;
   VkDescriptorPoolCreateInfo poolInfo{};
   poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-  poolInfo.poolSizeCount = 1;
-  poolInfo.pPoolSizes = &poolSize;
-  poolInfo.maxSets = options.descriptorCount;
+  if (options.poolSizes.empty()) {
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+  } else {
+    poolInfo.poolSizeCount =
+        static_cast<std::uint32_t>(options.poolSizes.size());
+    poolInfo.pPoolSizes = options.poolSizes.data();
+  }
+  poolInfo.maxSets =
+      options.maxSets > 0 ? options.maxSets : options.descriptorCount;
   VkDescriptorPool descriptorPool{VK_NULL_HANDLE};
   if (vkCreateDescriptorPool(device_, &poolInfo, nullptr, &descriptorPool) !=
       VK_SUCCESS) {
     throw std::runtime_error("failed to create descriptor pool!");
   }
 
-  descriptorPools_.push_back(descriptorPool);
-  return descriptorPool;
+  return descriptorPools_.Allocate(descriptorPool);
 }
 
 VkDescriptorSet
@@ -1051,15 +2049,26 @@ Context::CreateDescriptorSet(const DescriptorSetOptions &options) {
   return descriptorSet;
 }
 
+std::vector<VkDescriptorSet>
+Context::CreateFrameDescriptorSets(const DescriptorSetOptions &options) {
+  std::vector<VkDescriptorSet> descriptorSets{};
+  for (auto &frame : frames_) {
+    const auto descriptorSet = CreateDescriptorSet(options);
+    frame.SetDescriptorSet(descriptorSet);
+    descriptorSets.push_back(descriptorSet);
+  }
+  return descriptorSets;
+}
+
 void Context::UpdateDescriptorSet(const UpdateDescriptorSetOptions &options) {
   VkDescriptorBufferInfo bufferInfo{};
   bufferInfo.buffer = options.uniformBuffer;
-  bufferInfo.offset = 0;
-  bufferInfo.range = sizeof(UniformBufferObject);
+  bufferInfo.offset = options.offset;
+  bufferInfo.range = options.range;
   VkWriteDescriptorSet descriptorWrite{};
   descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
   descriptorWrite.dstSet = options.descriptorSet;
-  descriptorWrite.dstBinding = 0;
+  descriptorWrite.dstBinding = options.binding;
   descriptorWrite.dstArrayElement = 0;
   descriptorWrite.descriptorType = options.descriptorType;
   descriptorWrite.descriptorCount = 1;
@@ -1070,17 +2079,23 @@ void Context::UpdateDescriptorSet(const UpdateDescriptorSetOptions &options) {
 }
 
 void Context::RecordCommandBuffer(const RecordCommandBufferOptions &options) {
-  // Reset the command buffer first.
-  vkResetCommandBuffer(options.commandBuffer, 0);
-
-  // Start recording the command buffer.
+  const auto recordStart = Clock::now();
+  // Start recording the command buffer. Frame command buffers are already
+  // reset with their pool, command buffers from pools created with
+  // RESET_COMMAND_BUFFER_BIT are reset implicitly by vkBeginCommandBuffer.
   VkCommandBufferBeginInfo beginInfo{};
   beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-  beginInfo.flags = 0;                  // Optional
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
   beginInfo.pInheritanceInfo = nullptr; // Optional
   if (vkBeginCommandBuffer(options.commandBuffer, &beginInfo) != VK_SUCCESS) {
     throw std::runtime_error("failed to begin recording command buffer!");
   }
+  gpuProfiler_.RecordReset(options.commandBuffer);
+  if (options.computeDispatchCount > 0) {
+    gpuProfiler_.BeginScope(options.commandBuffer, "Compute");
+    RecordComputeDispatches(options);
+    gpuProfiler_.EndScope(options.commandBuffer);
+  }
 
   // Starting a render pass:
   VkRenderPassBeginInfo renderPassInfo{};
@@ -1090,13 +2105,85 @@ void Context::RecordCommandBuffer(const RecordCommandBufferOptions &options) {
       swapChainFramebuffers_[currentSwapchainImageIndex_];
   renderPassInfo.renderArea.offset = {0, 0};
   renderPassInfo.renderArea.extent = swapChainExtent_;
-  renderPassInfo.clearValueCount = 1;
-  renderPassInfo.pClearValues = &options.clearColor;
+  // The depth clear value is ignored by render passes without depth:
+  VkClearValue clearValues[2]{};
+  clearValues[0] = options.clearColor;
+  clearValues[1].depthStencil = {1.0f, 0};
+  renderPassInfo.clearValueCount = 2;
+  renderPassInfo.pClearValues = clearValues;
+  const bool parallel = options.pipeline != VK_NULL_HANDLE &&
+                        options.drawItemCount > 0 && recordingThreadCount_ > 0;
+  // Queries can't be recorded inside a subpass with secondary command buffer
+  // contents and they can't stay active across the secondary command buffers
+  // without the inheritedQueries feature, the draws get no scope of their own
+  // and no statistics then:
+  gpuProfiler_.BeginScope(options.commandBuffer, "RenderPass", !parallel);
   vkCmdBeginRenderPass(options.commandBuffer, &renderPassInfo,
-                       VK_SUBPASS_CONTENTS_INLINE);
+                       parallel ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                                : VK_SUBPASS_CONTENTS_INLINE);
+
+  if (options.pipeline == VK_NULL_HANDLE) {
+    // Nothing to draw yet, e.g. the pipeline is still compiling.
+  } else if (parallel) {
+    const auto secondaryCount = RecordSecondaryCommandBuffers(options);
+    vkCmdExecuteCommands(
+        options.commandBuffer, secondaryCount,
+        frames_[currentFrame_].GetSecondaryCommandBuffers().data());
+  } else if (options.drawItemCount > 0) {
+    gpuProfiler_.BeginScope(options.commandBuffer, "Draws");
+    RecordDrawItems(options.commandBuffer, options, options.drawItems,
+                    options.drawItemCount);
+    gpuProfiler_.EndScope(options.commandBuffer);
+  } else {
+    gpuProfiler_.BeginScope(options.commandBuffer, "Draws");
+    RecordBufferDraws(options);
+    gpuProfiler_.EndScope(options.commandBuffer);
+  }
+
+  vkCmdEndRenderPass(options.commandBuffer);
+  gpuProfiler_.EndScope(options.commandBuffer);
+  if (offscreen_ && !readbackBuffers_.empty()) {
+    RecordReadback(options.commandBuffer);
+  }
+  if (vkEndCommandBuffer(options.commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record command buffer!");
+  }
+  AddFrameTime(FramePhase::Record, recordStart);
+}
+
+void Context::RecordDraws(const RecordCommandBufferOptions &options) {
+  if (options.pipeline == VK_NULL_HANDLE) {
+    return;
+  }
+  if (options.drawItemCount > 0) {
+    RecordDrawItems(options.commandBuffer, options, options.drawItems,
+                    options.drawItemCount);
+  } else {
+    RecordBufferDraws(options);
+  }
+}
+
+void Context::RecordRenderGraph(VkCommandBuffer commandBuffer) {
+  const auto recordStart = Clock::now();
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("failed to begin recording command buffer!");
+  }
+  gpuProfiler_.RecordReset(commandBuffer);
+  gpuProfiler_.BeginScope(commandBuffer, "RenderGraph");
+  renderGraph_.Execute(commandBuffer);
+  gpuProfiler_.EndScope(commandBuffer);
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record command buffer!");
+  }
+  AddFrameTime(FramePhase::Record, recordStart);
+}
 
-  // Basic drawing commands:
-  vkCmdBindPipeline(options.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+void Context::RecordPipelineState(VkCommandBuffer commandBuffer,
+                                  const RecordCommandBufferOptions &options) {
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
                     options.pipeline);
   VkViewport viewport{};
   viewport.x = 0.0f;
@@ -1105,120 +2192,505 @@ void Context::RecordCommandBuffer(const RecordCommandBufferOptions &options) {
   viewport.height = static_cast<float>(swapChainExtent_.height);
   viewport.minDepth = 0.0f;
   viewport.maxDepth = 1.0f;
-  vkCmdSetViewport(options.commandBuffer, 0, 1, &viewport);
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
   VkRect2D scissor{};
   scissor.offset = {0, 0};
   scissor.extent = swapChainExtent_;
-  vkCmdSetScissor(options.commandBuffer, 0, 1, &scissor);
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          options.pipelineLayout, 0, 1, &options.descriptorSet,
+                          options.dynamicUniforms ? 1 : 0,
+                          &options.dynamicOffset);
+  // Set 0 is rebound by the draw items, the bindless set stays bound:
+  if (options.bindless) {
+    const auto bindlessSet = bindlessTable_.GetDescriptorSet();
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            options.pipelineLayout, kBindlessSet, 1,
+                            &bindlessSet, 0, nullptr);
+  }
+  if (options.pushConstantsSize > 0) {
+    vkCmdPushConstants(commandBuffer, options.pipelineLayout,
+                       options.pushConstantStages, 0,
+                       options.pushConstantsSize, options.pushConstants);
+  }
+}
+
+void Context::RecordBufferDraws(const RecordCommandBufferOptions &options) {
+  RecordPipelineState(options.commandBuffer, options);
 
   // Binding the vertex buffer:
-  vkCmdBindPipeline(options.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                    options.pipeline);
   VkBuffer vertexBuffers[] = {options.vertexBuffer};
   VkDeviceSize offsets[] = {0};
   vkCmdBindVertexBuffers(options.commandBuffer, 0, 1, vertexBuffers, offsets);
+  if (options.instanceBuffer != VK_NULL_HANDLE) {
+    vkCmdBindVertexBuffers(options.commandBuffer, 1, 1, &options.instanceBuffer,
+                           &options.instanceBufferOffset);
+  }
   vkCmdBindIndexBuffer(options.commandBuffer, options.indexBuffer, 0,
-                       VK_INDEX_TYPE_UINT16);
-  vkCmdBindDescriptorSets(
-      options.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-      options.pipelineLayout, 0, 1, &options.descriptorSet, 0, nullptr);
-  vkCmdDrawIndexed(options.commandBuffer, options.indexCount, 1, 0, 0, 0);
+                       options.indexType);
+  if (options.indirectBuffer == VK_NULL_HANDLE) {
+    vkCmdDrawIndexed(options.commandBuffer, options.indexCount,
+                     options.instanceCount, 0, 0, 0);
+  } else {
+    RecordIndirectDraws(options);
+  }
+}
 
-  vkCmdEndRenderPass(options.commandBuffer);
-  if (vkEndCommandBuffer(options.commandBuffer) != VK_SUCCESS) {
-    throw std::runtime_error("failed to record command buffer!");
+void Context::RecordIndirectDraws(const RecordCommandBufferOptions &options) {
+  // All the draws are issued by a single call where the device allows it:
+  constexpr auto kStride =
+      static_cast<std::uint32_t>(sizeof(VkDrawIndexedIndirectCommand));
+  if (options.countBuffer != VK_NULL_HANDLE && drawIndirectSupport_.drawCount) {
+    cmdDrawIndexedIndirectCount_(options.commandBuffer, options.indirectBuffer,
+                                 options.indirectOffset, options.countBuffer,
+                                 options.countOffset, options.drawCount,
+                                 kStride);
+  } else if (drawIndirectSupport_.multiDraw) {
+    vkCmdDrawIndexedIndirect(options.commandBuffer, options.indirectBuffer,
+                             options.indirectOffset, options.drawCount,
+                             kStride);
+  } else {
+    for (std::uint32_t i{0}; i < options.drawCount; ++i) {
+      vkCmdDrawIndexedIndirect(options.commandBuffer, options.indirectBuffer,
+                               options.indirectOffset + i * kStride, 1,
+                               kStride);
+    }
   }
 }
 
+void Context::RecordComputeDispatches(
+    const RecordCommandBufferOptions &options) {
+  const auto commandBuffer = options.commandBuffer;
+  const auto barrier = [commandBuffer](VkPipelineStageFlags srcStages,
+                                       VkAccessFlags srcAccess,
+                                       VkPipelineStageFlags dstStages,
+                                       VkAccessFlags dstAccess) {
+    VkMemoryBarrier memoryBarrier{};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.srcAccessMask = srcAccess;
+    memoryBarrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 1,
+                         &memoryBarrier, 0, nullptr, 0, nullptr);
+  };
+
+  // The draws of the previous frames may still read the buffers the
+  // dispatches write, an execution dependency orders the writes after them:
+  constexpr VkPipelineStageFlags kDrawStages{
+      VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+      VK_PIPELINE_STAGE_VERTEX_SHADER_BIT};
+  barrier(kDrawStages, 0,
+          VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+          0);
+  bool reset{false};
+  for (std::uint32_t i{0}; i < options.computeDispatchCount; ++i) {
+    const auto &dispatch = options.computeDispatches[i];
+    if (dispatch.resetBuffer != VK_NULL_HANDLE && dispatch.resetSize > 0) {
+      VkBufferCopy copyRegion{};
+      copyRegion.size = dispatch.resetSize;
+      vkCmdCopyBuffer(commandBuffer, dispatch.resetSource, dispatch.resetBuffer,
+                      1, &copyRegion);
+      reset = true;
+    }
+  }
+  if (reset) {
+    barrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+  }
+
+  // Dispatches in the same command buffer may overlap, they must not depend
+  // on each other:
+  for (std::uint32_t i{0}; i < options.computeDispatchCount; ++i) {
+    const auto &dispatch = options.computeDispatches[i];
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      dispatch.pipeline);
+    if (dispatch.descriptorSet != VK_NULL_HANDLE) {
+      vkCmdBindDescriptorSets(
+          commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+          dispatch.pipelineLayout, 0, 1, &dispatch.descriptorSet,
+          dispatch.dynamicUniforms ? 1 : 0, &dispatch.dynamicOffset);
+    }
+    if (dispatch.pushConstantsSize > 0) {
+      vkCmdPushConstants(commandBuffer, dispatch.pipelineLayout,
+                         VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                         dispatch.pushConstantsSize, dispatch.pushConstants);
+    }
+    vkCmdDispatch(commandBuffer, dispatch.groupCountX, dispatch.groupCountY,
+                  dispatch.groupCountZ);
+  }
+
+  barrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+          kDrawStages,
+          VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
+              VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+}
+
+void Context::RecordDrawItems(VkCommandBuffer commandBuffer,
+                              const RecordCommandBufferOptions &options,
+                              const DrawItem *drawItems,
+                              std::uint32_t drawItemCount) {
+  RecordPipelineState(commandBuffer, options);
+
+  // Buffers are rebound only when they change between the draw items:
+  const VkDeviceSize offset{0};
+  VkBuffer vertexBuffer{VK_NULL_HANDLE};
+  VkBuffer indexBuffer{VK_NULL_HANDLE};
+  VkIndexType indexType{VK_INDEX_TYPE_UINT16};
+  VkBuffer instanceBuffer{VK_NULL_HANDLE};
+  VkDeviceSize instanceBufferOffset{};
+  auto pipeline = options.pipeline;
+  auto dynamicOffset = options.dynamicOffset;
+  for (std::uint32_t i{0}; i < drawItemCount; ++i) {
+    const auto &item = drawItems[i];
+    // Descriptor sets and dynamic state stay bound, the layout is shared:
+    if (item.pipeline != VK_NULL_HANDLE && item.pipeline != pipeline) {
+      pipeline = item.pipeline;
+      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                        pipeline);
+    }
+    if (options.dynamicUniforms && item.dynamicOffset != dynamicOffset) {
+      dynamicOffset = item.dynamicOffset;
+      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                              options.pipelineLayout, 0, 1,
+                              &options.descriptorSet, 1, &dynamicOffset);
+    }
+    // Push constants are part of the command buffer, there is neither a
+    // memory write nor a descriptor update per draw:
+    if (item.pushConstantsSize > 0) {
+      vkCmdPushConstants(commandBuffer, options.pipelineLayout,
+                         options.pushConstantStages, 0, item.pushConstantsSize,
+                         item.pushConstants);
+    }
+    if (item.vertexBuffer != vertexBuffer) {
+      vertexBuffer = item.vertexBuffer;
+      vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+    }
+    if ((item.instanceBuffer != instanceBuffer ||
+         item.instanceBufferOffset != instanceBufferOffset) &&
+        item.instanceBuffer != VK_NULL_HANDLE) {
+      instanceBuffer = item.instanceBuffer;
+      instanceBufferOffset = item.instanceBufferOffset;
+      vkCmdBindVertexBuffers(commandBuffer, 1, 1, &instanceBuffer,
+                             &instanceBufferOffset);
+    }
+    if (item.indexBuffer != indexBuffer || item.indexType != indexType) {
+      indexBuffer = item.indexBuffer;
+      indexType = item.indexType;
+      vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, indexType);
+    }
+    vkCmdDrawIndexed(commandBuffer, item.indexCount, item.instanceCount,
+                     item.firstIndex, item.vertexOffset, item.firstInstance);
+  }
+}
+
+std::uint32_t Context::RecordSecondaryCommandBuffers(
+    const RecordCommandBufferOptions &options) {
+  // Slices are not made smaller than kMinDrawItemsPerThread:
+  const auto sliceCount = std::min(
+      recordingThreadCount_,
+      (options.drawItemCount + kMinDrawItemsPerThread - 1) /
+          kMinDrawItemsPerThread);
+  const auto sliceSize = (options.drawItemCount + sliceCount - 1) / sliceCount;
+
+  // The secondary command buffers are reset with the frame in BeginFrame:
+  const auto &commandBuffers =
+      frames_[currentFrame_].GetSecondaryCommandBuffers();
+  std::vector<std::future<void>> futures{};
+  for (std::uint32_t slice{0}; slice < sliceCount; ++slice) {
+    const auto commandBuffer = commandBuffers[slice];
+    const auto first = slice * sliceSize;
+    const auto count = std::min(sliceSize, options.drawItemCount - first);
+    futures.push_back(recordingThreads_.Submit([this, &options, commandBuffer,
+                                                first, count] {
+      VkCommandBufferInheritanceInfo inheritanceInfo{};
+      inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+      inheritanceInfo.renderPass = options.renderPass;
+      inheritanceInfo.subpass = 0;
+      inheritanceInfo.framebuffer =
+          swapChainFramebuffers_[currentSwapchainImageIndex_];
+      VkCommandBufferBeginInfo beginInfo{};
+      beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+      beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT |
+                        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+      beginInfo.pInheritanceInfo = &inheritanceInfo;
+      if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin secondary command buffer!");
+      }
+      RecordDrawItems(commandBuffer, options, options.drawItems + first,
+                      count);
+      if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record secondary command buffer!");
+      }
+    }));
+  }
+
+  // All the slices have to finish before an exception leaves the options:
+  for (const auto &future : futures) {
+    future.wait();
+  }
+  for (auto &future : futures) {
+    future.get();
+  }
+  return sliceCount;
+}
+
 void Context::UpdateUniformBuffer(const UpdateUniformBufferOptions &options) {
-  memcpy(uniformBufferMappedMemories_[options.uniformBufferIndex],
-         &options.data, sizeof(options.data));
+  const auto mappedData =
+      buffers_.Get<kBufferMappedField>(options.uniformBuffer);
+  if (mappedData == nullptr || *mappedData == nullptr) {
+    throw std::runtime_error("failed to update stale uniform buffer!");
+  }
+  memcpy(*mappedData, &options.data, sizeof(options.data));
 }
 
 BeginFrameInfo Context::BeginFrame(const BeginFrameOptions &options) {
-  // Waiting for the previous frame:
-  vkWaitForFences(device_, 1, &inFlightFences_[currentFrame_], VK_TRUE,
-                  UINT64_MAX);
+  // The previous frame ends here, its GPU time comes from the profiler:
+  const auto frameStart = Clock::now();
+  if (frameStart_.has_value()) {
+    frameTiming_.frameMilliseconds =
+        std::chrono::duration<float, std::milli>(frameStart - *frameStart_)
+            .count();
+    for (const auto &scope : gpuProfiler_.GetResults()) {
+      if (scope.depth == 0) {
+        frameTiming_.gpuMilliseconds += static_cast<float>(scope.milliseconds);
+      }
+    }
+    frameStats_.Push(frameTiming_);
+  }
+  frameStart_ = frameStart;
+  frameTiming_ = FrameTiming{};
 
-  // Acquiring an image from the swap chain:
-  VkResult result = vkAcquireNextImageKHR(
-      device_, swapChain_, UINT64_MAX, imageAvailableSemaphores_[currentFrame_],
-      VK_NULL_HANDLE, &currentSwapchainImageIndex_);
-  if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-    RecreateSwapChain(options.renderPass);
-    return BeginFrameInfo{true};
-  } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-    throw std::runtime_error("failed to acquire swap chain image!");
+  // Waiting for the previous frame of the slot, the frame timeline waits
+  // for exactly its value:
+  if (frameTimeline_.IsInitialized()) {
+    frameTimeline_.Wait(frameTimelineValues_[currentFrame_]);
+  } else {
+    vkWaitForFences(device_, 1, &inFlightFences_[currentFrame_], VK_TRUE,
+                    UINT64_MAX);
+    if (frameNumber_ >= framesInFlight_) {
+      completedFrameValue_ = std::max(completedFrameValue_,
+                                      frameNumber_ - framesInFlight_ + 1);
+    }
+  }
+  AddFrameTime(FramePhase::FenceWait, frameStart);
+  // The timeline may be ahead of the waited value, which frees the resources
+  // of all the frames completed so far:
+  const auto completedFrameValue = GetCompletedFrameValue();
+  if (completedFrameValue > 0) {
+    deletionQueue_.Flush(completedFrameValue - 1);
+  }
+  stagingRing_.Retire();
+  stagingRing_.RecycleAcquire(frameUploadAcquires_[currentFrame_]);
+  ReloadPipelines();
+  auto &frame = frames_[currentFrame_];
+  frame.Reset();
+  uniformRing_.BeginFrame(currentFrame_);
+  gpuProfiler_.BeginFrame(currentFrame_);
+
+  if (offscreen_) {
+    // Every frame slot has its own offscreen image and readback buffer, both
+    // are free once the frame fence is signaled:
+    currentSwapchainImageIndex_ = currentFrame_;
+    latestReadback_.reset();
+    if (readbackPending_[currentFrame_]) {
+      latestReadback_ = currentFrame_;
+      readbackPending_[currentFrame_] = false;
+    }
+  } else {
+    if (swapChainOutOfDate_ && !RecreateSwapChain(options.renderPass)) {
+      return BeginFrameInfo{true, VK_NULL_HANDLE, true};
+    }
+    // Acquiring an image from the swap chain:
+    const auto acquireStart = Clock::now();
+    VkResult result = vkAcquireNextImageKHR(
+        device_, swapChain_, UINT64_MAX,
+        imageAvailableSemaphores_[currentFrame_], VK_NULL_HANDLE,
+        &currentSwapchainImageIndex_);
+    AddFrameTime(FramePhase::Acquire, acquireStart);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+      const bool recreated = RecreateSwapChain(options.renderPass);
+      return BeginFrameInfo{true, VK_NULL_HANDLE, !recreated};
+    } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+      throw std::runtime_error("failed to acquire swap chain image!");
+    }
   }
 
   // Only reset the fence if we are submitting work.
-  vkResetFences(device_, 1, &inFlightFences_[currentFrame_]);
-  return BeginFrameInfo{false};
+  if (!frameTimeline_.IsInitialized()) {
+    vkResetFences(device_, 1, &inFlightFences_[currentFrame_]);
+  }
+  return BeginFrameInfo{false, frame.AcquireCommandBuffer(), false, &frame};
 }
 
 EndFrameInfo Context::EndFrame(const EndFrameOptions &options) {
+  const auto submitStart = Clock::now();
+  // Uploads are submitted first, so the frame sees their results:
+  stagingRing_.Flush();
+
+  // With a dedicated transfer queue the frame waits on the upload batches and
+  // acquires the ownership of the uploaded buffers before the draws:
+  auto &acquire = frameUploadAcquires_[currentFrame_];
+  acquire = stagingRing_.TakeAcquire();
+  std::vector<VkSemaphore> waitSemaphores{};
+  std::vector<VkPipelineStageFlags> waitStages{};
+  if (!offscreen_) {
+    waitSemaphores.push_back(imageAvailableSemaphores_[currentFrame_]);
+    waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+  }
+  for (const auto &semaphore : acquire.semaphores) {
+    waitSemaphores.push_back(semaphore);
+    waitStages.push_back(kUploadConsumerStages);
+  }
+  // Values are ignored for binary semaphores:
+  std::vector<std::uint64_t> waitValues(waitSemaphores.size(), 0);
+  if (acquire.timelineValue > 0) {
+    waitSemaphores.push_back(acquire.timelineSemaphore);
+    waitStages.push_back(kUploadConsumerStages);
+    waitValues.push_back(acquire.timelineValue);
+  }
+  std::vector<VkCommandBuffer> commandBuffers{};
+  if (acquire.commandBuffer != VK_NULL_HANDLE) {
+    commandBuffers.push_back(acquire.commandBuffer);
+  }
+  commandBuffers.push_back(options.commandBuffer);
+
   // Submitting the command buffer:
   VkSubmitInfo submitInfo{};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  VkSemaphore waitSemaphores[] = {imageAvailableSemaphores_[currentFrame_]};
-  VkPipelineStageFlags waitStages[] = {
-      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-  submitInfo.waitSemaphoreCount = 1;
-  submitInfo.pWaitSemaphores = waitSemaphores;
-  submitInfo.pWaitDstStageMask = waitStages;
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &options.commandBuffer;
-  VkSemaphore signalSemaphores[] = {renderFinishedSemaphores_[currentFrame_]};
-  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.waitSemaphoreCount =
+      static_cast<std::uint32_t>(waitSemaphores.size());
+  submitInfo.pWaitSemaphores = waitSemaphores.data();
+  submitInfo.pWaitDstStageMask = waitStages.data();
+  submitInfo.commandBufferCount =
+      static_cast<std::uint32_t>(commandBuffers.size());
+  submitInfo.pCommandBuffers = commandBuffers.data();
+  VkSemaphore signalSemaphores[] = {
+      offscreen_ ? VK_NULL_HANDLE
+                 : renderFinishedSemaphores_[currentSwapchainImageIndex_]};
+  submitInfo.signalSemaphoreCount = offscreen_ ? 0 : 1;
   submitInfo.pSignalSemaphores = signalSemaphores;
-  if (vkQueueSubmit(graphicsQueue_, 1, &submitInfo,
-                    inFlightFences_[currentFrame_]) != VK_SUCCESS) {
+  // The frame timeline replaces the fence:
+  VkFence fence{VK_NULL_HANDLE};
+  std::array<VkSemaphore, 2> timelineSignalSemaphores{signalSemaphores[0]};
+  std::array<std::uint64_t, 2> signalValues{};
+  VkTimelineSemaphoreSubmitInfoKHR timelineInfo{};
+  if (frameTimeline_.IsInitialized()) {
+    const auto frameValue = frameTimeline_.Advance();
+    frameTimelineValues_[currentFrame_] = frameValue;
+    const std::uint32_t signalIndex = offscreen_ ? 0 : 1;
+    timelineSignalSemaphores[signalIndex] = frameTimeline_.GetSemaphore();
+    signalValues[signalIndex] = frameValue;
+    submitInfo.signalSemaphoreCount = signalIndex + 1;
+    submitInfo.pSignalSemaphores = timelineSignalSemaphores.data();
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+    timelineInfo.waitSemaphoreValueCount =
+        static_cast<std::uint32_t>(waitValues.size());
+    timelineInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineInfo.signalSemaphoreValueCount = signalIndex + 1;
+    timelineInfo.pSignalSemaphoreValues = signalValues.data();
+    submitInfo.pNext = &timelineInfo;
+  } else {
+    fence = inFlightFences_[currentFrame_];
+  }
+  if (vkQueueSubmit(graphicsQueue_, 1, &submitInfo, fence) != VK_SUCCESS) {
     throw std::runtime_error("failed to submit draw command buffer!");
   }
+  AddFrameTime(FramePhase::Submit, submitStart);
 
   // Presentation.
   // Submitting the result back to the swap chain to have it eventually show
-  // up on the screen.
-  VkPresentInfoKHR presentInfo{};
-  presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-  presentInfo.waitSemaphoreCount = 1;
-  presentInfo.pWaitSemaphores = signalSemaphores;
-  presentInfo.swapchainCount = 1;
-  presentInfo.pSwapchains = &swapChain_;
-  presentInfo.pImageIndices = &currentSwapchainImageIndex_;
-  presentInfo.pResults = nullptr; // Optional
-  VkResult result = vkQueuePresentKHR(presentQueue_, &presentInfo);
-  if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
-      framebufferResized_) {
-    framebufferResized_ = false;
-    RecreateSwapChain(options.renderPass);
-  } else if (result != VK_SUCCESS) {
-    throw std::runtime_error("failed to present swap chain image!");
-  }
-
-  currentFrame_ = (currentFrame_ + 1) % kMaxFramesInFlight;
+  // up on the screen, there is nothing to present offscreen.
+  if (!offscreen_) {
+    VkPresentInfoKHR presentInfo{};
+    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    presentInfo.waitSemaphoreCount = 1;
+    presentInfo.pWaitSemaphores = signalSemaphores;
+    presentInfo.swapchainCount = 1;
+    presentInfo.pSwapchains = &swapChain_;
+    presentInfo.pImageIndices = &currentSwapchainImageIndex_;
+    presentInfo.pResults = nullptr; // Optional
+    const auto presentStart = Clock::now();
+    VkResult result = vkQueuePresentKHR(presentQueue_, &presentInfo);
+    AddFrameTime(FramePhase::Present, presentStart);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
+        framebufferResized_) {
+      framebufferResized_ = false;
+      RecreateSwapChain(options.renderPass);
+    } else if (result != VK_SUCCESS) {
+      throw std::runtime_error("failed to present swap chain image!");
+    }
+  }
+
+  currentFrame_ = (currentFrame_ + 1) % framesInFlight_;
+  ++frameNumber_;
   return {};
 }
 
 void Context::CreateSyncObjects() {
-  imageAvailableSemaphores_.resize(kMaxFramesInFlight);
-  renderFinishedSemaphores_.resize(kMaxFramesInFlight);
-  inFlightFences_.resize(kMaxFramesInFlight);
+  imageAvailableSemaphores_.resize(framesInFlight_);
+  frameUploadAcquires_.resize(framesInFlight_);
   VkSemaphoreCreateInfo semaphoreInfo{};
   semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  for (std::size_t i{0}; i < framesInFlight_; ++i) {
+    if (vkCreateSemaphore(device_, &semaphoreInfo, nullptr,
+                          &imageAvailableSemaphores_[i]) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create semaphores!");
+    }
+  }
+
+  // A single frame timeline, or a fence per frame slot:
+  completedFrameValue_ = 0;
+  if (timelineFunctions_.IsLoaded()) {
+    TimelineOptions timelineOptions{};
+    timelineOptions.device = device_;
+    timelineOptions.functions = timelineFunctions_;
+    frameTimeline_.Initialize(timelineOptions);
+    frameTimelineValues_.assign(framesInFlight_, 0);
+    return;
+  }
+  inFlightFences_.resize(framesInFlight_);
   VkFenceCreateInfo fenceInfo{};
   fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
   fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-  for (std::size_t i{0}; i < kMaxFramesInFlight; ++i) {
-    if (vkCreateSemaphore(device_, &semaphoreInfo, nullptr,
-                          &imageAvailableSemaphores_[i]) != VK_SUCCESS ||
-        vkCreateSemaphore(device_, &semaphoreInfo, nullptr,
-                          &renderFinishedSemaphores_[i]) != VK_SUCCESS ||
-        vkCreateFence(device_, &fenceInfo, nullptr, &inFlightFences_[i]) !=
-            VK_SUCCESS) {
-      throw std::runtime_error("failed to create semaphores!");
+  for (auto &fence : inFlightFences_) {
+    if (vkCreateFence(device_, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create fences!");
+    }
+  }
+}
+
+std::uint64_t Context::GetCompletedFrameValue() {
+  if (frameTimeline_.IsInitialized()) {
+    return frameTimeline_.GetCompletedValue();
+  }
+  // Frames complete in submission order, frame value - 1 was submitted with
+  // the fence of slot (value - 1) % framesInFlight_:
+  while (completedFrameValue_ < frameNumber_) {
+    const auto slot = completedFrameValue_ % framesInFlight_;
+    if (vkGetFenceStatus(device_, inFlightFences_[slot]) != VK_SUCCESS) {
+      break;
     }
+    ++completedFrameValue_;
   }
+  return completedFrameValue_;
+}
+
+void Context::WaitFrameValue(std::uint64_t value) {
+  if (value > frameNumber_) {
+    throw std::runtime_error("failed to wait for unsubmitted frame!");
+  }
+  if (frameTimeline_.IsInitialized()) {
+    frameTimeline_.Wait(value);
+    return;
+  }
+  if (value <= completedFrameValue_) {
+    return;
+  }
+  // The slot is reused only after its frame has completed, so the fence
+  // still belongs to the frame:
+  vkWaitForFences(device_, 1, &inFlightFences_[(value - 1) % framesInFlight_],
+                  VK_TRUE, UINT64_MAX);
+  completedFrameValue_ = value;
 }
 
 void Context::CleanupSwapChain() {
@@ -1232,25 +2704,185 @@ void Context::CleanupSwapChain() {
   }
   swapChainImageViews_.clear();
 
-  vkDestroySwapchainKHR(device_, swapChain_, nullptr);
-  swapChain_ = VK_NULL_HANDLE;
+  if (depthImage_ != VK_NULL_HANDLE) {
+    vkDestroyImageView(device_, depthImageView_, nullptr);
+    vkDestroyImage(device_, depthImage_, nullptr);
+    allocator_.Free(depthImageAllocation_);
+    depthImageView_ = VK_NULL_HANDLE;
+    depthImage_ = VK_NULL_HANDLE;
+    depthImageAllocation_ = {};
+  }
+
+  if (offscreen_) {
+    for (const auto &image : swapChainImages_) {
+      vkDestroyImage(device_, image, nullptr);
+    }
+    for (const auto &allocation : offscreenImageAllocations_) {
+      allocator_.Free(allocation);
+    }
+    offscreenImageAllocations_.clear();
+    for (const auto &buffer : readbackBuffers_) {
+      vkDestroyBuffer(device_, buffer, nullptr);
+    }
+    readbackBuffers_.clear();
+    for (const auto &allocation : readbackAllocations_) {
+      allocator_.Free(allocation);
+    }
+    readbackAllocations_.clear();
+    latestReadback_.reset();
+  } else {
+    vkDestroySwapchainKHR(device_, swapChain_, nullptr);
+    swapChain_ = VK_NULL_HANDLE;
+  }
   swapChainImages_.clear();
 }
 
-void Context::RecreateSwapChain(VkRenderPass renderPass) {
-  // Handling minimization:
+bool Context::RecreateSwapChain(RenderPassHandle renderPass) {
+  const auto recreateStart = Clock::now();
+  // Handling minimization: there is no swapchain for a zero sized window.
+  // Instead of blocking until the window is restored, the following frames
+  // retry the recreation:
   int width = 0, height = 0;
   glfwGetFramebufferSize(window_, &width, &height);
-  while (width == 0 || height == 0) {
-    glfwGetFramebufferSize(window_, &width, &height);
-    glfwWaitEvents();
+  if (width == 0 || height == 0) {
+    swapChainOutOfDate_ = true;
+    return false;
+  }
+  swapChainOutOfDate_ = false;
+
+  // The frames in flight may still render into and present the old images,
+  // so the old swapchain is retired instead of waiting for the device:
+  const auto oldSwapChain = swapChain_;
+  deletionQueue_.Push(
+      frameNumber_,
+      [this, oldSwapChain, imageViews = std::move(swapChainImageViews_),
+       framebuffers = std::move(swapChainFramebuffers_),
+       depthImage = depthImage_, depthImageView = depthImageView_,
+       depthImageAllocation = depthImageAllocation_] {
+        for (const auto &framebuffer : framebuffers) {
+          vkDestroyFramebuffer(device_, framebuffer, nullptr);
+        }
+        for (const auto &imageView : imageViews) {
+          vkDestroyImageView(device_, imageView, nullptr);
+        }
+        // The depth image has the extent of the old swapchain:
+        if (depthImage != VK_NULL_HANDLE) {
+          vkDestroyImageView(device_, depthImageView, nullptr);
+          vkDestroyImage(device_, depthImage, nullptr);
+          allocator_.Free(depthImageAllocation);
+        }
+        vkDestroySwapchainKHR(device_, oldSwapChain, nullptr);
+      });
+  depthImageView_ = VK_NULL_HANDLE;
+  depthImage_ = VK_NULL_HANDLE;
+  depthImageAllocation_ = {};
+  swapChainImageViews_.clear();
+  swapChainFramebuffers_.clear();
+  swapChainImages_.clear();
+  swapChain_ = VK_NULL_HANDLE;
+
+  CreateSwapChain(oldSwapChain);
+  CreateSwapChainFramebuffers(renderPass);
+  AddFrameTime(FramePhase::SwapchainRecreate, recreateStart);
+  return true;
+}
+
+void Context::CompileRenderGraph() {
+  deletionQueue_.Push(frameNumber_,
+                      [this, retired = renderGraph_.Compile()] {
+                        renderGraph_.DestroyCompiled(retired);
+                      });
+  const auto &stats = renderGraph_.GetStats();
+  std::cout << "Context: Render graph " << stats.passCount << " passes, "
+            << stats.culledPassCount << " culled, " << stats.barrierCount
+            << " barriers, " << stats.transientImageCount
+            << " transient images in " << stats.transientMemorySize << " of "
+            << stats.unaliasedMemorySize << " bytes" << std::endl;
+}
+
+void Context::DestroyBuffer(BufferHandle buffer) {
+  const auto vkBuffer = buffers_.Get<kBufferField>(buffer);
+  if (vkBuffer == nullptr) {
+    throw std::runtime_error("failed to destroy stale buffer handle!");
+  }
+  deletionQueue_.Push(
+      frameNumber_,
+      [this, vkBuffer = *vkBuffer,
+       allocation = *buffers_.Get<kBufferAllocationField>(buffer)] {
+        vkDestroyBuffer(device_, vkBuffer, nullptr);
+        allocator_.Free(allocation);
+      });
+  buffers_.Free(buffer);
+}
+
+void Context::DestroyMeshBuffer(const MeshBuffer &meshBuffer) {
+  DestroyBuffer(meshBuffer.vertexBufferHandle);
+  DestroyBuffer(meshBuffer.indexBufferHandle);
+}
+
+void Context::DestroyPipeline(PipelineHandle pipeline) {
+  VkPipeline vkPipeline{VK_NULL_HANDLE};
+  {
+    std::lock_guard<std::mutex> lock{pipelinesMutex_};
+    vkPipeline = GetVulkanHandle(pipelines_, pipeline);
+    if (vkPipeline == VK_NULL_HANDLE) {
+      throw std::runtime_error("failed to destroy stale pipeline handle!");
+    }
+    pipelines_.Free(pipeline);
   }
+  deletionQueue_.Push(frameNumber_, [device = device_, vkPipeline] {
+    vkDestroyPipeline(device, vkPipeline, nullptr);
+  });
+}
 
-  vkDeviceWaitIdle(device_);
+void Context::DestroyDescriptorPool(DescriptorPoolHandle descriptorPool) {
+  const auto vkDescriptorPool = GetDescriptorPool(descriptorPool);
+  if (vkDescriptorPool == VK_NULL_HANDLE) {
+    throw std::runtime_error(
+        "failed to destroy stale descriptor pool handle!");
+  }
+  descriptorPools_.Free(descriptorPool);
+  deletionQueue_.Push(frameNumber_, [device = device_, vkDescriptorPool] {
+    vkDestroyDescriptorPool(device, vkDescriptorPool, nullptr);
+  });
+}
 
-  CleanupSwapChain();
-  CreateSwapChain();
-  CreateSwapChainFramebuffers(renderPass);
+std::uint32_t Context::AddBindlessStorageBuffer(BufferHandle buffer) {
+  if (!bindlessEnabled_) {
+    throw std::runtime_error("failed to add buffer, bindless is disabled!");
+  }
+  const auto vkBuffer = buffers_.Get<kBufferField>(buffer);
+  if (vkBuffer == nullptr) {
+    throw std::runtime_error("failed to add stale buffer handle!");
+  }
+  return bindlessTable_.AddStorageBuffer(*vkBuffer);
+}
+
+std::uint32_t Context::AddBindlessTexture(VkImageView imageView,
+                                          VkSampler sampler) {
+  if (!bindlessEnabled_) {
+    throw std::runtime_error("failed to add texture, bindless is disabled!");
+  }
+  return bindlessTable_.AddTexture(imageView, sampler);
+}
+
+void Context::RemoveBindlessStorageBuffer(std::uint32_t index) {
+  bindlessTable_.RemoveStorageBuffer(index);
+  // A new buffer must not be written into the slot while it is read:
+  deletionQueue_.Push(frameNumber_, [this, index] {
+    bindlessTable_.ReleaseStorageBuffer(index);
+  });
+}
+
+void Context::RemoveBindlessTexture(std::uint32_t index) {
+  bindlessTable_.RemoveTexture(index);
+  deletionQueue_.Push(frameNumber_,
+                      [this, index] { bindlessTable_.ReleaseTexture(index); });
+}
+
+void Context::AddFrameTime(FramePhase phase, Clock::time_point start) {
+  frameTiming_.phaseMilliseconds[static_cast<std::size_t>(phase)] +=
+      std::chrono::duration<float, std::milli>(Clock::now() - start).count();
 }
 
 } // namespace render
\ No newline at end of file
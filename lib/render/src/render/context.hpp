@@ -3,16 +3,36 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include "render/bindless_table.hpp"
+#include "render/deletion_queue.hpp"
+#include "render/frame_context.hpp"
+#include "render/frame_stats.hpp"
+#include "render/gpu_profiler.hpp"
+#include "render/handle_pool.hpp"
+#include "render/memory_allocator.hpp"
+#include "render/pipeline_cache.hpp"
+#include "render/render_graph.hpp"
+#include "render/shader_library.hpp"
+#include "render/span.hpp"
+#include "render/staging_ring.hpp"
+#include "render/thread_pool.hpp"
+#include "render/timeline.hpp"
+#include "render/uniform_ring.hpp"
+
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <algorithm> // Necessary for std::clamp
+#include <array>
+#include <chrono>
 #include <cstdint>   // Necessary for uint32_t
 #include <cstdlib>
 #include <cstring>
+#include <future>
 #include <iostream>
 #include <limits> // Necessary for std::numeric_limits
+#include <mutex>
 #include <optional>
 #include <set>
 #include <stdexcept>
@@ -22,40 +42,128 @@
 
 namespace render {
 
-constexpr int kMaxFramesInFlight{2};
-
 /// Defines vertex data.
 struct Vertex final {
   glm::vec2 pos;
   glm::vec3 color;
 };
 
+/// Defines vertex data packed into 8 bytes instead of the 20 of Vertex:
+/// half-float positions and 8-bit normalized RGBA colors. The shaders read it
+/// unchanged, the vertex input converts it back to vec2 and vec3 (the alpha
+/// channel is dropped).
+struct PackedVertex final {
+  std::array<std::uint16_t, 2> pos;
+  std::array<std::uint8_t, 4> color;
+};
+
+/// Vertex layouts the graphics pipelines can read.
+enum class VertexFormat : std::uint32_t { Float, Packed };
+
+/// Vertex attribute formats of a vertex type.
+template <typename VertexType> struct VertexTraits;
+
+template <> struct VertexTraits<Vertex> final {
+  static constexpr VertexFormat kFormat{VertexFormat::Float};
+  static constexpr VkFormat kPositionFormat{VK_FORMAT_R32G32_SFLOAT};
+  static constexpr VkFormat kColorFormat{VK_FORMAT_R32G32B32_SFLOAT};
+};
+
+template <> struct VertexTraits<PackedVertex> final {
+  static constexpr VertexFormat kFormat{VertexFormat::Packed};
+  static constexpr VkFormat kPositionFormat{VK_FORMAT_R16G16_SFLOAT};
+  static constexpr VkFormat kColorFormat{VK_FORMAT_R8G8B8A8_UNORM};
+};
+
 /// Returns bindings description: spacing between data and whether the data is
 /// per-vertex or per-instance.
+template <typename VertexType = Vertex>
 inline VkVertexInputBindingDescription GetBindingDescription() {
   VkVertexInputBindingDescription bindingDescription{};
   bindingDescription.binding = 0;
-  bindingDescription.stride = sizeof(Vertex);
+  bindingDescription.stride = sizeof(VertexType);
   bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
   return bindingDescription;
 }
 
 /// Returns Attribute descriptions: type of the attributes passed to the
 /// vertex shader, which binding to load them from and at which offset.
+template <typename VertexType = Vertex>
 inline std::array<VkVertexInputAttributeDescription, 2>
 GetAttributeDescriptions() {
+  using Traits = VertexTraits<VertexType>;
   std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
   attributeDescriptions[0].binding = 0;
   attributeDescriptions[0].location = 0;
-  attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-  attributeDescriptions[0].offset = offsetof(Vertex, pos);
+  attributeDescriptions[0].format = Traits::kPositionFormat;
+  attributeDescriptions[0].offset = offsetof(VertexType, pos);
   attributeDescriptions[1].binding = 0;
   attributeDescriptions[1].location = 1;
-  attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-  attributeDescriptions[1].offset = offsetof(Vertex, color);
+  attributeDescriptions[1].format = Traits::kColorFormat;
+  attributeDescriptions[1].offset = offsetof(VertexType, color);
+  return attributeDescriptions;
+}
+
+/// Returns the size of a vertex of the layout.
+inline std::uint32_t GetVertexSize(VertexFormat format) {
+  return format == VertexFormat::Packed ? sizeof(PackedVertex)
+                                        : sizeof(Vertex);
+}
+
+/// Returns the size of an index of the type.
+inline std::uint32_t GetIndexSize(VkIndexType indexType) {
+  return indexType == VK_INDEX_TYPE_UINT32 ? sizeof(std::uint32_t)
+                                           : sizeof(std::uint16_t);
+}
+
+/// Converts a float into a half float, rounding to the nearest even value.
+std::uint16_t PackHalf(float value);
+
+/// Converts the vertex into the packed layout.
+PackedVertex PackVertex(const Vertex &vertex);
+
+/// Converts the vertices into the packed layout.
+std::vector<PackedVertex> PackVertices(Span<const Vertex> vertices);
+
+/// Defines per-instance data.
+struct InstanceData final {
+  glm::mat4 model;
+  glm::vec4 color;
+};
+
+/// Returns the instance binding description: the data advances per instance.
+inline VkVertexInputBindingDescription GetInstanceBindingDescription() {
+  VkVertexInputBindingDescription bindingDescription{};
+  bindingDescription.binding = 1;
+  bindingDescription.stride = sizeof(InstanceData);
+  bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+  return bindingDescription;
+}
+
+/// Returns the instance attribute descriptions: a mat4 takes four locations
+/// (2-5, one per column) followed by the color at location 6.
+inline std::array<VkVertexInputAttributeDescription, 5>
+GetInstanceAttributeDescriptions() {
+  std::array<VkVertexInputAttributeDescription, 5> attributeDescriptions{};
+  for (std::uint32_t column{0}; column < 4; ++column) {
+    attributeDescriptions[column].binding = 1;
+    attributeDescriptions[column].location = 2 + column;
+    attributeDescriptions[column].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    attributeDescriptions[column].offset = static_cast<std::uint32_t>(
+        offsetof(InstanceData, model) + column * sizeof(glm::vec4));
+  }
+  attributeDescriptions[4].binding = 1;
+  attributeDescriptions[4].location = 6;
+  attributeDescriptions[4].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+  attributeDescriptions[4].offset = offsetof(InstanceData, color);
   return attributeDescriptions;
 }
 
+/// Defines per-draw push constants of shaders/shader_push.vert.
+struct PushConstants final {
+  alignas(16) glm::mat4 model;
+};
+
 /// Defines uniform buffer.
 struct UniformBufferObject final {
   alignas(16) glm::mat4 model;
@@ -66,33 +174,124 @@ struct UniformBufferObject final {
 struct ContextOptions final {
   bool enableValidationLayers{true};
   std::string title{"Vulkan Project Engine"};
+  /// Pins the GPU by its index in vkEnumeratePhysicalDevices order, the
+  /// highest rated suitable GPU is used otherwise.
+  std::optional<std::uint32_t> deviceIndex{};
+  /// Pins the GPU by its device UUID in hex, dashes are ignored. The UUIDs
+  /// are logged at Initialize, they need a Vulkan 1.1 loader.
+  std::string deviceUuid{};
+  /// Initial window size.
+  std::uint32_t width{1600U};
+  std::uint32_t height{1200U};
+  /// Hidden windows are still presented to, e.g. for benchmarks.
+  bool windowVisible{true};
+  /// Renders into device local images instead of a swapchain. No window,
+  /// surface or present queue is created and the frame rate is limited only
+  /// by the GPU. The swapchain getters describe the offscreen images.
+  bool offscreen{false};
+  /// Format of the offscreen images, an uncompressed color format.
+  VkFormat offscreenFormat{VK_FORMAT_R8G8B8A8_UNORM};
+  /// Copies every offscreen frame into a mapped buffer.
+  bool offscreenReadback{true};
+  /// Present modes in order of preference, the first one supported by the
+  /// surface is used and FIFO, which is always supported, otherwise. E.g.
+  /// IMMEDIATE or FIFO_RELAXED with a single frame in flight gives the lowest
+  /// latency.
+  std::vector<VkPresentModeKHR> presentModes{VK_PRESENT_MODE_MAILBOX_KHR};
+  /// Requested number of swapchain images, clamped to the surface limits. 0
+  /// requests one image more than the surface minimum.
+  std::uint32_t swapchainImageCount{0};
+  /// Frames the CPU may record ahead of the GPU, at least 1. Every frame in
+  /// flight has its own fence, semaphores, command pools, uniform ring frame
+  /// and query pools: 1 minimizes the latency, 3 maximizes the throughput.
+  std::uint32_t framesInFlight{2};
+  /// Worker threads recording draw items into secondary command buffers,
+  /// 0 records everything on the calling thread.
+  std::uint32_t recordingThreadCount{0};
+  /// Threads compiling pipelines of CreateGraphicsPipelinesAsync, 0 uses all
+  /// hardware threads.
+  std::uint32_t pipelineThreadCount{0};
+  /// Uniform data a single frame may push into the uniform ring.
+  VkDeviceSize uniformRingFrameSize{4U * 1024U * 1024U};
+  /// Pipeline cache file, loaded at Initialize and saved at Cleanup. Empty
+  /// keeps the cache in memory only.
+  std::string pipelineCachePath{};
+  /// Measures GPU time and pipeline statistics of the recorded scopes.
+  bool gpuProfiling{false};
+  /// Number of latest frames kept by the frame stats.
+  std::uint32_t frameStatsCapacity{1024};
+  /// Creates the bindless set if the device supports descriptor indexing,
+  /// see Context::IsBindlessEnabled.
+  bool bindless{false};
+  /// Bindless array sizes, clamped to the update-after-bind limits.
+  std::uint32_t bindlessStorageBufferCount{4096};
+  std::uint32_t bindlessTextureCount{4096};
+  /// Paces frames and uploads with timeline semaphores instead of fences if
+  /// the device supports VK_KHR_timeline_semaphore, see
+  /// Context::IsTimelineEnabled.
+  bool timelineSemaphores{true};
+  /// Watches the shaders loaded with LoadShader and rebuilds the reloadable
+  /// pipelines when they change, see CreateReloadablePipeline.
+  bool shaderHotReload{false};
+  /// GLSL compiler of the edited shader sources, empty reloads the SPIR-V
+  /// files only.
+  std::string shaderCompiler{"glslc"};
 };
 
 struct ImageViewOptions final {
   VkImage image{VK_NULL_HANDLE};
   VkFormat format{};
+  VkImageAspectFlags aspectMask{VK_IMAGE_ASPECT_COLOR_BIT};
 };
 
+/// Handle of an image view created by the Context.
+using ImageViewHandle = Handle<struct ImageViewTag>;
+
 struct RenderPassOptions final {
   VkFormat format{};
+  /// Format of the depth attachment, e.g. Context::GetDepthFormat().
+  /// UNDEFINED renders without a depth buffer.
+  VkFormat depthFormat{VK_FORMAT_UNDEFINED};
 };
 
+/// Handle of a render pass created by the Context.
+using RenderPassHandle = Handle<struct RenderPassTag>;
+
 struct FrameBufferOptions final {
   VkRenderPass renderPass{VK_NULL_HANDLE};
   VkImageView imageAttachment{VK_NULL_HANDLE};
+  /// Required if the render pass has a depth attachment.
+  VkImageView depthAttachment{VK_NULL_HANDLE};
   VkExtent2D extent{};
 };
 
+/// Handle of a framebuffer created by the Context.
+using FramebufferHandle = Handle<struct FramebufferTag>;
+
 struct DescriptorSetLayoutOptions final {
   std::uint32_t binding{};
   VkDescriptorType type{};
   VkShaderStageFlags stageFlags{};
+  /// Several bindings, used instead of the single binding if not empty.
+  std::vector<VkDescriptorSetLayoutBinding> bindings{};
 };
 
+/// Handle of a descriptor set layout created by the Context.
+using DescriptorSetLayoutHandle = Handle<struct DescriptorSetLayoutTag>;
+
 struct PipelineLayoutOptions final {
+  /// Single set layout, used if descriptorSetLayouts is empty.
   VkDescriptorSetLayout descriptorSetLayout{VK_NULL_HANDLE};
+  /// Set layouts in set number order.
+  std::vector<VkDescriptorSetLayout> descriptorSetLayouts{};
+  /// Push constant ranges, at most maxPushConstantsSize bytes in total
+  /// (guaranteed to be at least 128 bytes).
+  std::vector<VkPushConstantRange> pushConstantRanges{};
 };
 
+/// Handle of a pipeline layout created by the Context.
+using PipelineLayoutHandle = Handle<struct PipelineLayoutTag>;
+
 struct GraphicsPipelineOptions final {
   VkShaderModule vertexShader{VK_NULL_HANDLE};
   VkShaderModule fragmentShader{VK_NULL_HANDLE};
@@ -101,29 +300,243 @@ struct GraphicsPipelineOptions final {
   VkPrimitiveTopology topology{};
   VkPolygonMode polygonMode{};
   VkExtent2D viewportExtent{};
+  /// Layout of the vertex buffer: Vertex or PackedVertex.
+  VertexFormat vertexFormat{VertexFormat::Float};
+  /// Tests and writes the depth (LESS), the render pass needs a depth
+  /// attachment.
+  bool depthTest{false};
+  /// Adds the per-instance binding (InstanceData) to the vertex input.
+  bool instanced{false};
+};
+
+/// Graphics pipeline rebuilt whenever one of its shaders is reloaded.
+struct ReloadablePipelineOptions final {
+  /// The shader modules are taken from the shaders below.
+  GraphicsPipelineOptions pipeline{};
+  ShaderHandle vertexShader{};
+  ShaderHandle fragmentShader{};
+};
+
+/// Index of a pipeline created by Context::CreateReloadablePipeline.
+struct ReloadablePipeline final {
+  std::uint32_t index{~0U};
+};
+
+struct ComputePipelineOptions final {
+  VkShaderModule computeShader{VK_NULL_HANDLE};
+  VkPipelineLayout pipelineLayout{VK_NULL_HANDLE};
+};
+
+/// Handle of a graphics or compute pipeline created by the Context.
+using PipelineHandle = Handle<struct PipelineTag>;
+
+/// Pipeline compiled on the pipeline threads.
+struct CompiledPipeline final {
+  PipelineHandle handle{};
+  VkPipeline pipeline{VK_NULL_HANDLE};
+};
+
+/// Graphics pipeline compiled in the background.
+class AsyncPipeline final {
+public:
+  AsyncPipeline() = default;
+  AsyncPipeline(std::shared_future<CompiledPipeline> future,
+                VkPipeline fallback)
+      : future_{std::move(future)}, fallback_{fallback} {}
+
+  /// Returns false for a default constructed pipeline.
+  bool IsValid() const { return future_.valid(); }
+
+  /// Returns true once the pipeline is compiled.
+  bool IsReady() const {
+    return future_.valid() && future_.wait_for(std::chrono::seconds{0}) ==
+                                  std::future_status::ready;
+  }
+
+  /// Returns the pipeline if it is ready and the fallback otherwise, never
+  /// blocks. Rethrows the compilation error once it is ready.
+  VkPipeline Get() const {
+    return IsReady() ? future_.get().pipeline : fallback_;
+  }
+
+  /// Blocks until the pipeline is compiled.
+  VkPipeline Wait() const { return future_.get().pipeline; }
+
+  /// Blocks until the pipeline is compiled and returns its handle, e.g. for
+  /// Context::DestroyPipeline.
+  PipelineHandle GetHandle() const { return future_.get().handle; }
+
+private:
+  std::shared_future<CompiledPipeline> future_{};
+  VkPipeline fallback_{VK_NULL_HANDLE};
 };
 
 struct CommandPoolOptions final {};
 
+/// Handle of a command pool created by the Context.
+using CommandPoolHandle = Handle<struct CommandPoolTag>;
+
 struct CommandBufferOptions final {
   VkCommandPool commandPool{VK_NULL_HANDLE};
 };
 
+/// The buffer options view the data, it is copied straight into the staging
+/// ring and has to stay valid only during the Create call.
 struct VertexBufferOptions final {
-  VkCommandPool commandPool{VK_NULL_HANDLE};
-  std::vector<Vertex> vertices{};
+  Span<const Vertex> vertices{};
+  /// Vertices in the packed layout, used instead of vertices if not empty.
+  Span<const PackedVertex> packedVertices{};
 };
 
 struct IndexBufferOptions final {
-  VkCommandPool commandPool{VK_NULL_HANDLE};
-  std::vector<std::uint16_t> indices{};
+  Span<const std::uint16_t> indices{};
+  /// 32-bit indices, drawn with VK_INDEX_TYPE_UINT32, used instead of indices
+  /// if not empty.
+  Span<const std::uint32_t> indices32{};
+};
+
+struct InstanceBufferOptions final {
+  Span<const InstanceData> instances{};
+};
+
+struct IndirectBufferOptions final {
+  Span<const VkDrawIndexedIndirectCommand> commands{};
+};
+
+struct StorageBufferOptions final {
+  /// Initial data, the rest of the buffer is left undefined.
+  Span<const char> data{};
+  /// Buffer size, at least the data size.
+  VkDeviceSize size{};
+  /// Usage in addition to STORAGE_BUFFER, e.g. INDIRECT_BUFFER or
+  /// VERTEX_BUFFER for data written by compute shaders.
+  VkBufferUsageFlags usage{};
+};
+
+/// Views of the vertex and index data of a mesh, e.g. into a MeshFile.
+struct Mesh final {
+  Span<const Vertex> vertices{};
+  Span<const std::uint16_t> indices{};
+  /// Vertices in the packed layout, used instead of vertices if not empty.
+  Span<const PackedVertex> packedVertices{};
+  /// 32-bit indices, needed by meshes of more than 65536 vertices, used
+  /// instead of indices if not empty.
+  Span<const std::uint32_t> indices32{};
+
+  VertexFormat GetVertexFormat() const {
+    return packedVertices.empty() ? VertexFormat::Float : VertexFormat::Packed;
+  }
+  VkIndexType GetIndexType() const {
+    return indices32.empty() ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+  }
+  std::size_t GetVertexCount() const {
+    return packedVertices.empty() ? vertices.size() : packedVertices.size();
+  }
+  std::size_t GetIndexCount() const {
+    return indices32.empty() ? indices.size() : indices32.size();
+  }
+};
+
+/// The meshes of a mesh buffer share the vertex layout and the index type
+/// of the first one.
+struct MeshBufferOptions final {
+  std::vector<Mesh> meshes{};
+};
+
+/// Location of a mesh in the shared vertex and index buffers. Indices stay
+/// local to the mesh, vertexOffset is added to them when drawing.
+struct MeshRange final {
+  std::uint32_t firstIndex{};
+  std::uint32_t indexCount{};
+  std::int32_t vertexOffset{};
+};
+
+/// Handle of a buffer created by the Context.
+using BufferHandle = Handle<struct BufferTag>;
+
+/// Vertex and index buffers shared by all meshes, so any number of them can
+/// be drawn without rebinding buffers.
+struct MeshBuffer final {
+  VkBuffer vertexBuffer{VK_NULL_HANDLE};
+  VkBuffer indexBuffer{VK_NULL_HANDLE};
+  BufferHandle vertexBufferHandle{};
+  BufferHandle indexBufferHandle{};
+  VertexFormat vertexFormat{VertexFormat::Float};
+  VkIndexType indexType{VK_INDEX_TYPE_UINT16};
+  std::vector<MeshRange> meshes{};
+};
+
+/// Returns the indirect draw command drawing instances of the mesh.
+inline VkDrawIndexedIndirectCommand
+GetDrawCommand(const MeshRange &mesh, std::uint32_t instanceCount,
+               std::uint32_t firstInstance) {
+  VkDrawIndexedIndirectCommand command{};
+  command.indexCount = mesh.indexCount;
+  command.instanceCount = instanceCount;
+  command.firstIndex = mesh.firstIndex;
+  command.vertexOffset = mesh.vertexOffset;
+  command.firstInstance = firstInstance;
+  return command;
+}
+
+/// Returns the radius of the bounding sphere around the mesh origin.
+inline float GetBoundingRadius(Span<const Vertex> vertices) {
+  float radius{0.0f};
+  for (const auto &vertex : vertices) {
+    radius = std::max(radius, glm::length(vertex.pos));
+  }
+  return radius;
+}
+
+/// Bounding sphere of an instance read by the culling shader
+/// (shaders/shader_cull.comp), std430 layout.
+struct CullInstance final {
+  /// Center in the space UniformBufferObject::model transforms, i.e. with
+  /// the instance model applied, and the radius in w.
+  glm::vec4 sphere;
+  /// Mesh drawing the instance, index of its draw command.
+  std::uint32_t meshIndex;
+  std::uint32_t padding[3];
+};
+
+/// Returns the bounding sphere of the instance of a mesh with the bounding
+/// radius, the radius grows with the largest scale of the instance model.
+inline CullInstance GetCullInstance(const InstanceData &instance,
+                                    float meshRadius,
+                                    std::uint32_t meshIndex) {
+  const float scale = std::max({glm::length(glm::vec3(instance.model[0])),
+                                glm::length(glm::vec3(instance.model[1])),
+                                glm::length(glm::vec3(instance.model[2]))});
+  CullInstance cullInstance{};
+  cullInstance.sphere = glm::vec4(glm::vec3(instance.model[3]),
+                                  meshRadius * scale);
+  cullInstance.meshIndex = meshIndex;
+  return cullInstance;
+}
+
+/// Indirect drawing capabilities of the device.
+struct DrawIndirectSupport final {
+  /// More than one draw per vkCmdDrawIndexedIndirect (multiDrawIndirect).
+  bool multiDraw{false};
+  /// Non-zero firstInstance in the commands (drawIndirectFirstInstance).
+  bool firstInstance{false};
+  /// GPU-side draw count (VK_KHR_draw_indirect_count).
+  bool drawCount{false};
 };
 
 struct DescriptorPoolOptions final {
   VkDescriptorType type{};
   std::uint32_t descriptorCount{};
+  /// Descriptors of several types, used instead of type and descriptorCount
+  /// if not empty.
+  std::vector<VkDescriptorPoolSize> poolSizes{};
+  /// Number of sets allocated from the pool, 0 allows descriptorCount sets.
+  std::uint32_t maxSets{0};
 };
 
+/// Handle of a descriptor pool created by the Context.
+using DescriptorPoolHandle = Handle<struct DescriptorPoolTag>;
+
 struct DescriptorSetOptions final {
   VkDescriptorPool descriptorPool{VK_NULL_HANDLE};
   VkDescriptorSetLayout descriptorSetLayout{VK_NULL_HANDLE};
@@ -131,48 +544,185 @@ struct DescriptorSetOptions final {
 
 struct UpdateDescriptorSetOptions final {
   VkDescriptorSet descriptorSet{VK_NULL_HANDLE};
+  std::uint32_t binding{0};
   VkDescriptorType descriptorType{};
+  /// Buffer of the descriptor, a uniform or a storage buffer.
   VkBuffer uniformBuffer{VK_NULL_HANDLE};
+  VkDeviceSize offset{0};
+  /// Size of the data visible through the descriptor, for dynamic uniform
+  /// buffers the size of the data at a single dynamic offset.
+  VkDeviceSize range{sizeof(UniformBufferObject)};
+};
+
+/// Single indexed draw of a draw list.
+struct DrawItem final {
+  VkBuffer vertexBuffer{VK_NULL_HANDLE};
+  VkBuffer indexBuffer{VK_NULL_HANDLE};
+  /// Per-instance data, requires an instanced pipeline.
+  VkBuffer instanceBuffer{VK_NULL_HANDLE};
+  /// Offset of the instance data, e.g. of a FrameContext::AllocateUniformData
+  /// allocation in the uniform ring buffer.
+  VkDeviceSize instanceBufferOffset{};
+  VkIndexType indexType{VK_INDEX_TYPE_UINT16};
+  std::uint32_t indexCount{};
+  std::uint32_t instanceCount{1};
+  std::uint32_t firstIndex{};
+  std::int32_t vertexOffset{};
+  std::uint32_t firstInstance{};
+  /// Uniform ring offset of the item data, used with dynamic uniforms.
+  std::uint32_t dynamicOffset{};
+  /// Pipeline of the item, VK_NULL_HANDLE keeps the current one. The
+  /// pipelines of a draw list have to share the options pipeline layout and
+  /// it is rebound only when it changes, so items should be sorted by it.
+  VkPipeline pipeline{VK_NULL_HANDLE};
+  /// Push constants of the item, must stay valid during the recording.
+  const void *pushConstants{nullptr};
+  std::uint32_t pushConstantsSize{};
+  /// View space depth of the item, see SortDrawItems.
+  float depth{};
+};
+
+/// Returns the view space depth of a position, GetViewDepth(view * model,
+/// center) for the center of a draw.
+inline float GetViewDepth(const glm::mat4 &modelView,
+                          const glm::vec3 &position) {
+  return -(modelView * glm::vec4(position, 1.0f)).z;
+}
+
+/// Sorts the draw items by pipeline and then front to back by depth.
+///
+/// Consecutive items of a pipeline bind it once, and nearer items are drawn
+/// first, so with depth testing early-Z rejects the hidden fragments of the
+/// later ones. Items keeping the current pipeline (VK_NULL_HANDLE) are
+/// sorted first and still draw with the options pipeline. The sort is
+/// stable, items of the same depth keep their order.
+void SortDrawItems(Span<DrawItem> drawItems);
+
+/// Compute work recorded before the render pass, e.g. culling writing the
+/// indirect draw commands.
+struct ComputeDispatch final {
+  VkPipeline pipeline{VK_NULL_HANDLE};
+  VkPipelineLayout pipelineLayout{VK_NULL_HANDLE};
+  VkDescriptorSet descriptorSet{VK_NULL_HANDLE};
+  /// The descriptor set has a single UNIFORM_BUFFER_DYNAMIC binding bound
+  /// with dynamicOffset.
+  bool dynamicUniforms{false};
+  std::uint32_t dynamicOffset{};
+  /// Push constants of the COMPUTE stage.
+  const void *pushConstants{nullptr};
+  std::uint32_t pushConstantsSize{};
+  /// Copied over resetBuffer before the dispatch, e.g. draw commands with
+  /// zero instance counts the dispatch counts into.
+  VkBuffer resetSource{VK_NULL_HANDLE};
+  VkBuffer resetBuffer{VK_NULL_HANDLE};
+  VkDeviceSize resetSize{};
+  std::uint32_t groupCountX{1};
+  std::uint32_t groupCountY{1};
+  std::uint32_t groupCountZ{1};
 };
 
+/// Set number of the bindless set in bindless pipeline layouts, set 0 is the
+/// descriptor set of the draws.
+constexpr std::uint32_t kBindlessSet{1};
+
 struct RecordCommandBufferOptions final {
+  /// Nothing is drawn without a pipeline, the render pass only clears.
   VkPipeline pipeline{VK_NULL_HANDLE};
   VkPipelineLayout pipelineLayout{VK_NULL_HANDLE};
   VkDescriptorSet descriptorSet{VK_NULL_HANDLE};
+  /// Binds the bindless set as kBindlessSet once for all the draws.
+  bool bindless{false};
+  /// The descriptor set has a single UNIFORM_BUFFER_DYNAMIC binding. It is
+  /// bound with dynamicOffset, draw items rebind it with their own offsets.
+  bool dynamicUniforms{false};
+  std::uint32_t dynamicOffset{};
+  /// Push constants written right after the pipeline is bound, draw items
+  /// push their own ones for the same stages.
+  VkShaderStageFlags pushConstantStages{};
+  const void *pushConstants{nullptr};
+  std::uint32_t pushConstantsSize{};
   VkRenderPass renderPass{VK_NULL_HANDLE};
   VkClearValue clearColor{};
   VkCommandBuffer commandBuffer{VK_NULL_HANDLE};
   VkBuffer vertexBuffer{VK_NULL_HANDLE};
   VkBuffer indexBuffer{VK_NULL_HANDLE};
+  VkIndexType indexType{VK_INDEX_TYPE_UINT16};
   std::uint32_t indexCount{};
+  /// Per-instance data, requires an instanced pipeline.
+  VkBuffer instanceBuffer{VK_NULL_HANDLE};
+  /// Offset of the instance data, e.g. of a FrameContext::AllocateUniformData
+  /// allocation in the uniform ring buffer.
+  VkDeviceSize instanceBufferOffset{};
+  std::uint32_t instanceCount{1};
+  /// VkDrawIndexedIndirectCommand records replacing the direct draw if set.
+  VkBuffer indirectBuffer{VK_NULL_HANDLE};
+  VkDeviceSize indirectOffset{};
+  /// Number of records, the maximum draw count if a count buffer is used.
+  std::uint32_t drawCount{};
+  /// Optional uint32 draw count written by the GPU. Without device support
+  /// all drawCount records are drawn, so unused ones need zero instanceCount.
+  VkBuffer countBuffer{VK_NULL_HANDLE};
+  VkDeviceSize countOffset{};
+  /// Draw list replacing the draw described by the buffers above if not
+  /// empty. With recording threads its slices are recorded in parallel.
+  const DrawItem *drawItems{nullptr};
+  std::uint32_t drawItemCount{};
+  /// Dispatches recorded before the render pass. Their writes are visible to
+  /// the indirect draws and the vertex input of the render pass, and they
+  /// wait for the draws of the previous frames, which may read the buffers
+  /// they write.
+  const ComputeDispatch *computeDispatches{nullptr};
+  std::uint32_t computeDispatchCount{};
 };
 
 struct BeginFrameOptions final {
-  VkRenderPass renderPass{VK_NULL_HANDLE};
+  /// Render pass of the swapchain framebuffers, they are recreated with the
+  /// swapchain.
+  RenderPassHandle renderPass{};
 };
 
 struct UpdateUniformBufferOptions final {
-  std::uint32_t uniformBufferIndex{};
+  BufferHandle uniformBuffer{};
   UniformBufferObject data{};
 };
 
 struct BeginFrameInfo final {
   bool ifSwapchainRecreated{};
+  /// Primary command buffer of the frame, valid until the frame slot is
+  /// reused. VK_NULL_HANDLE if the swapchain has been recreated.
+  VkCommandBuffer commandBuffer{VK_NULL_HANDLE};
+  /// The window is minimized, the swapchain is recreated by a later
+  /// BeginFrame once it is restored. ifSwapchainRecreated is set as well.
+  bool ifMinimized{};
+  /// Resources of the frame, valid until EndFrame. nullptr if nothing is
+  /// rendered.
+  FrameContext *frame{nullptr};
 };
 
 struct EndFrameOptions final {
-  VkRenderPass renderPass{VK_NULL_HANDLE};
+  RenderPassHandle renderPass{};
   VkCommandBuffer commandBuffer{VK_NULL_HANDLE};
 };
 
 struct EndFrameInfo final {};
 
+/// Pixels of a completed offscreen frame, rows are tightly packed.
+struct OffscreenReadback final {
+  /// Mapped data, nullptr if there is no completed frame.
+  const void *data{nullptr};
+  VkDeviceSize size{};
+  VkExtent2D extent{};
+  VkFormat format{};
+};
+
 /// Context provides render interfaces based on Vulkan API.
 class Context final {
 public:
   struct QueueFamilyIndices final {
     std::optional<std::uint32_t> graphicsFamily;
     std::optional<std::uint32_t> presentFamily;
+    /// Family without graphics support for the uploads, if there is one.
+    std::optional<std::uint32_t> transferFamily;
   };
 
   struct SwapChainSupportDetails final {
@@ -221,13 +771,18 @@ public:
   void Initialize(const ContextOptions &options);
 
   /// Create framebuffers for default swapchain.
-  void CreateSwapChainFramebuffers(VkRenderPass renderPass);
+  void CreateSwapChainFramebuffers(RenderPassHandle renderPass);
 
   /// Destroys all Vulkan created resources and terminates GLFW.
   void Cleanup();
 
   /// Creates an image view.
-  VkImageView CreateImageView(const ImageViewOptions &options);
+  ImageViewHandle CreateImageView(const ImageViewOptions &options);
+
+  /// Returns the Vulkan image view, VK_NULL_HANDLE if the handle is stale.
+  VkImageView GetImageView(ImageViewHandle imageView) const {
+    return GetVulkanHandle(imageViews_, imageView);
+  }
 
   /// @}
 
@@ -236,10 +791,22 @@ public:
 
   /// Creates a shader module from the shader bytecode (SPIR-V).
   ///
-  /// @param code  Shader SPIR-V bytecode.
+  /// @param code  Shader SPIR-V bytecode, 4-byte aligned, e.g. a mapped
+  /// file.
+  ///
+  /// Identical SPIR-V returns the same module, the modules live until
+  /// Cleanup.
   ///
   /// @return VkShaderModule.
-  VkShaderModule CreateShaderModule(const std::vector<char> &code);
+  VkShaderModule CreateShaderModule(Span<const char> code);
+
+  /// Loads a SPIR-V file, watched with ContextOptions::shaderHotReload.
+  ShaderHandle LoadShader(const ShaderFileOptions &options);
+
+  /// Returns the current module of a loaded shader.
+  VkShaderModule GetShaderModule(ShaderHandle shader) const {
+    return shaderLibrary_.GetModule(shader);
+  }
 
   /// Creates a render pass.
   ///
@@ -247,7 +814,12 @@ public:
   /// attachments, used during rendering (framebuffer attachments).
   ///
   /// Render passes operate in conjunction with framebuffers.
-  VkRenderPass CreateRenderPass(const RenderPassOptions &options);
+  RenderPassHandle CreateRenderPass(const RenderPassOptions &options);
+
+  /// Returns the Vulkan render pass, VK_NULL_HANDLE if the handle is stale.
+  VkRenderPass GetRenderPass(RenderPassHandle renderPass) const {
+    return GetVulkanHandle(renderPasses_, renderPass);
+  }
 
   /// Creates a framebuffer object.
   ///
@@ -255,20 +827,87 @@ public:
   /// wrapping them into a VkFramebuffer object. Framebuffers represent a
   /// collection of specific memory attachments that a render pass instance
   /// uses.
-  VkFramebuffer CreateFramebuffer(const FrameBufferOptions &options);
+  FramebufferHandle CreateFramebuffer(const FrameBufferOptions &options);
+
+  /// Returns the Vulkan framebuffer, VK_NULL_HANDLE if the handle is stale.
+  VkFramebuffer GetFramebuffer(FramebufferHandle framebuffer) const {
+    return GetVulkanHandle(framebuffers_, framebuffer);
+  }
 
   /// Creates a description set layout.
   ///
   /// Specifies the types of resources that are going to be accessed by the
   /// pipeline.
-  VkDescriptorSetLayout
+  DescriptorSetLayoutHandle
   CreateDescriptorSetLayout(const DescriptorSetLayoutOptions &options);
 
+  /// Returns the Vulkan descriptor set layout, VK_NULL_HANDLE if the handle
+  /// is stale.
+  VkDescriptorSetLayout
+  GetDescriptorSetLayout(DescriptorSetLayoutHandle descriptorSetLayout) const {
+    return GetVulkanHandle(descriptorSetLayouts_, descriptorSetLayout);
+  }
+
   /// Creates a pipeline layout.
-  VkPipelineLayout CreatePipelineLayout(const PipelineLayoutOptions &options);
+  PipelineLayoutHandle
+  CreatePipelineLayout(const PipelineLayoutOptions &options);
+
+  /// Returns the Vulkan pipeline layout, VK_NULL_HANDLE if the handle is
+  /// stale.
+  VkPipelineLayout
+  GetPipelineLayout(PipelineLayoutHandle pipelineLayout) const {
+    return GetVulkanHandle(pipelineLayouts_, pipelineLayout);
+  }
 
   /// Creates a graphics pipeline.
-  VkPipeline CreateGraphicsPipeline(const GraphicsPipelineOptions &options);
+  ///
+  /// Thread-safe, pipelines are compiled against the shared pipeline cache.
+  PipelineHandle CreateGraphicsPipeline(const GraphicsPipelineOptions &options);
+
+  /// Returns the Vulkan pipeline, VK_NULL_HANDLE if the handle is stale.
+  ///
+  /// Thread-safe like the pipeline creation.
+  VkPipeline GetPipeline(PipelineHandle pipeline) const {
+    std::lock_guard<std::mutex> lock{pipelinesMutex_};
+    return GetVulkanHandle(pipelines_, pipeline);
+  }
+
+  /// Compiles a batch of graphics pipelines on the pipeline threads.
+  ///
+  /// The shader modules, layouts and render passes of the options have to
+  /// stay alive until the pipelines are ready.
+  ///
+  /// @param options  Pipelines to compile.
+  /// @param fallback  Pipeline returned by AsyncPipeline::Get until the
+  /// compilation is done, e.g. a simpler variant compiled beforehand.
+  ///
+  /// @return AsyncPipeline per options entry.
+  std::vector<AsyncPipeline> CreateGraphicsPipelinesAsync(
+      const std::vector<GraphicsPipelineOptions> &options,
+      VkPipeline fallback = VK_NULL_HANDLE);
+
+  /// Compiles a graphics pipeline from loaded shaders on the pipeline
+  /// threads.
+  ///
+  /// When a shader is reloaded, BeginFrame starts compiling the new
+  /// pipeline in the background and swaps it in at the first frame it is
+  /// ready. The old pipeline is destroyed once the frames in flight are done
+  /// with it. A compile error keeps the old pipeline.
+  ReloadablePipeline
+  CreateReloadablePipeline(const ReloadablePipelineOptions &options);
+
+  /// Returns the current pipeline, VK_NULL_HANDLE until the first one is
+  /// compiled. Valid until the next BeginFrame.
+  VkPipeline GetPipeline(ReloadablePipeline pipeline) const {
+    return reloadablePipelines_.at(pipeline.index).current.Get();
+  }
+
+  /// Creates a compute pipeline.
+  ///
+  /// Thread-safe, pipelines are compiled against the shared pipeline cache.
+  /// Compute pipelines are dispatched by RecordCommandBuffer before the
+  /// render pass.
+  PipelineHandle CreateComputePipeline(const ComputePipelineOptions &options);
 
   /// Creates a command pool.
   ///
@@ -279,25 +918,94 @@ public:
   /// multiple threads. That includes use via recording commands on any command
   /// buffers allocated from the pool, as well as operations that allocate,
   /// free, and reset command buffers or the pool itself.
-  VkCommandPool CreateCommandPool(const CommandPoolOptions &options);
+  CommandPoolHandle CreateCommandPool(const CommandPoolOptions &options);
+
+  /// Returns the Vulkan command pool, VK_NULL_HANDLE if the handle is stale.
+  VkCommandPool GetCommandPool(CommandPoolHandle commandPool) const {
+    return GetVulkanHandle(commandPools_, commandPool);
+  }
 
   /// Creates command buffers from the command pool.
   VkCommandBuffer CreateCommandBuffer(const CommandBufferOptions &options);
 
   /// Creates a vertex buffer.
   ///
-  /// Uses staging buffer to upload the data from the vertex array.
-  VkBuffer CreateVertexBuffer(const VertexBufferOptions &options);
+  /// Uses staging ring to upload the data from the vertex array. The upload is
+  /// submitted with the next frame or FlushUploads call.
+  ///
+  /// @return Handle of the buffer, GetBuffer returns the Vulkan buffer.
+  BufferHandle CreateVertexBuffer(const VertexBufferOptions &options);
 
   /// Creates a index buffer.
   ///
-  /// Uses staging buffer to upload the data from the index array.
-  VkBuffer CreateIndexBuffer(const IndexBufferOptions &options);
+  /// Uses staging ring to upload the data from the index array. The upload is
+  /// submitted with the next frame or FlushUploads call.
+  BufferHandle CreateIndexBuffer(const IndexBufferOptions &options);
+
+  /// Creates an instance buffer.
+  ///
+  /// Uses staging ring to upload the data from the instance array. The upload
+  /// is submitted with the next frame or FlushUploads call.
+  BufferHandle CreateInstanceBuffer(const InstanceBufferOptions &options);
+
+  /// Creates an indirect buffer of VkDrawIndexedIndirectCommand records.
+  ///
+  /// Uses staging ring to upload the commands. The upload is submitted with
+  /// the next frame or FlushUploads call.
+  BufferHandle CreateIndirectBuffer(const IndirectBufferOptions &options);
+
+  /// Creates a device local storage buffer, e.g. for compute shaders.
+  ///
+  /// Uses staging ring to upload the initial data. The upload is submitted
+  /// with the next frame or FlushUploads call.
+  BufferHandle CreateStorageBuffer(const StorageBufferOptions &options);
+
+  /// Packs all meshes into one vertex and one index buffer.
+  ///
+  /// @return Shared buffers and the range of every mesh in them.
+  MeshBuffer CreateMeshBuffer(const MeshBufferOptions &options);
+
+  /// Submits the pending uploads of the staging ring without waiting.
+  void FlushUploads() { stagingRing_.Flush(); }
 
   /// Creates an uniform buffer with mapped memory.
-  VkBuffer CreateUniformBuffer();
+  BufferHandle CreateUniformBuffer();
+
+  /// Returns the Vulkan buffer, VK_NULL_HANDLE if the handle is stale.
+  VkBuffer GetBuffer(BufferHandle buffer) const {
+    const auto vkBuffer = buffers_.Get<kBufferField>(buffer);
+    return vkBuffer != nullptr ? *vkBuffer : VK_NULL_HANDLE;
+  }
+
+  /// Returns the buffer size, 0 if the handle is stale.
+  VkDeviceSize GetBufferSize(BufferHandle buffer) const {
+    const auto size = buffers_.Get<kBufferSizeField>(buffer);
+    return size != nullptr ? *size : 0;
+  }
 
-  VkDescriptorPool CreateDescriptorPool(const DescriptorPoolOptions &options);
+  /// Copies uniform data into the uniform ring slice of the current frame.
+  ///
+  /// The data stays valid until the frame slot is reused, call it between
+  /// BeginFrame and EndFrame.
+  ///
+  /// @return Dynamic offset of the data in the uniform ring buffer.
+  template <typename T> std::uint32_t PushUniformData(const T &data) {
+    return uniformRing_.Push(data);
+  }
+
+  /// Returns the uniform ring buffer to be bound to UNIFORM_BUFFER_DYNAMIC
+  /// descriptors.
+  VkBuffer GetUniformRingBuffer() const { return uniformRing_.GetBuffer(); }
+
+  DescriptorPoolHandle
+  CreateDescriptorPool(const DescriptorPoolOptions &options);
+
+  /// Returns the Vulkan descriptor pool, VK_NULL_HANDLE if the handle is
+  /// stale.
+  VkDescriptorPool
+  GetDescriptorPool(DescriptorPoolHandle descriptorPool) const {
+    return GetVulkanHandle(descriptorPools_, descriptorPool);
+  }
 
   /// Creates descriptor sets from the descriptor pool.
   ///
@@ -305,10 +1013,24 @@ public:
   /// descriptors.
   VkDescriptorSet CreateDescriptorSet(const DescriptorSetOptions &options);
 
+  /// Creates one descriptor set per frame in flight from the descriptor pool.
+  ///
+  /// Every frame context returns the set of its slot, which the GPU no
+  /// longer reads while the frame is recorded, so it can be updated then.
+  ///
+  /// @return Descriptor sets in frame slot order.
+  std::vector<VkDescriptorSet>
+  CreateFrameDescriptorSets(const DescriptorSetOptions &options);
+
   void UpdateDescriptorSet(const UpdateDescriptorSetOptions &options);
 
   /// Writes the commands to be executed into the command buffer.
   ///
+  /// A draw list is split into disjoint slices if there are recording
+  /// threads. Each thread records its slice into a secondary command buffer
+  /// from its own command pool of the current frame, the primary command
+  /// buffer executes them inside the render pass.
+  ///
   /// @param commandBuffer  Command buffer.
   /// @param imageIndex  Image (framebuffer) index to use in the render pass.
   void RecordCommandBuffer(const RecordCommandBufferOptions &options);
@@ -316,6 +1038,9 @@ public:
   void UpdateUniformBuffer(const UpdateUniformBufferOptions &options);
 
   /// Begins a new frame.
+  ///
+  /// Waits for the frame fence, resets the command pools of the frame and
+  /// returns its frame context together with a command buffer from them.
   BeginFrameInfo BeginFrame(const BeginFrameOptions &options);
 
   /// Ends the current frame.
@@ -323,15 +1048,187 @@ public:
 
   /// @}
 
+  /// @name Resource Destruction
+  /// @{
+
+  /// Destroys a vertex, index, instance, indirect or uniform buffer.
+  ///
+  /// The destruction is deferred until the frames in flight that may use the
+  /// buffer have completed, nothing waits for the device. The buffer must not
+  /// be recorded into later frames.
+  void DestroyBuffer(BufferHandle buffer);
+
+  /// Destroys the vertex and index buffers of the mesh buffer, deferred.
+  void DestroyMeshBuffer(const MeshBuffer &meshBuffer);
+
+  /// Destroys a graphics pipeline, deferred. A pipeline that is still
+  /// compiling has to be waited for first.
+  void DestroyPipeline(PipelineHandle pipeline);
+
+  /// Destroys a descriptor pool together with the descriptor sets allocated
+  /// from it, deferred.
+  void DestroyDescriptorPool(DescriptorPoolHandle descriptorPool);
+
+  /// @}
+
+  /// @name Render Graph
+  /// @{
+
+  /// Returns the render graph of the context, it is executed by the
+  /// application into the frame command buffer between BeginFrame and
+  /// EndFrame. Import the frame image with GetFrameImageLayout() as final
+  /// layout and replace it with SetImportedImage every frame.
+  RenderGraph &GetRenderGraph() { return renderGraph_; }
+
+  /// Compiles the declared render graph. The resources of the previous
+  /// compile are destroyed once the frames in flight have completed.
+  void CompileRenderGraph();
+
+  /// Records the frame command buffer by executing the compiled render
+  /// graph, instead of RecordCommandBuffer. The graph ends with a barrier to
+  /// BOTTOM_OF_PIPE, so the offscreen readback is not recorded.
+  void RecordRenderGraph(VkCommandBuffer commandBuffer);
+
+  /// Records the draws of the options into a render pass instance of the
+  /// application, e.g. a graphics pass of the render graph. The compute
+  /// dispatches and the recording threads are not used.
+  void RecordDraws(const RecordCommandBufferOptions &options);
+
+  /// Returns the swapchain or offscreen image of the current frame, valid
+  /// between BeginFrame and EndFrame.
+  VkImage GetFrameImage() const {
+    return swapChainImages_[currentSwapchainImageIndex_];
+  }
+  VkImageView GetFrameImageView() const {
+    return swapChainImageViews_[currentSwapchainImageIndex_];
+  }
+
+  /// Returns the layout EndFrame expects the frame image in, TRANSFER_SRC
+  /// for the offscreen readback and PRESENT_SRC_KHR otherwise.
+  VkImageLayout GetFrameImageLayout() const {
+    return offscreen_ ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                      : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  }
+
+  /// @}
+
   VkFormat GetSwapChainImageFormat() { return swapChainImageFormat_; }
 
+  /// Returns the depth format for RenderPassOptions::depthFormat, the first
+  /// of D32_SFLOAT, D32_SFLOAT_S8_UINT and D24_UNORM_S8_UINT the device
+  /// supports as a depth attachment.
+  VkFormat GetDepthFormat() const { return depthFormat_; }
+
   VkExtent2D GetSwapChainExtent() { return swapChainExtent_; }
 
+  /// Returns nullptr in offscreen mode.
   GLFWwindow *GetWindow() { return window_; }
 
+  bool IsOffscreen() const { return offscreen_; }
+
+  std::uint32_t GetFramesInFlight() const { return framesInFlight_; }
+
+  /// Returns the readback of the offscreen frame that completed last.
+  ///
+  /// The frame is GetFramesInFlight() frames old and its data stays valid until
+  /// the next EndFrame. Call it between BeginFrame and EndFrame.
+  OffscreenReadback GetOffscreenReadback() const;
+
+  PipelineCacheStats GetPipelineCacheStats() const {
+    return pipelineCache_.GetStats();
+  }
+
+  /// Begins a GPU profiler scope in the frame command buffer.
+  ///
+  /// RecordCommandBuffer measures the whole render pass as "RenderPass" scope
+  /// and the draws as "Draws" scope. Scopes recorded before it resets the
+  /// queries of the frame are not measured.
+  void BeginGpuScope(VkCommandBuffer commandBuffer, const char *name) {
+    gpuProfiler_.BeginScope(commandBuffer, name);
+  }
+
+  void EndGpuScope(VkCommandBuffer commandBuffer) {
+    gpuProfiler_.EndScope(commandBuffer);
+  }
+
+  /// Returns per-scope GPU timings of the latest completed frame, it is
+  /// GetFramesInFlight() frames old. Empty without gpuProfiling.
+  const std::vector<GpuScopeTiming> &GetGpuTimings() const {
+    return gpuProfiler_.GetResults();
+  }
+
+  /// Returns the CPU frame phase timings of the latest frames.
+  ///
+  /// Lock-free, e.g. a metrics thread can take reports while frames are
+  /// rendered.
+  const FrameStats &GetFrameStats() const { return frameStats_; }
+
+  const DrawIndirectSupport &GetDrawIndirectSupport() const {
+    return drawIndirectSupport_;
+  }
+
+  /// Returns true if ContextOptions::bindless is set and the device supports
+  /// partially bound, update-after-bind descriptor arrays.
+  bool IsBindlessEnabled() const { return bindlessEnabled_; }
+
+  /// Returns the layout of the bindless set, kBindlessSet of the pipeline
+  /// layouts. Shaders declare the arrays of BindlessBinding:
+  ///
+  ///   layout(set = 1, binding = 0) readonly buffer B { ... } buffers[];
+  ///   layout(set = 1, binding = 1) uniform sampler2D textures[];
+  VkDescriptorSetLayout GetBindlessSetLayout() const {
+    return bindlessTable_.GetDescriptorSetLayout();
+  }
+
+  /// Adds the whole buffer to the bindless storage buffer array, the buffer
+  /// needs STORAGE_BUFFER usage.
+  ///
+  /// @return Index of the buffer in the array.
+  std::uint32_t AddBindlessStorageBuffer(BufferHandle buffer);
+
+  /// Adds the combined image sampler to the bindless texture array.
+  ///
+  /// @return Index of the texture in the array.
+  std::uint32_t AddBindlessTexture(VkImageView imageView, VkSampler sampler);
+
+  /// Frees the array slots once the frames in flight have finished, before
+  /// the resources are destroyed. Throws if the slot is not added.
+  void RemoveBindlessStorageBuffer(std::uint32_t index);
+  void RemoveBindlessTexture(std::uint32_t index);
+
+  /// Returns true if frames and uploads signal timeline semaphores.
+  bool IsTimelineEnabled() const { return frameTimeline_.IsInitialized(); }
+
+  /// Frame values count the submitted frames: frame N, counted from 0,
+  /// reaches value N + 1 once it has completed on the GPU. A resource used by
+  /// the frame being recorded is free once GetSubmittedFrameValue() + 1 has
+  /// been reached.
+  ///
+  /// The counter is the frame timeline semaphore if it is enabled, otherwise
+  /// it is derived from the frame fences.
+  ///
+  /// @return Value of the latest submitted frame, 0 before the first one.
+  std::uint64_t GetSubmittedFrameValue() const { return frameNumber_; }
+
+  /// Returns the value of the latest completed frame, never blocks.
+  std::uint64_t GetCompletedFrameValue();
+
+  /// Blocks until the frame value has been reached, the frame has to be
+  /// submitted.
+  void WaitFrameValue(std::uint64_t value);
+
   void WaitIdle() { vkDeviceWaitIdle(device_); }
 
 private:
+  /// Returns the Vulkan object of a pool slot, VK_NULL_HANDLE if the handle
+  /// is stale.
+  template <typename Tag, typename T, typename... Fields>
+  static T GetVulkanHandle(const HandlePool<Tag, T, Fields...> &pool,
+                           Handle<Tag> handle) {
+    const auto object = pool.template Get<0>(handle);
+    return object != nullptr ? *object : VK_NULL_HANDLE;
+  }
+
   static void FramebufferResizeCallback(GLFWwindow *window, int width,
                                         int height) {
     auto app = reinterpret_cast<Context *>(glfwGetWindowUserPointer(window));
@@ -339,7 +1236,7 @@ private:
   }
 
   /// Initializes GLWF and creates a window.
-  void InitWindow();
+  void InitWindow(const ContextOptions &options);
 
   /// Checks if all of the requested layers are available.
   bool CheckValidationLayerSupport();
@@ -352,6 +1249,19 @@ private:
   /// @return True if the device is suitable, false otherwise.
   bool IsDeviceSuitable(VkPhysicalDevice device);
 
+  /// Rates a suitable device, higher is better.
+  ///
+  /// The device type dominates: discrete before integrated before virtual
+  /// GPUs. Devices of the same type are ranked by their largest device local
+  /// heap, then by dedicated transfer and compute queue families and by the
+  /// optional features: timeline semaphores, descriptor indexing and
+  /// drawIndirectCount.
+  std::uint64_t RateDevice(VkPhysicalDevice device);
+
+  /// Picks the pinned device of the options or the highest rated suitable
+  /// one, logs all of them.
+  VkPhysicalDevice PickPhysicalDevice(const ContextOptions &options);
+
   /// Check if all of the requested extensions are supported by the physical
   /// device.
   ///
@@ -360,6 +1270,26 @@ private:
   /// @return True if extensions are supported, false otherwise.
   bool CheckDeviceExtensionSupport(VkPhysicalDevice device);
 
+  /// Checks if an optional extension is supported by the physical device.
+  bool IsDeviceExtensionSupported(VkPhysicalDevice device,
+                                  const char *extensionName);
+
+  /// Checks the descriptor indexing features of the bindless set, requires
+  /// a Vulkan 1.1 instance and device.
+  ///
+  /// @param features  Supported descriptor indexing features.
+  bool IsBindlessSupported(
+      VkPhysicalDevice device,
+      VkPhysicalDeviceDescriptorIndexingFeaturesEXT &features);
+
+  /// Creates the bindless table with the array sizes clamped to the device
+  /// limits.
+  void CreateBindlessTable(const ContextOptions &options);
+
+  /// Checks the timeline semaphore feature, requires a Vulkan 1.1 instance
+  /// and VK_KHR_timeline_semaphore.
+  bool IsTimelineSupported(VkPhysicalDevice device);
+
   /// There are different types of queues that originate from different queue
   /// families and each family of queues allows only a subset of commands.
   /// Function checks which queue families are supported by the device and
@@ -372,6 +1302,33 @@ private:
   /// @return QueueFamilyIndices.
   QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device);
 
+  /// Creates the frame contexts and the recording threads.
+  void CreateFrameContexts(std::uint32_t threadCount);
+
+  /// Binds the pipeline, the descriptor set and sets the dynamic state.
+  void RecordPipelineState(VkCommandBuffer commandBuffer,
+                           const RecordCommandBufferOptions &options);
+
+  /// Records the draw described by the buffers of the options.
+  void RecordBufferDraws(const RecordCommandBufferOptions &options);
+
+  /// Records the indirect draws of the options.
+  void RecordIndirectDraws(const RecordCommandBufferOptions &options);
+
+  /// Records the compute dispatches of the options with their barriers.
+  void RecordComputeDispatches(const RecordCommandBufferOptions &options);
+
+  /// Records the pipeline state and the draw items into the command buffer.
+  void RecordDrawItems(VkCommandBuffer commandBuffer,
+                       const RecordCommandBufferOptions &options,
+                       const DrawItem *drawItems, std::uint32_t drawItemCount);
+
+  /// Records the draw list into secondary command buffers in parallel.
+  ///
+  /// @return Number of recorded secondary command buffers.
+  std::uint32_t
+  RecordSecondaryCommandBuffers(const RecordCommandBufferOptions &options);
+
   /// Creates a swapchain.
   ///
   /// A swapchain object provides the ability to present rendering results to a
@@ -389,7 +1346,34 @@ private:
   /// image is returned by vkAcquireNextImageKHR, and before it is released by
   /// vkQueuePresentKHR. This includes transitioning the image layout and
   /// rendering commands.
-  void CreateSwapChain();
+  ///
+  /// @param oldSwapChain  Swapchain being replaced, it is retired by the
+  /// creation and its resources can be reused by the new one.
+  void CreateSwapChain(VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE);
+
+  /// Creates the offscreen images replacing the swapchain images, one per
+  /// frame in flight, and their readback buffers.
+  void CreateOffscreenTargets(const ContextOptions &options);
+
+  /// Copies the offscreen image of the current frame into its readback
+  /// buffer.
+  void RecordReadback(VkCommandBuffer commandBuffer);
+
+  /// Applies the reloaded shaders: starts compiling the pipelines using them
+  /// and swaps in the pipelines that are ready.
+  void ReloadPipelines();
+
+  /// Allocates and binds device local memory of an optimal tiling image.
+  Allocation AllocateImageMemory(VkImage image);
+
+  /// Finds the depth format, see GetDepthFormat.
+  VkFormat FindDepthFormat() const;
+
+  /// Creates the depth image of the swapchain extent shared by the frames.
+  ///
+  /// A single image suffices: the render pass dependency orders the depth
+  /// writes of a frame after the ones of the previous frame.
+  void CreateDepthTarget();
 
   /// Queries details of swap chain support.
   ///
@@ -439,6 +1423,8 @@ private:
   ///   the existence of three buffers alone does not necessarily mean that the
   ///   framerate is unlocked.
   ///
+  /// The first available mode of ContextOptions::presentModes is choosen.
+  ///
   /// @param availablePresentModes  Available present modes.
   ///
   /// @return Choosen present mode.
@@ -454,31 +1440,44 @@ private:
   /// @return Choosen swap extent.
   VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities);
 
-  /// Finds suitable memory type.
-  std::uint32_t FindMemoryType(std::uint32_t typeFilter,
-                               VkMemoryPropertyFlags properties);
-
   /// Creates a Vulkan buffer.
   ///
+  /// The buffer memory is sub-allocated from the memory allocator blocks.
+  ///
   /// @param size  Buffer size.
   /// @param usage  Buffer usage.
   /// @param properties  Memory properties.
   /// @param buffer  Created buffer.
-  /// @param bufferMemory  Allocated memory.
+  /// @param allocation  Memory sub-range bound to the buffer.
   void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
                     VkMemoryPropertyFlags properties, VkBuffer &buffer,
-                    VkDeviceMemory &bufferMemory);
+                    Allocation &allocation);
+
+  /// Creates a tracked device local buffer that is filled by uploads.
+  BufferHandle CreateDeviceBuffer(VkDeviceSize size, VkBufferUsageFlags usage);
+
+  /// Creates an untracked image view, e.g. of a swapchain image.
+  VkImageView CreateVkImageView(const ImageViewOptions &options);
 
-  /// Copies data from one Vulkan buffer to another one.
-  void CopyBuffer(VkCommandPool commandPool, VkBuffer srcBuffer,
-                  VkBuffer dstBuffer, VkDeviceSize size);
+  /// Creates an untracked framebuffer, e.g. of a swapchain image.
+  VkFramebuffer CreateVkFramebuffer(const FrameBufferOptions &options);
 
   /// Creates the synchronization objects.
   void CreateSyncObjects();
 
   void CleanupSwapChain();
 
-  void RecreateSwapChain(VkRenderPass renderPass);
+  /// Replaces the swapchain without waiting for the device.
+  ///
+  /// The old swapchain, its image views and framebuffers are retired and
+  /// destroyed once the fences of all frames that may use them have signaled.
+  ///
+  /// @return False if the window is minimized, the recreation is postponed.
+  bool RecreateSwapChain(RenderPassHandle renderPass);
+
+  /// Adds the time since start to the phase of the current frame.
+  void AddFrameTime(FramePhase phase,
+                    std::chrono::steady_clock::time_point start);
 
   /// Window resources.
   std::uint32_t width_{1600U};
@@ -496,6 +1495,35 @@ private:
   VkDevice device_{VK_NULL_HANDLE};
   VkQueue graphicsQueue_{VK_NULL_HANDLE};
   VkQueue presentQueue_{VK_NULL_HANDLE};
+  /// Queue of the uploads, the graphics queue if there is no transfer family.
+  VkQueue transferQueue_{VK_NULL_HANDLE};
+  /// Optional device capabilities.
+  DrawIndirectSupport drawIndirectSupport_{};
+  /// Vulkan version of the instance, 1.1 where the loader supports it.
+  std::uint32_t apiVersion_{VK_API_VERSION_1_0};
+  bool bindlessEnabled_{false};
+  BindlessTable bindlessTable_{};
+  PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount_{nullptr};
+  /// Loaded if timeline semaphores are enabled.
+  TimelineFunctions timelineFunctions_{};
+
+  /// Device memory allocator.
+  MemoryAllocator allocator_{};
+  /// Staging ring for buffer uploads.
+  StagingRing stagingRing_{};
+  /// Pipeline cache used for all pipelines.
+  PipelineCache pipelineCache_{};
+  /// Per-frame uniform data.
+  UniformRing uniformRing_{};
+  /// Passes recorded by the application, see GetRenderGraph.
+  RenderGraph renderGraph_{};
+  /// GPU timings of the frames.
+  GpuProfiler gpuProfiler_{};
+  /// CPU timings of the frames, the current frame is pushed by the next
+  /// BeginFrame.
+  FrameStats frameStats_{};
+  FrameTiming frameTiming_{};
+  std::optional<std::chrono::steady_clock::time_point> frameStart_{};
 
   /// Swapchain resources.
   VkSwapchainKHR swapChain_{VK_NULL_HANDLE};
@@ -505,56 +1533,108 @@ private:
   std::vector<VkImageView> swapChainImageViews_{};
   std::vector<VkFramebuffer> swapChainFramebuffers_{};
   std::uint32_t currentSwapchainImageIndex_{};
-
-  /// Image view resources.
-  std::vector<VkImageView> imageViews_{};
-
-  /// Shader module resources.
-  std::vector<VkShaderModule> shaderModules_{};
-
-  /// Render pass resources.
-  std::vector<VkRenderPass> renderPasses_{};
-
-  /// Framebuffer resources.
-  std::vector<VkFramebuffer> framebuffers_{};
-
-  /// Pipeline layout resources.
-  std::vector<VkPipelineLayout> pipelineLayouts_;
-
-  /// Descriptor set layout resources.
-  std::vector<VkDescriptorSetLayout> descriptorSetLayouts_{};
-
-  /// Graphics pipeline resources.
-  std::vector<VkPipeline> pipelines_;
+  /// Set if the recreation has been postponed while minimized.
+  bool swapChainOutOfDate_{false};
+  /// Preferred present modes and requested image count, 0 is the default.
+  std::vector<VkPresentModeKHR> presentModes_{};
+  std::uint32_t swapchainImageCount_{};
+  /// Depth target of the render passes with a depth attachment, created
+  /// with their swapchain framebuffers.
+  VkFormat depthFormat_{VK_FORMAT_UNDEFINED};
+  VkImage depthImage_{VK_NULL_HANDLE};
+  VkImageView depthImageView_{VK_NULL_HANDLE};
+  Allocation depthImageAllocation_{};
+  /// Offscreen mode resources, the images are the swapchain images.
+  bool offscreen_{false};
+  std::vector<Allocation> offscreenImageAllocations_{};
+  std::vector<VkBuffer> readbackBuffers_{};
+  std::vector<Allocation> readbackAllocations_{};
+  /// Frame slots with a readback in flight.
+  std::vector<bool> readbackPending_{};
+  /// Frame slot whose readback completed last.
+  std::optional<std::uint32_t> latestReadback_{};
+
+  /// Image views created by the application, the swapchain owns its own.
+  HandlePool<ImageViewTag, VkImageView> imageViews_{};
+
+  /// Shader modules, deduplicated by their SPIR-V.
+  ShaderLibrary shaderLibrary_{};
+
+  /// Render passes and the format of their depth attachment, UNDEFINED
+  /// without one.
+  static constexpr std::size_t kRenderPassDepthFormatField{1};
+  HandlePool<RenderPassTag, VkRenderPass, VkFormat> renderPasses_{};
+
+  /// Framebuffers created by the application, the swapchain owns its own.
+  HandlePool<FramebufferTag, VkFramebuffer> framebuffers_{};
+
+  HandlePool<PipelineLayoutTag, VkPipelineLayout> pipelineLayouts_{};
+
+  HandlePool<DescriptorSetLayoutTag, VkDescriptorSetLayout>
+      descriptorSetLayouts_{};
+
+  /// Graphics and compute pipelines, guarded by the mutex as pipelines are
+  /// created on the pipeline threads too.
+  HandlePool<PipelineTag, VkPipeline> pipelines_{};
+  mutable std::mutex pipelinesMutex_{};
+
+  struct ReloadablePipelineState final {
+    ReloadablePipelineOptions options{};
+    AsyncPipeline current{};
+    /// Pipeline compiled for the reloaded shaders.
+    AsyncPipeline pending{};
+    /// A shader has been reloaded again while pending was compiling.
+    bool outdated{false};
+  };
+  std::vector<ReloadablePipelineState> reloadablePipelines_{};
+  ThreadPool pipelineThreads_{};
 
   /// Command pool resources.
-  std::vector<VkCommandPool> commandPools_{};
+  HandlePool<CommandPoolTag, VkCommandPool> commandPools_{};
 
   /// Command buffer resources.
   std::vector<VkCommandBuffer> commandBuffers_{};
 
-  /// Vertex buffer resources.
-  std::vector<VkBuffer> vertexBuffers_{};
-  std::vector<VkDeviceMemory> vertexBufferMemories_{};
-  /// Index buffer resources.
-  std::vector<VkBuffer> indexBuffers_{};
-  std::vector<VkDeviceMemory> indexBufferMemories_{};
-  /// Uniform buffer resources.
-  std::vector<VkBuffer> uniformBuffers_{};
-  std::vector<VkDeviceMemory> uniformBufferMemories_{};
-  std::vector<void *> uniformBufferMappedMemories_{};
+  /// Command recording resources per frame in flight.
+  std::vector<FrameContext> frames_{};
+  /// Parallel recording resources.
+  ThreadPool recordingThreads_{};
+  std::uint32_t recordingThreadCount_{0};
+
+  /// Vertex, index, instance, indirect and uniform buffers: the buffer, its
+  /// size, its mapped memory (nullptr unless host visible) and allocation.
+  static constexpr std::size_t kBufferField{0};
+  static constexpr std::size_t kBufferSizeField{1};
+  static constexpr std::size_t kBufferMappedField{2};
+  static constexpr std::size_t kBufferAllocationField{3};
+  HandlePool<BufferTag, VkBuffer, VkDeviceSize, void *, Allocation> buffers_{};
 
   /// Descriptor pool resources.
-  std::vector<VkDescriptorPool> descriptorPools_{};
+  HandlePool<DescriptorPoolTag, VkDescriptorPool> descriptorPools_{};
 
   /// Descriptor set resources.
   std::vector<VkDescriptorSet> descriptorSets_{};
 
+  std::uint32_t framesInFlight_{2};
   std::uint32_t currentFrame_{0};
+  /// Number of the current frame, counts all frames ended so far.
+  std::uint64_t frameNumber_{0};
+  /// Resources destroyed once the frames that may use them have completed.
+  DeletionQueue deletionQueue_{};
 
   std::vector<VkSemaphore> imageAvailableSemaphores_{};
+  /// One per swapchain image: the presentation of an image may still wait on
+  /// it after the fence of its frame has signaled.
   std::vector<VkSemaphore> renderFinishedSemaphores_{};
+  /// Frame pacing either by the frame timeline, with the value each frame
+  /// slot has signaled last, or by one fence per frame slot.
+  Timeline frameTimeline_{};
+  std::vector<std::uint64_t> frameTimelineValues_{};
   std::vector<VkFence> inFlightFences_{};
+  /// Latest completed frame value known from the fences.
+  std::uint64_t completedFrameValue_{0};
+  /// Upload ownership acquires submitted with each frame in flight.
+  std::vector<StagingRing::UploadAcquire> frameUploadAcquires_{};
   bool framebufferResized_{false};
 };
 
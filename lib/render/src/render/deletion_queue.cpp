@@ -0,0 +1,25 @@
+#include "render/deletion_queue.hpp"
+
+#include <utility>
+
+namespace render {
+
+void DeletionQueue::Cleanup() {
+  Flush(~0ULL);
+}
+
+void DeletionQueue::Push(std::uint64_t lastFrame,
+                         std::function<void()> deleter) {
+  entries_.push_back(Entry{lastFrame, std::move(deleter)});
+}
+
+void DeletionQueue::Flush(std::uint64_t completedFrame) {
+  while (!entries_.empty() && entries_.front().lastFrame <= completedFrame) {
+    // The deleter may queue further deleters:
+    auto deleter = std::move(entries_.front().deleter);
+    entries_.pop_front();
+    deleter();
+  }
+}
+
+} // namespace render
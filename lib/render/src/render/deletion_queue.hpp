@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+namespace render {
+
+/// Deferred destruction of resources the GPU may still use.
+///
+/// Every deleter is queued with the number of the last frame that may use
+/// its resources and runs once that frame has completed, i.e. once the frame
+/// timeline has reached its value or the fence of its frame slot has been
+/// waited. Frame numbers only grow, so the queue is kept in frame order and
+/// flushing never searches.
+class DeletionQueue final {
+public:
+  /// Runs all pending deleters, the device has to be idle.
+  void Cleanup();
+
+  /// Queues a deleter.
+  ///
+  /// @param lastFrame  Number of the last frame that may use the resources.
+  /// @param deleter  Destroys the resources.
+  void Push(std::uint64_t lastFrame, std::function<void()> deleter);
+
+  /// Runs the deleters of all frames up to the completed frame.
+  void Flush(std::uint64_t completedFrame);
+
+  std::size_t GetPendingCount() const { return entries_.size(); }
+
+private:
+  struct Entry final {
+    std::uint64_t lastFrame{};
+    std::function<void()> deleter{};
+  };
+
+  std::deque<Entry> entries_{};
+};
+
+} // namespace render
@@ -0,0 +1,85 @@
+#include "render/frame_context.hpp"
+
+#include <stdexcept>
+
+namespace render {
+
+namespace {
+
+VkCommandPool CreateTransientCommandPool(VkDevice device,
+                                         std::uint32_t queueFamilyIndex) {
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = queueFamilyIndex;
+  VkCommandPool commandPool{VK_NULL_HANDLE};
+  if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create frame command pool!");
+  }
+  return commandPool;
+}
+
+VkCommandBuffer AllocateCommandBuffer(VkDevice device,
+                                      VkCommandPool commandPool,
+                                      VkCommandBufferLevel level) {
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.commandPool = commandPool;
+  allocInfo.level = level;
+  allocInfo.commandBufferCount = 1;
+  VkCommandBuffer commandBuffer{VK_NULL_HANDLE};
+  if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate frame command buffer!");
+  }
+  return commandBuffer;
+}
+
+} // namespace
+
+void FrameContext::Initialize(const FrameContextOptions &options) {
+  device_ = options.device;
+  index_ = options.index;
+  uniformRing_ = options.uniformRing;
+  commandPool_ = CreateTransientCommandPool(device_, options.queueFamilyIndex);
+  for (std::uint32_t i{0}; i < options.threadCount; ++i) {
+    const auto commandPool =
+        CreateTransientCommandPool(device_, options.queueFamilyIndex);
+    secondaryCommandPools_.push_back(commandPool);
+    secondaryCommandBuffers_.push_back(AllocateCommandBuffer(
+        device_, commandPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY));
+  }
+}
+
+void FrameContext::Cleanup() {
+  for (const auto &commandPool : secondaryCommandPools_) {
+    vkDestroyCommandPool(device_, commandPool, nullptr);
+  }
+  secondaryCommandPools_.clear();
+  secondaryCommandBuffers_.clear();
+
+  vkDestroyCommandPool(device_, commandPool_, nullptr);
+  commandPool_ = VK_NULL_HANDLE;
+  commandBuffers_.clear();
+  usedCount_ = 0;
+  descriptorSet_ = VK_NULL_HANDLE;
+}
+
+void FrameContext::Reset() {
+  vkResetCommandPool(device_, commandPool_, 0);
+  for (const auto &commandPool : secondaryCommandPools_) {
+    vkResetCommandPool(device_, commandPool, 0);
+  }
+  usedCount_ = 0;
+}
+
+VkCommandBuffer FrameContext::AcquireCommandBuffer() {
+  if (usedCount_ == commandBuffers_.size()) {
+    commandBuffers_.push_back(AllocateCommandBuffer(
+        device_, commandPool_, VK_COMMAND_BUFFER_LEVEL_PRIMARY));
+  }
+  return commandBuffers_[usedCount_++];
+}
+
+} // namespace render
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "render/uniform_ring.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace render {
+
+struct FrameContextOptions final {
+  VkDevice device{VK_NULL_HANDLE};
+  /// Queue family the command buffers are submitted to.
+  std::uint32_t queueFamilyIndex{};
+  /// Number of recording threads, each gets a secondary command buffer.
+  std::uint32_t threadCount{};
+  /// Frame slot in [0, frames in flight).
+  std::uint32_t index{};
+  /// Uniform ring the frame pushes its uniform data into.
+  UniformRing *uniformRing{nullptr};
+};
+
+/// Resources of a single frame in flight.
+///
+/// Context::BeginFrame returns the frame context once the GPU has finished
+/// the previous submission of its slot, so everything it hands out is free to
+/// be written until EndFrame: command buffers, the uniform ring slice and the
+/// per-frame descriptor set.
+///
+/// All command buffers of the frame come from transient pools that are reset
+/// as a whole with vkResetCommandPool once the frame fence is signaled, which
+/// is cheaper than resetting every command buffer separately. Primary command
+/// buffers are reused from a free list, so after the first frames nothing is
+/// allocated anymore.
+///
+/// Command pools are externally synchronized: every recording thread has a
+/// pool of its own for its secondary command buffer.
+class FrameContext final {
+public:
+  /// Creates the command pools.
+  void Initialize(const FrameContextOptions &options);
+
+  /// Destroys the command pools and all of their command buffers.
+  void Cleanup();
+
+  /// Resets all command pools of the frame.
+  ///
+  /// Must be called only after the GPU has finished the previous submission
+  /// of the frame.
+  void Reset();
+
+  /// Returns an initial state primary command buffer, valid until Reset.
+  VkCommandBuffer AcquireCommandBuffer();
+
+  /// Copies uniform data into the uniform ring slice of the frame.
+  ///
+  /// @return Dynamic offset of the data in the uniform ring buffer.
+  template <typename T> std::uint32_t PushUniformData(const T &data) {
+    return uniformRing_->Push(data);
+  }
+
+  /// Reserves uniform ring space of the frame, written in place until
+  /// EndFrame.
+  UniformAllocation AllocateUniformData(VkDeviceSize size) {
+    return uniformRing_->Allocate(size);
+  }
+
+  /// Frame slot, e.g. to index per-frame resources of the application.
+  std::uint32_t GetIndex() const { return index_; }
+
+  /// Returns the descriptor set of the slot created with
+  /// Context::CreateFrameDescriptorSets, VK_NULL_HANDLE if there is none.
+  VkDescriptorSet GetDescriptorSet() const { return descriptorSet_; }
+
+  void SetDescriptorSet(VkDescriptorSet descriptorSet) {
+    descriptorSet_ = descriptorSet;
+  }
+
+  /// Returns the secondary command buffers, one per recording thread.
+  const std::vector<VkCommandBuffer> &GetSecondaryCommandBuffers() const {
+    return secondaryCommandBuffers_;
+  }
+
+private:
+  VkDevice device_{VK_NULL_HANDLE};
+  std::uint32_t index_{};
+  UniformRing *uniformRing_{nullptr};
+  VkDescriptorSet descriptorSet_{VK_NULL_HANDLE};
+  VkCommandPool commandPool_{VK_NULL_HANDLE};
+  /// Primary command buffers allocated so far, the first usedCount_ of them
+  /// are handed out since the last reset.
+  std::vector<VkCommandBuffer> commandBuffers_{};
+  std::size_t usedCount_{};
+
+  std::vector<VkCommandPool> secondaryCommandPools_{};
+  std::vector<VkCommandBuffer> secondaryCommandBuffers_{};
+};
+
+} // namespace render
@@ -0,0 +1,178 @@
+#include "render/frame_stats.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace render {
+
+namespace {
+
+/// Part of the frame time a wait has to take to limit the frame.
+constexpr float kBoundFraction{0.2f};
+
+std::uint32_t ToMicroseconds(float milliseconds) {
+  return static_cast<std::uint32_t>(
+      std::lround(std::max(milliseconds, 0.0f) * 1000.0f));
+}
+
+float ToMilliseconds(std::uint32_t microseconds) {
+  return static_cast<float>(microseconds) / 1000.0f;
+}
+
+/// Nearest-rank percentiles, sorts the values.
+FramePercentiles GetPercentiles(std::vector<float> &values) {
+  FramePercentiles percentiles{};
+  if (values.empty()) {
+    return percentiles;
+  }
+  std::sort(values.begin(), values.end());
+  const auto rank = [&values](float percentile) {
+    const auto index = static_cast<std::size_t>(
+        std::ceil(percentile * static_cast<float>(values.size())));
+    return values[std::clamp<std::size_t>(index, 1, values.size()) - 1];
+  };
+  percentiles.p50 = rank(0.50f);
+  percentiles.p95 = rank(0.95f);
+  percentiles.p99 = rank(0.99f);
+  return percentiles;
+}
+
+} // namespace
+
+const char *GetFramePhaseName(FramePhase phase) {
+  switch (phase) {
+  case FramePhase::FenceWait:
+    return "FenceWait";
+  case FramePhase::Acquire:
+    return "Acquire";
+  case FramePhase::Record:
+    return "Record";
+  case FramePhase::Submit:
+    return "Submit";
+  case FramePhase::Present:
+    return "Present";
+  case FramePhase::SwapchainRecreate:
+    return "SwapchainRecreate";
+  default:
+    return "Unknown";
+  }
+}
+
+void FrameStats::Initialize(const FrameStatsOptions &options) {
+  slots_ = std::vector<Slot>(std::max<std::uint32_t>(options.capacity, 1));
+  head_.store(0, std::memory_order_relaxed);
+}
+
+void FrameStats::Cleanup() {
+  slots_.clear();
+  head_.store(0, std::memory_order_relaxed);
+}
+
+void FrameStats::Push(const FrameTiming &timing) {
+  if (slots_.empty()) {
+    return;
+  }
+  const auto head = head_.load(std::memory_order_relaxed);
+  auto &slot = slots_[head % slots_.size()];
+  const auto sequence = slot.sequence.load(std::memory_order_relaxed);
+  slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  for (std::size_t i{0}; i < kFramePhaseCount; ++i) {
+    slot.values[i].store(ToMicroseconds(timing.phaseMilliseconds[i]),
+                         std::memory_order_relaxed);
+  }
+  slot.values[kFramePhaseCount].store(
+      ToMicroseconds(timing.frameMilliseconds), std::memory_order_relaxed);
+  slot.values[kFramePhaseCount + 1].store(
+      ToMicroseconds(timing.gpuMilliseconds), std::memory_order_relaxed);
+  slot.sequence.store(sequence + 2, std::memory_order_release);
+  head_.store(head + 1, std::memory_order_release);
+}
+
+std::vector<FrameTiming> FrameStats::Snapshot() const {
+  std::vector<FrameTiming> timings{};
+  if (slots_.empty()) {
+    return timings;
+  }
+  const auto head = head_.load(std::memory_order_acquire);
+  const auto count = std::min<std::uint64_t>(head, slots_.size());
+  timings.reserve(count);
+  for (auto position = head - count; position < head; ++position) {
+    const auto &slot = slots_[position % slots_.size()];
+    const auto sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence % 2 != 0) {
+      continue;
+    }
+    FrameTiming timing{};
+    for (std::size_t i{0}; i < kFramePhaseCount; ++i) {
+      timing.phaseMilliseconds[i] =
+          ToMilliseconds(slot.values[i].load(std::memory_order_relaxed));
+    }
+    timing.frameMilliseconds = ToMilliseconds(
+        slot.values[kFramePhaseCount].load(std::memory_order_relaxed));
+    timing.gpuMilliseconds = ToMilliseconds(
+        slot.values[kFramePhaseCount + 1].load(std::memory_order_relaxed));
+    // The producer has lapped the reader if the sequence has changed:
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+      timings.push_back(timing);
+    }
+  }
+  return timings;
+}
+
+FrameStatsReport FrameStats::Report() const {
+  const auto timings = Snapshot();
+  FrameStatsReport report{};
+  report.frameCount = timings.size();
+
+  std::vector<float> values(timings.size());
+  for (std::size_t i{0}; i < timings.size(); ++i) {
+    values[i] = timings[i].frameMilliseconds;
+  }
+  report.frameMilliseconds = GetPercentiles(values);
+  for (std::size_t i{0}; i < timings.size(); ++i) {
+    values[i] = timings[i].gpuMilliseconds;
+  }
+  report.gpuMilliseconds = GetPercentiles(values);
+  for (std::size_t phase{0}; phase < kFramePhaseCount; ++phase) {
+    for (std::size_t i{0}; i < timings.size(); ++i) {
+      values[i] = timings[i].phaseMilliseconds[phase];
+    }
+    report.phaseMilliseconds[phase] = GetPercentiles(values);
+  }
+
+  for (const auto &timing : timings) {
+    switch (Classify(timing)) {
+    case FrameBound::Cpu:
+      ++report.cpuBoundFrames;
+      break;
+    case FrameBound::Gpu:
+      ++report.gpuBoundFrames;
+      break;
+    case FrameBound::Present:
+      ++report.presentBoundFrames;
+      break;
+    }
+  }
+  return report;
+}
+
+FrameBound FrameStats::Classify(const FrameTiming &timing) {
+  const auto phase = [&timing](FramePhase framePhase) {
+    return timing.phaseMilliseconds[static_cast<std::size_t>(framePhase)];
+  };
+  const float gpuWait = phase(FramePhase::FenceWait);
+  const float presentWait =
+      phase(FramePhase::Acquire) + phase(FramePhase::Present);
+  const float threshold = kBoundFraction * timing.frameMilliseconds;
+  if (gpuWait > threshold && gpuWait >= presentWait) {
+    return FrameBound::Gpu;
+  }
+  if (presentWait > threshold) {
+    return FrameBound::Present;
+  }
+  return FrameBound::Cpu;
+}
+
+} // namespace render
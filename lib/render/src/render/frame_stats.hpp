@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace render {
+
+/// CPU phases of a frame measured by the Context.
+enum class FramePhase : std::uint32_t {
+  /// Waiting for the frame fence in BeginFrame, i.e. for the GPU.
+  FenceWait,
+  /// vkAcquireNextImageKHR in BeginFrame.
+  Acquire,
+  /// RecordCommandBuffer.
+  Record,
+  /// Upload flush and vkQueueSubmit in EndFrame.
+  Submit,
+  /// vkQueuePresentKHR in EndFrame.
+  Present,
+  /// Swapchain recreation in BeginFrame or EndFrame.
+  SwapchainRecreate,
+  Count
+};
+
+constexpr std::size_t kFramePhaseCount{
+    static_cast<std::size_t>(FramePhase::Count)};
+
+/// Returns the phase name.
+const char *GetFramePhaseName(FramePhase phase);
+
+/// What limited the frame rate of a frame.
+enum class FrameBound : std::uint32_t { Cpu, Gpu, Present };
+
+/// CPU timings of a single frame in milliseconds.
+struct FrameTiming final {
+  std::array<float, kFramePhaseCount> phaseMilliseconds{};
+  /// Time from BeginFrame to the next BeginFrame.
+  float frameMilliseconds{};
+  /// GPU time of the frame if the GPU profiler is enabled, it lags behind
+  /// by the frames in flight.
+  float gpuMilliseconds{};
+};
+
+struct FramePercentiles final {
+  float p50{};
+  float p95{};
+  float p99{};
+};
+
+struct FrameStatsReport final {
+  std::size_t frameCount{};
+  FramePercentiles frameMilliseconds{};
+  FramePercentiles gpuMilliseconds{};
+  std::array<FramePercentiles, kFramePhaseCount> phaseMilliseconds{};
+  std::size_t cpuBoundFrames{};
+  std::size_t gpuBoundFrames{};
+  std::size_t presentBoundFrames{};
+};
+
+struct FrameStatsOptions final {
+  /// Number of latest frames kept in the ring.
+  std::uint32_t capacity{1024};
+};
+
+/// Lock-free ring of the latest frame timings.
+///
+/// A single thread, the one driving the frames, pushes the timings. Any other
+/// thread can take a snapshot or a report at the same time without blocking
+/// the producer: every slot is guarded by a sequence number (a seqlock), and
+/// slots overwritten during the copy are skipped.
+///
+/// A frame is GPU-bound if waiting for the frame fence takes a noticeable
+/// part of it, present-bound if acquiring and presenting the image does, and
+/// CPU-bound otherwise.
+class FrameStats final {
+public:
+  /// Allocates the ring.
+  void Initialize(const FrameStatsOptions &options);
+
+  /// Releases the ring.
+  void Cleanup();
+
+  /// Adds the timing of a finished frame, producer thread only.
+  void Push(const FrameTiming &timing);
+
+  /// Copies the frames currently in the ring, oldest first.
+  std::vector<FrameTiming> Snapshot() const;
+
+  /// Computes percentiles and frame bound counts of the frames in the ring.
+  FrameStatsReport Report() const;
+
+  /// Classifies the frame.
+  static FrameBound Classify(const FrameTiming &timing);
+
+private:
+  /// Frame time plus the phase and GPU times, stored in microseconds.
+  static constexpr std::size_t kValueCount{kFramePhaseCount + 2};
+
+  struct Slot final {
+    /// Odd while the slot is written.
+    std::atomic<std::uint32_t> sequence{};
+    std::array<std::atomic<std::uint32_t>, kValueCount> values{};
+  };
+
+  std::vector<Slot> slots_{};
+  /// Number of frames pushed so far.
+  std::atomic<std::uint64_t> head_{};
+};
+
+} // namespace render
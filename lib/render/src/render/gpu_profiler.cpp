@@ -0,0 +1,193 @@
+#include "render/gpu_profiler.hpp"
+
+#include <iostream>
+#include <stdexcept>
+
+namespace render {
+
+namespace {
+
+constexpr VkQueryPipelineStatisticFlags kPipelineStatistics{
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT};
+
+} // namespace
+
+void GpuProfiler::Initialize(const GpuProfilerOptions &options) {
+  device_ = options.device;
+  maxScopes_ = options.maxScopes;
+  pipelineStatistics_ = options.pipelineStatistics;
+
+  // Timestamps are supported if the queue family has valid timestamp bits:
+  std::uint32_t queueFamilyCount{0};
+  vkGetPhysicalDeviceQueueFamilyProperties(options.physicalDevice,
+                                           &queueFamilyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(
+      options.physicalDevice, &queueFamilyCount, queueFamilies.data());
+  const auto validBits =
+      options.queueFamilyIndex < queueFamilyCount
+          ? queueFamilies[options.queueFamilyIndex].timestampValidBits
+          : 0;
+  if (validBits == 0 || maxScopes_ == 0) {
+    std::cout << "GPU profiler: Timestamps are not supported" << std::endl;
+    enabled_ = false;
+    return;
+  }
+  timestampMask_ = validBits >= 64 ? ~0ULL : (1ULL << validBits) - 1;
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(options.physicalDevice, &properties);
+  timestampPeriod_ = properties.limits.timestampPeriod;
+
+  frames_.resize(options.frameCount);
+  for (auto &frame : frames_) {
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = 2 * maxScopes_;
+    if (vkCreateQueryPool(device_, &poolInfo, nullptr, &frame.timestampPool) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create timestamp query pool!");
+    }
+    if (pipelineStatistics_) {
+      poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+      poolInfo.queryCount = maxScopes_;
+      poolInfo.pipelineStatistics = kPipelineStatistics;
+      if (vkCreateQueryPool(device_, &poolInfo, nullptr,
+                            &frame.statisticsPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create statistics query pool!");
+      }
+    }
+    frame.scopes.reserve(maxScopes_);
+  }
+  queryData_.resize(2 * maxScopes_);
+  enabled_ = true;
+  std::cout << "GPU profiler: Timestamp period is " << timestampPeriod_
+            << " ns, pipeline statistics " << pipelineStatistics_
+            << std::endl;
+}
+
+void GpuProfiler::Cleanup() {
+  for (auto &frame : frames_) {
+    vkDestroyQueryPool(device_, frame.timestampPool, nullptr);
+    if (frame.statisticsPool != VK_NULL_HANDLE) {
+      vkDestroyQueryPool(device_, frame.statisticsPool, nullptr);
+    }
+  }
+  frames_.clear();
+  results_.clear();
+  enabled_ = false;
+}
+
+void GpuProfiler::BeginFrame(std::uint32_t frameIndex) {
+  if (!enabled_) {
+    return;
+  }
+  currentFrame_ = frameIndex;
+  openScopes_.clear();
+  statisticsScope_ = kNoScope;
+  auto &frame = frames_[frameIndex];
+  if (frame.scopes.empty()) {
+    frame.reset = false;
+    return;
+  }
+
+  // The frame fence is signaled, so all results are available. VK_NOT_READY
+  // is only returned for scopes that have never been ended:
+  const auto scopeCount = static_cast<std::uint32_t>(frame.scopes.size());
+  bool available =
+      vkGetQueryPoolResults(
+          device_, frame.timestampPool, 0, 2 * scopeCount,
+          queryData_.size() * sizeof(std::uint64_t), queryData_.data(),
+          sizeof(std::uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS;
+  if (available) {
+    for (std::uint32_t i{0}; i < scopeCount; ++i) {
+      const auto ticks =
+          (queryData_[2 * i + 1] - queryData_[2 * i]) & timestampMask_;
+      frame.scopes[i].milliseconds = ticks * timestampPeriod_ * 1e-6;
+    }
+  }
+  // Statistics queries of scopes without statistics are never begun, their
+  // results are never available:
+  for (std::uint32_t i{0}; available && i < scopeCount; ++i) {
+    if (frame.scopes[i].hasStatistics) {
+      available = vkGetQueryPoolResults(
+                      device_, frame.statisticsPool, i, 1,
+                      sizeof(GpuPipelineStatistics),
+                      &frame.scopes[i].statistics,
+                      sizeof(GpuPipelineStatistics),
+                      VK_QUERY_RESULT_64_BIT) == VK_SUCCESS;
+    }
+  }
+  if (available) {
+    results_.swap(frame.scopes);
+  }
+  frame.scopes.clear();
+  frame.reset = false;
+}
+
+void GpuProfiler::RecordReset(VkCommandBuffer commandBuffer) {
+  if (!enabled_) {
+    return;
+  }
+  auto &frame = frames_[currentFrame_];
+  if (frame.reset) {
+    return;
+  }
+  vkCmdResetQueryPool(commandBuffer, frame.timestampPool, 0, 2 * maxScopes_);
+  if (frame.statisticsPool != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(commandBuffer, frame.statisticsPool, 0, maxScopes_);
+  }
+  frame.reset = true;
+}
+
+void GpuProfiler::BeginScope(VkCommandBuffer commandBuffer, const char *name,
+                             bool statistics) {
+  if (!enabled_) {
+    return;
+  }
+  auto &frame = frames_[currentFrame_];
+  if (!frame.reset || frame.scopes.size() >= maxScopes_) {
+    openScopes_.push_back(kNoScope);
+    return;
+  }
+  const auto index = static_cast<std::uint32_t>(frame.scopes.size());
+  GpuScopeTiming scope{};
+  scope.name = name;
+  scope.depth = static_cast<std::uint32_t>(openScopes_.size());
+  scope.hasStatistics =
+      statistics && pipelineStatistics_ && statisticsScope_ == kNoScope;
+  frame.scopes.push_back(scope);
+  openScopes_.push_back(index);
+
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                      frame.timestampPool, 2 * index);
+  if (scope.hasStatistics) {
+    vkCmdBeginQuery(commandBuffer, frame.statisticsPool, index, 0);
+    statisticsScope_ = index;
+  }
+}
+
+void GpuProfiler::EndScope(VkCommandBuffer commandBuffer) {
+  if (!enabled_ || openScopes_.empty()) {
+    return;
+  }
+  const auto index = openScopes_.back();
+  openScopes_.pop_back();
+  if (index == kNoScope) {
+    return;
+  }
+  auto &frame = frames_[currentFrame_];
+  if (statisticsScope_ == index) {
+    vkCmdEndQuery(commandBuffer, frame.statisticsPool, index);
+    statisticsScope_ = kNoScope;
+  }
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                      frame.timestampPool, 2 * index + 1);
+}
+
+} // namespace render
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace render {
+
+struct GpuProfilerOptions final {
+  VkPhysicalDevice physicalDevice{VK_NULL_HANDLE};
+  VkDevice device{VK_NULL_HANDLE};
+  /// Queue family the profiled command buffers are submitted to.
+  std::uint32_t queueFamilyIndex{};
+  /// Number of frame query pools, one per frame in flight.
+  std::uint32_t frameCount{};
+  /// Maximum number of scopes per frame, further scopes are not measured.
+  std::uint32_t maxScopes{32};
+  /// Collects pipeline statistics, requires the pipelineStatisticsQuery
+  /// feature to be enabled.
+  bool pipelineStatistics{false};
+};
+
+/// Pipeline statistics of a scope, in VkQueryPipelineStatisticFlagBits order.
+struct GpuPipelineStatistics final {
+  std::uint64_t inputAssemblyVertices{};
+  std::uint64_t inputAssemblyPrimitives{};
+  std::uint64_t vertexShaderInvocations{};
+  std::uint64_t clippingInvocations{};
+  std::uint64_t clippingPrimitives{};
+  std::uint64_t fragmentShaderInvocations{};
+};
+
+/// GPU time of a profiler scope.
+struct GpuScopeTiming final {
+  /// Scope name, a string with static storage duration.
+  const char *name{nullptr};
+  /// Nesting depth, top level scopes have depth 0.
+  std::uint32_t depth{};
+  double milliseconds{};
+  bool hasStatistics{false};
+  GpuPipelineStatistics statistics{};
+};
+
+/// GPU profiler based on timestamp and pipeline statistics queries.
+///
+/// Every frame in flight has its own query pools. The queries of a frame are
+/// reset at the beginning of its command buffer and read back without
+/// waiting by BeginFrame of the same frame slot, i.e. after its fence has
+/// been waited and frameCount frames after they were written. Reading the
+/// results never stalls the CPU or the GPU.
+///
+/// Timestamps are written at TOP_OF_PIPE at the beginning and BOTTOM_OF_PIPE
+/// at the end of a scope. Only one pipeline statistics query can be active in
+/// a command buffer, nested scopes get timestamps only.
+class GpuProfiler final {
+public:
+  /// Creates the query pools, the profiler stays disabled if the queue
+  /// family doesn't support timestamps.
+  void Initialize(const GpuProfilerOptions &options);
+
+  /// Destroys the query pools.
+  void Cleanup();
+
+  /// Reads back the results of the frame slot, call after its fence wait.
+  void BeginFrame(std::uint32_t frameIndex);
+
+  /// Resets the queries of the current frame.
+  ///
+  /// Has to be recorded outside of a render pass before the first scope, only
+  /// the first call of a frame records the reset.
+  void RecordReset(VkCommandBuffer commandBuffer);
+
+  /// Begins a scope, scopes may be nested.
+  ///
+  /// Inside a render pass instance it can only be recorded with inline
+  /// subpass contents.
+  ///
+  /// @param commandBuffer  Command buffer.
+  /// @param name  Scope name with static storage duration.
+  /// @param statistics  Collects pipeline statistics of the scope if no other
+  /// scope collects them at the moment.
+  void BeginScope(VkCommandBuffer commandBuffer, const char *name,
+                  bool statistics = false);
+
+  /// Ends the innermost scope.
+  void EndScope(VkCommandBuffer commandBuffer);
+
+  /// Returns the scopes of the latest completed frame in recording order.
+  const std::vector<GpuScopeTiming> &GetResults() const { return results_; }
+
+  bool IsEnabled() const { return enabled_; }
+
+private:
+  struct Frame final {
+    VkQueryPool timestampPool{VK_NULL_HANDLE};
+    VkQueryPool statisticsPool{VK_NULL_HANDLE};
+    /// Scopes recorded into the frame, their query index is the scope index.
+    std::vector<GpuScopeTiming> scopes{};
+    bool reset{false};
+  };
+
+  /// Scope index pushed for scopes that are not measured.
+  static constexpr std::uint32_t kNoScope{~0U};
+
+  VkDevice device_{VK_NULL_HANDLE};
+  bool enabled_{false};
+  bool pipelineStatistics_{false};
+  std::uint32_t maxScopes_{};
+  /// Nanoseconds per timestamp tick and mask of the valid timestamp bits.
+  double timestampPeriod_{};
+  std::uint64_t timestampMask_{};
+
+  std::vector<Frame> frames_{};
+  std::uint32_t currentFrame_{};
+  /// Indices of the open scopes, innermost last.
+  std::vector<std::uint32_t> openScopes_{};
+  /// Scope collecting pipeline statistics at the moment.
+  std::uint32_t statisticsScope_{kNoScope};
+  std::vector<GpuScopeTiming> results_{};
+  /// Query results read back by BeginFrame.
+  std::vector<std::uint64_t> queryData_{};
+};
+
+} // namespace render
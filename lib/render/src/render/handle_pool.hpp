@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace render {
+
+/// Generational index of a HandlePool slot.
+///
+/// The tag makes handles of different pools distinct types. A default
+/// constructed handle is null.
+template <typename Tag> struct Handle final {
+  std::uint32_t index{~0U};
+  std::uint32_t generation{};
+
+  bool IsNull() const { return index == ~0U; }
+
+  friend bool operator==(const Handle &lhs, const Handle &rhs) {
+    return lhs.index == rhs.index && lhs.generation == rhs.generation;
+  }
+  friend bool operator!=(const Handle &lhs, const Handle &rhs) {
+    return !(lhs == rhs);
+  }
+};
+
+/// Pool of slots addressed by generational handles, one array per field.
+///
+/// Freed slots go to a free list and are reused by the next allocation, so
+/// allocating and freeing are O(1) and the arrays only grow to the peak
+/// number of live slots. Every slot has a generation that is odd while the
+/// slot is live and increased by both allocating and freeing it: handles of
+/// freed slots no longer match it, so lookups through them return nullptr
+/// instead of reaching a reused slot.
+///
+/// The fields are stored as a structure of arrays, a loop over one field
+/// only touches the cache lines of that field.
+template <typename Tag, typename... Fields> class HandlePool final {
+public:
+  using HandleType = Handle<Tag>;
+
+  /// Stores the fields in a free slot.
+  HandleType Allocate(Fields... fields) {
+    std::uint32_t index{};
+    if (freeIndices_.empty()) {
+      index = static_cast<std::uint32_t>(generations_.size());
+      generations_.push_back(1);
+      Append(std::index_sequence_for<Fields...>{}, std::move(fields)...);
+    } else {
+      index = freeIndices_.back();
+      freeIndices_.pop_back();
+      ++generations_[index];
+      Assign(std::index_sequence_for<Fields...>{}, index,
+             std::move(fields)...);
+    }
+    ++size_;
+    return HandleType{index, generations_[index]};
+  }
+
+  /// Frees the slot of the handle.
+  ///
+  /// @return False if the handle is null or stale.
+  bool Free(HandleType handle) {
+    if (!IsAlive(handle)) {
+      return false;
+    }
+    ++generations_[handle.index];
+    freeIndices_.push_back(handle.index);
+    --size_;
+    return true;
+  }
+
+  bool IsAlive(HandleType handle) const {
+    return handle.index < generations_.size() &&
+           generations_[handle.index] == handle.generation;
+  }
+
+  /// Returns field I of the slot, nullptr if the handle is null or stale.
+  template <std::size_t I> auto *Get(HandleType handle) {
+    return IsAlive(handle) ? &std::get<I>(fields_)[handle.index] : nullptr;
+  }
+
+  template <std::size_t I> const auto *Get(HandleType handle) const {
+    return IsAlive(handle) ? &std::get<I>(fields_)[handle.index] : nullptr;
+  }
+
+  /// Calls function(handle, fields...) for every live slot.
+  template <typename Function> void ForEach(Function &&function) {
+    for (std::uint32_t index{0}; index < generations_.size(); ++index) {
+      if (generations_[index] % 2 != 0) {
+        Call(std::index_sequence_for<Fields...>{}, function,
+             HandleType{index, generations_[index]});
+      }
+    }
+  }
+
+  /// Frees all slots, handles of the previous slots stay stale.
+  void Clear() {
+    freeIndices_.clear();
+    for (std::uint32_t index{0}; index < generations_.size(); ++index) {
+      if (generations_[index] % 2 != 0) {
+        ++generations_[index];
+      }
+      freeIndices_.push_back(index);
+    }
+    size_ = 0;
+  }
+
+  /// Number of live slots.
+  std::size_t GetSize() const { return size_; }
+
+private:
+  template <std::size_t... I>
+  void Append(std::index_sequence<I...>, Fields &&...fields) {
+    (std::get<I>(fields_).push_back(std::move(fields)), ...);
+  }
+
+  template <std::size_t... I>
+  void Assign(std::index_sequence<I...>, std::uint32_t index,
+              Fields &&...fields) {
+    ((std::get<I>(fields_)[index] = std::move(fields)), ...);
+  }
+
+  template <typename Function, std::size_t... I>
+  void Call(std::index_sequence<I...>, Function &function,
+            HandleType handle) {
+    function(handle, std::get<I>(fields_)[handle.index]...);
+  }
+
+  /// Slot generations, odd while the slot is live.
+  std::vector<std::uint32_t> generations_{};
+  std::vector<std::uint32_t> freeIndices_{};
+  std::tuple<std::vector<Fields>...> fields_{};
+  std::size_t size_{};
+};
+
+} // namespace render
@@ -0,0 +1,89 @@
+#include "render/mapped_file.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define RENDER_HAS_MMAP 1
+#else
+#include <fstream>
+#endif
+
+namespace render {
+
+MappedFile::~MappedFile() { Close(); }
+
+MappedFile::MappedFile(MappedFile &&other) noexcept {
+  *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+  if (this != &other) {
+    Close();
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+    mapped_ = std::exchange(other.mapped_, false);
+    buffer_ = std::move(other.buffer_);
+  }
+  return *this;
+}
+
+void MappedFile::Open(const std::string &path) {
+  Close();
+#if defined(RENDER_HAS_MMAP)
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("failed to open file!");
+  }
+  struct stat status {};
+  if (fstat(fd, &status) != 0) {
+    close(fd);
+    throw std::runtime_error("failed to open file!");
+  }
+  size_ = static_cast<std::size_t>(status.st_size);
+  if (size_ > 0) {
+    void *address = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (address == MAP_FAILED) {
+      close(fd);
+      size_ = 0;
+      throw std::runtime_error("failed to map file!");
+    }
+    data_ = static_cast<const char *>(address);
+    mapped_ = true;
+  } else {
+    // Empty files can't be mapped, they still open successfully:
+    buffer_.resize(1);
+    data_ = buffer_.data();
+  }
+  // The mapping stays valid after the descriptor is closed:
+  close(fd);
+#else
+  std::ifstream f(path, std::ios::in | std::ios::binary | std::ios::ate);
+  if (!f.is_open()) {
+    throw std::runtime_error("failed to open file!");
+  }
+  size_ = static_cast<std::size_t>(f.tellg());
+  buffer_.resize(size_ > 0 ? size_ : 1);
+  f.seekg(0);
+  f.read(buffer_.data(), size_);
+  data_ = buffer_.data();
+#endif
+}
+
+void MappedFile::Close() {
+#if defined(RENDER_HAS_MMAP)
+  if (mapped_) {
+    munmap(const_cast<char *>(data_), size_);
+  }
+#endif
+  data_ = nullptr;
+  size_ = 0;
+  mapped_ = false;
+  buffer_.clear();
+}
+
+} // namespace render
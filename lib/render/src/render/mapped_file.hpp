@@ -0,0 +1,46 @@
+#pragma once
+
+#include "render/span.hpp"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace render {
+
+/// Read-only file mapped into memory.
+///
+/// The pages are loaded on first access and shared with the page cache, so
+/// reading the file involves no copy into a heap buffer. Platforms without
+/// mmap read the file into an owned buffer instead. Mappings are movable,
+/// the destructor unmaps the file.
+class MappedFile final {
+public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  MappedFile(MappedFile &&other) noexcept;
+  MappedFile &operator=(MappedFile &&other) noexcept;
+
+  /// Maps the whole file, throws if it can't be opened.
+  void Open(const std::string &path);
+
+  /// Unmaps the file.
+  void Close();
+
+  /// Returns the file contents, the address is page aligned if mapped.
+  Span<const char> GetData() const { return Span<const char>{data_, size_}; }
+
+  bool IsOpen() const { return data_ != nullptr; }
+
+private:
+  const char *data_{nullptr};
+  std::size_t size_{};
+  /// Whether data_ is a mapping, otherwise it points into buffer_.
+  bool mapped_{false};
+  std::vector<char> buffer_{};
+};
+
+} // namespace render
@@ -0,0 +1,230 @@
+#include "render/memory_allocator.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace render {
+
+namespace {
+
+VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return alignment > 1 ? (value + alignment - 1) / alignment * alignment
+                       : value;
+}
+
+} // namespace
+
+void MemoryAllocator::Initialize(const MemoryAllocatorOptions &options) {
+  device_ = options.device;
+  blockSize_ = options.blockSize;
+  vkGetPhysicalDeviceMemoryProperties(options.physicalDevice,
+                                      &memoryProperties_);
+  pools_.resize(memoryProperties_.memoryTypeCount);
+  std::cout << "Memory allocator: Memory type count is "
+            << memoryProperties_.memoryTypeCount << std::endl;
+}
+
+void MemoryAllocator::Cleanup() {
+  for (auto &pool : pools_) {
+    for (auto &block : pool.blocks) {
+      if (block.memory != VK_NULL_HANDLE) {
+        vkFreeMemory(device_, block.memory, nullptr);
+      }
+    }
+    pool.blocks.clear();
+  }
+  pools_.clear();
+  deviceMemoryCount_ = 0;
+}
+
+std::uint32_t
+MemoryAllocator::FindMemoryType(std::uint32_t typeFilter,
+                                VkMemoryPropertyFlags properties) const {
+  const auto memoryType = TryFindMemoryType(typeFilter, properties);
+  if (!memoryType.has_value()) {
+    throw std::runtime_error("failed to find suitable memory type!");
+  }
+  return *memoryType;
+}
+
+std::optional<std::uint32_t>
+MemoryAllocator::TryFindMemoryType(std::uint32_t typeFilter,
+                                   VkMemoryPropertyFlags properties) const {
+  for (std::uint32_t i{0}; i < memoryProperties_.memoryTypeCount; ++i) {
+    if ((typeFilter & (1 << i)) &&
+        (memoryProperties_.memoryTypes[i].propertyFlags & properties) ==
+            properties) {
+      return i;
+    }
+  }
+  return std::nullopt;
+}
+
+VkDeviceSize
+MemoryAllocator::GetBlockSize(std::uint32_t memoryTypeIndex) const {
+  // Small heaps (e.g. 256 MiB device local host visible BAR memory) should not
+  // be taken by a couple of blocks:
+  const auto heapIndex =
+      memoryProperties_.memoryTypes[memoryTypeIndex].heapIndex;
+  const auto heapSize = memoryProperties_.memoryHeaps[heapIndex].size;
+  return std::min(blockSize_, std::max<VkDeviceSize>(heapSize / 8, 1));
+}
+
+std::uint32_t MemoryAllocator::CreateBlock(std::uint32_t memoryTypeIndex,
+                                           VkDeviceSize size, bool dedicated) {
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = size;
+  allocInfo.memoryTypeIndex = memoryTypeIndex;
+  Block block{};
+  if (vkAllocateMemory(device_, &allocInfo, nullptr, &block.memory) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate device memory block!");
+  }
+  ++deviceMemoryCount_;
+  block.size = size;
+  block.dedicated = dedicated;
+  block.freeRanges.push_back(FreeRange{0, size});
+
+  // Host visible blocks are persistently mapped, a memory object can be mapped
+  // only once at a time anyway.
+  const auto propertyFlags =
+      memoryProperties_.memoryTypes[memoryTypeIndex].propertyFlags;
+  if (propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    if (vkMapMemory(device_, block.memory, 0, size, 0, &block.mappedData) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to map device memory block!");
+    }
+  }
+
+  std::cout << "Memory allocator: New " << (dedicated ? "dedicated " : "")
+            << "block of " << size << " bytes for memory type "
+            << memoryTypeIndex << std::endl;
+
+  // Reuse the slot of a released dedicated block if there is one:
+  auto &blocks = pools_[memoryTypeIndex].blocks;
+  for (std::size_t i{0}; i < blocks.size(); ++i) {
+    if (blocks[i].memory == VK_NULL_HANDLE) {
+      blocks[i] = std::move(block);
+      return static_cast<std::uint32_t>(i);
+    }
+  }
+  blocks.push_back(std::move(block));
+  return static_cast<std::uint32_t>(blocks.size() - 1);
+}
+
+bool MemoryAllocator::TryAllocate(Block &block, VkDeviceSize size,
+                                  VkDeviceSize alignment,
+                                  VkDeviceSize &offset) {
+  for (std::size_t i{0}; i < block.freeRanges.size(); ++i) {
+    const auto range = block.freeRanges[i];
+    const auto alignedOffset = AlignUp(range.offset, alignment);
+    const auto padding = alignedOffset - range.offset;
+    if (padding + size > range.size) {
+      continue;
+    }
+    // Split the free range into the alignment padding in front of the
+    // allocation and the remainder behind it:
+    const FreeRange remainder{alignedOffset + size,
+                              range.size - padding - size};
+    if (padding > 0) {
+      block.freeRanges[i].size = padding;
+      if (remainder.size > 0) {
+        block.freeRanges.insert(block.freeRanges.begin() + i + 1, remainder);
+      }
+    } else if (remainder.size > 0) {
+      block.freeRanges[i] = remainder;
+    } else {
+      block.freeRanges.erase(block.freeRanges.begin() + i);
+    }
+    ++block.allocationCount;
+    offset = alignedOffset;
+    return true;
+  }
+  return false;
+}
+
+Allocation MemoryAllocator::Allocate(const VkMemoryRequirements &requirements,
+                                     VkMemoryPropertyFlags properties) {
+  Allocation allocation{};
+  allocation.size = requirements.size;
+  allocation.memoryTypeIndex =
+      FindMemoryType(requirements.memoryTypeBits, properties);
+  const auto blockSize = GetBlockSize(allocation.memoryTypeIndex);
+  auto &blocks = pools_[allocation.memoryTypeIndex].blocks;
+
+  bool found{false};
+  if (requirements.size > blockSize / 2) {
+    allocation.blockIndex =
+        CreateBlock(allocation.memoryTypeIndex, requirements.size, true);
+    found = TryAllocate(blocks[allocation.blockIndex], requirements.size,
+                        requirements.alignment, allocation.offset);
+  } else {
+    for (std::size_t i{0}; i < blocks.size() && !found; ++i) {
+      if (blocks[i].memory == VK_NULL_HANDLE || blocks[i].dedicated) {
+        continue;
+      }
+      if (TryAllocate(blocks[i], requirements.size, requirements.alignment,
+                      allocation.offset)) {
+        allocation.blockIndex = static_cast<std::uint32_t>(i);
+        found = true;
+      }
+    }
+    if (!found) {
+      allocation.blockIndex =
+          CreateBlock(allocation.memoryTypeIndex, blockSize, false);
+      found = TryAllocate(blocks[allocation.blockIndex], requirements.size,
+                          requirements.alignment, allocation.offset);
+    }
+  }
+  if (!found) {
+    throw std::runtime_error("failed to sub-allocate device memory!");
+  }
+
+  const auto &block = blocks[allocation.blockIndex];
+  allocation.memory = block.memory;
+  if (block.mappedData != nullptr) {
+    allocation.mappedData =
+        static_cast<char *>(block.mappedData) + allocation.offset;
+  }
+  return allocation;
+}
+
+void MemoryAllocator::Free(const Allocation &allocation) {
+  if (allocation.memory == VK_NULL_HANDLE) {
+    return;
+  }
+  auto &pool = pools_[allocation.memoryTypeIndex];
+  auto &block = pool.blocks[allocation.blockIndex];
+  --block.allocationCount;
+  if (block.dedicated && block.allocationCount == 0) {
+    vkFreeMemory(device_, block.memory, nullptr);
+    --deviceMemoryCount_;
+    block = Block{};
+    return;
+  }
+
+  // Insert the range keeping the list sorted and merge it with neighbours:
+  auto &ranges = block.freeRanges;
+  const auto it = std::lower_bound(
+      ranges.begin(), ranges.end(), allocation.offset,
+      [](const FreeRange &range, VkDeviceSize offset) {
+        return range.offset < offset;
+      });
+  auto index = static_cast<std::size_t>(it - ranges.begin());
+  ranges.insert(it, FreeRange{allocation.offset, allocation.size});
+  if (index + 1 < ranges.size() &&
+      ranges[index].offset + ranges[index].size == ranges[index + 1].offset) {
+    ranges[index].size += ranges[index + 1].size;
+    ranges.erase(ranges.begin() + index + 1);
+  }
+  if (index > 0 &&
+      ranges[index - 1].offset + ranges[index - 1].size ==
+          ranges[index].offset) {
+    ranges[index - 1].size += ranges[index].size;
+    ranges.erase(ranges.begin() + index);
+  }
+}
+
+} // namespace render
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace render {
+
+/// Sub-range of a device memory block handed out by the MemoryAllocator.
+struct Allocation final {
+  VkDeviceMemory memory{VK_NULL_HANDLE};
+  VkDeviceSize offset{};
+  VkDeviceSize size{};
+  /// Host address of the sub-range if the memory is host visible, nullptr
+  /// otherwise. Host visible blocks stay mapped for their whole lifetime.
+  void *mappedData{nullptr};
+  std::uint32_t memoryTypeIndex{};
+  std::uint32_t blockIndex{};
+};
+
+struct MemoryAllocatorOptions final {
+  VkPhysicalDevice physicalDevice{VK_NULL_HANDLE};
+  VkDevice device{VK_NULL_HANDLE};
+  /// Preferred size of a memory block. Smaller heaps get smaller blocks.
+  VkDeviceSize blockSize{64U * 1024U * 1024U};
+};
+
+/// Block-based device memory allocator.
+///
+/// Every vkAllocateMemory call is expensive and the number of live
+/// allocations is limited by maxMemoryAllocationCount (it can be as low as
+/// 4096). The allocator therefore requests large blocks per memory type and
+/// sub-allocates them with a first-fit free list that respects the alignment
+/// from VkMemoryRequirements. Resources are bound to their sub-range with the
+/// memory offset of vkBind*Memory. Requests larger than half a block get a
+/// dedicated block of their own.
+///
+/// The allocator is not thread-safe.
+class MemoryAllocator final {
+public:
+  /// Queries memory properties of the physical device.
+  void Initialize(const MemoryAllocatorOptions &options);
+
+  /// Frees all memory blocks. Every allocation becomes invalid.
+  void Cleanup();
+
+  /// Allocates a sub-range satisfying the memory requirements.
+  ///
+  /// @param requirements  Memory requirements of the resource.
+  /// @param properties  Memory properties.
+  ///
+  /// @return Allocation.
+  Allocation Allocate(const VkMemoryRequirements &requirements,
+                      VkMemoryPropertyFlags properties);
+
+  /// Returns the sub-range back to its block.
+  void Free(const Allocation &allocation);
+
+  /// Finds suitable memory type.
+  std::uint32_t FindMemoryType(std::uint32_t typeFilter,
+                               VkMemoryPropertyFlags properties) const;
+
+  /// Finds suitable memory type, std::nullopt if there is none.
+  std::optional<std::uint32_t>
+  TryFindMemoryType(std::uint32_t typeFilter,
+                    VkMemoryPropertyFlags properties) const;
+
+  /// Returns the number of live vkAllocateMemory allocations.
+  std::size_t GetDeviceMemoryCount() const { return deviceMemoryCount_; }
+
+private:
+  struct FreeRange final {
+    VkDeviceSize offset{};
+    VkDeviceSize size{};
+  };
+
+  struct Block final {
+    VkDeviceMemory memory{VK_NULL_HANDLE};
+    VkDeviceSize size{};
+    void *mappedData{nullptr};
+    /// Free sub-ranges sorted by offset, adjacent ranges are always merged.
+    std::vector<FreeRange> freeRanges{};
+    std::size_t allocationCount{};
+    bool dedicated{};
+  };
+
+  /// Blocks of the same memory type.
+  struct MemoryPool final {
+    std::vector<Block> blocks{};
+  };
+
+  /// Allocates a new block of the memory type and returns its index.
+  std::uint32_t CreateBlock(std::uint32_t memoryTypeIndex, VkDeviceSize size,
+                            bool dedicated);
+
+  /// Tries to place a sub-range into the block.
+  bool TryAllocate(Block &block, VkDeviceSize size, VkDeviceSize alignment,
+                   VkDeviceSize &offset);
+
+  /// Returns the preferred block size for the memory type.
+  VkDeviceSize GetBlockSize(std::uint32_t memoryTypeIndex) const;
+
+  VkDevice device_{VK_NULL_HANDLE};
+  VkPhysicalDeviceMemoryProperties memoryProperties_{};
+  VkDeviceSize blockSize_{};
+  std::vector<MemoryPool> pools_{};
+  std::size_t deviceMemoryCount_{};
+};
+
+} // namespace render
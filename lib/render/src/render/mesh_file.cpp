@@ -0,0 +1,105 @@
+#include "render/mesh_file.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace render {
+
+namespace {
+
+constexpr std::uint64_t kArrayAlignment{4};
+
+std::uint64_t AlignUp(std::uint64_t value, std::uint64_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+/// Checks that the array lies inside the file and is aligned.
+bool IsArrayValid(std::uint64_t offset, std::uint64_t count,
+                  std::uint64_t elementSize, std::uint64_t fileSize) {
+  return offset % kArrayAlignment == 0 && offset <= fileSize &&
+         count <= (fileSize - offset) / elementSize;
+}
+
+} // namespace
+
+void MeshFile::Open(const std::string &path) {
+  Close();
+  file_.Open(path);
+  const auto data = file_.GetData();
+  MeshFileHeader header{};
+  if (data.size() < sizeof(header)) {
+    throw std::runtime_error("failed to load mesh file, it is too small!");
+  }
+  std::memcpy(&header, data.data(), sizeof(header));
+  const bool packed = header.vertexSize == sizeof(PackedVertex);
+  const bool indices32 = header.indexSize == sizeof(std::uint32_t);
+  if (header.magic != kMeshFileMagic || header.version != kMeshFileVersion ||
+      (!packed && header.vertexSize != sizeof(Vertex)) ||
+      (!indices32 && header.indexSize != sizeof(std::uint16_t)) ||
+      !IsArrayValid(header.vertexOffset, header.vertexCount, header.vertexSize,
+                    data.size()) ||
+      !IsArrayValid(header.indexOffset, header.indexCount, header.indexSize,
+                    data.size())) {
+    Close();
+    throw std::runtime_error("failed to load mesh file, invalid header!");
+  }
+  // The mapping is page aligned and the arrays are aligned in the file:
+  const char *vertices = data.data() + header.vertexOffset;
+  const char *indices = data.data() + header.indexOffset;
+  const auto vertexCount = static_cast<std::size_t>(header.vertexCount);
+  const auto indexCount = static_cast<std::size_t>(header.indexCount);
+  if (packed) {
+    mesh_.packedVertices = Span<const PackedVertex>{
+        reinterpret_cast<const PackedVertex *>(vertices), vertexCount};
+  } else {
+    mesh_.vertices = Span<const Vertex>{
+        reinterpret_cast<const Vertex *>(vertices), vertexCount};
+  }
+  if (indices32) {
+    mesh_.indices32 = Span<const std::uint32_t>{
+        reinterpret_cast<const std::uint32_t *>(indices), indexCount};
+  } else {
+    mesh_.indices = Span<const std::uint16_t>{
+        reinterpret_cast<const std::uint16_t *>(indices), indexCount};
+  }
+}
+
+void MeshFile::Close() {
+  mesh_ = Mesh{};
+  file_.Close();
+}
+
+void WriteMeshFile(const std::string &path, const Mesh &mesh) {
+  const bool packed = mesh.GetVertexFormat() == VertexFormat::Packed;
+  const bool indices32 = mesh.GetIndexType() == VK_INDEX_TYPE_UINT32;
+  const auto vertices =
+      packed ? AsBytes(mesh.packedVertices) : AsBytes(mesh.vertices);
+  const auto indices =
+      indices32 ? AsBytes(mesh.indices32) : AsBytes(mesh.indices);
+
+  MeshFileHeader header{};
+  header.vertexSize = GetVertexSize(mesh.GetVertexFormat());
+  header.indexSize = GetIndexSize(mesh.GetIndexType());
+  header.vertexCount = mesh.GetVertexCount();
+  header.indexCount = mesh.GetIndexCount();
+  header.vertexOffset = AlignUp(sizeof(header), kArrayAlignment);
+  header.indexOffset =
+      AlignUp(header.vertexOffset + vertices.size(), kArrayAlignment);
+
+  std::ofstream f(path, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!f.is_open()) {
+    throw std::runtime_error("failed to open mesh file for writing!");
+  }
+  const char padding[kArrayAlignment]{};
+  f.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  f.write(padding, header.vertexOffset - sizeof(header));
+  f.write(vertices.data(), vertices.size());
+  f.write(padding, header.indexOffset - header.vertexOffset - vertices.size());
+  f.write(indices.data(), indices.size());
+  if (!f) {
+    throw std::runtime_error("failed to write mesh file!");
+  }
+}
+
+} // namespace render
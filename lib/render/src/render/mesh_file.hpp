@@ -0,0 +1,58 @@
+#pragma once
+
+#include "render/context.hpp"
+#include "render/mapped_file.hpp"
+
+#include <cstdint>
+#include <string>
+
+namespace render {
+
+/// "VPMS" in file order.
+constexpr std::uint32_t kMeshFileMagic{0x534D5056};
+constexpr std::uint32_t kMeshFileVersion{1};
+
+/// Header of a binary mesh file.
+///
+/// The header is followed by the vertex array, in Vertex or PackedVertex
+/// layout, and the index array of 16-bit or 32-bit indices, both in native
+/// byte order and 4-byte aligned, so the arrays of a mapped file are used in
+/// place.
+struct MeshFileHeader final {
+  std::uint32_t magic{kMeshFileMagic};
+  std::uint32_t version{kMeshFileVersion};
+  /// Vertex and index sizes of the writer, they identify the vertex layout
+  /// and the index type.
+  std::uint32_t vertexSize{};
+  std::uint32_t indexSize{};
+  std::uint64_t vertexCount{};
+  std::uint64_t indexCount{};
+  /// Byte offsets of the arrays from the start of the file.
+  std::uint64_t vertexOffset{};
+  std::uint64_t indexOffset{};
+};
+
+/// Memory mapped mesh file.
+///
+/// The mesh views point into the mapping, so uploading it with
+/// Context::CreateMeshBuffer copies the bytes from the page cache straight
+/// into the staging ring.
+class MeshFile final {
+public:
+  /// Maps and validates the file, throws if it is not a valid mesh file.
+  void Open(const std::string &path);
+
+  /// Unmaps the file, the mesh views become invalid.
+  void Close();
+
+  const Mesh &GetMesh() const { return mesh_; }
+
+private:
+  MappedFile file_{};
+  Mesh mesh_{};
+};
+
+/// Writes the mesh into a binary mesh file.
+void WriteMeshFile(const std::string &path, const Mesh &mesh);
+
+} // namespace render
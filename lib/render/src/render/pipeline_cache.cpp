@@ -0,0 +1,183 @@
+#include "render/pipeline_cache.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace render {
+
+namespace {
+
+/// Size of the VK_PIPELINE_CACHE_HEADER_VERSION_ONE header: header size,
+/// header version, vendor ID, device ID (4 bytes each) and the cache UUID.
+constexpr std::size_t kCacheHeaderSize{16 + VK_UUID_SIZE};
+
+std::vector<char> ReadCacheFile(const std::string &path) {
+  std::ifstream file(path, std::ios::ate | std::ios::binary);
+  if (!file.is_open()) {
+    return {};
+  }
+  std::vector<char> data(static_cast<std::size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(data.data(), static_cast<std::streamsize>(data.size()));
+  return data;
+}
+
+/// Checks the cache header against the physical device. Drivers have to
+/// reject incompatible data themselves, but some of them crash instead.
+bool IsCompatible(const std::vector<char> &data,
+                  const VkPhysicalDeviceProperties &properties) {
+  if (data.size() < kCacheHeaderSize) {
+    return false;
+  }
+  std::uint32_t header[4]{};
+  std::memcpy(header, data.data(), sizeof(header));
+  const auto headerSize = header[0];
+  const auto headerVersion = header[1];
+  const auto vendorID = header[2];
+  const auto deviceID = header[3];
+  return headerSize >= kCacheHeaderSize && headerSize <= data.size() &&
+         headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         vendorID == properties.vendorID && deviceID == properties.deviceID &&
+         std::memcmp(data.data() + sizeof(header),
+                     properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+} // namespace
+
+void PipelineCache::Initialize(const PipelineCacheOptions &options) {
+  device_ = options.device;
+  path_ = options.path;
+  creationFeedback_ = options.creationFeedback;
+  stats_ = PipelineCacheStats{};
+
+  std::vector<char> data{};
+  if (!path_.empty()) {
+    data = ReadCacheFile(path_);
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(options.physicalDevice, &properties);
+    if (!data.empty() && !IsCompatible(data, properties)) {
+      std::cout << "Pipeline cache: Ignoring " << path_
+                << ", it was created by another device or driver" << std::endl;
+      data.clear();
+    } else if (!data.empty()) {
+      std::cout << "Pipeline cache: Loaded " << data.size() << " bytes from "
+                << path_ << std::endl;
+    }
+  }
+
+  VkPipelineCacheCreateInfo cacheInfo{};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cacheInfo.initialDataSize = data.size();
+  cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+  if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &cache_) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline cache!");
+  }
+}
+
+void PipelineCache::Cleanup() {
+  if (cache_ == VK_NULL_HANDLE) {
+    return;
+  }
+  Save();
+  std::cout << "Pipeline cache: " << stats_.cacheHits << " of "
+            << stats_.pipelineCount << " pipelines were cache hits, creation "
+            << "took " << stats_.creationMilliseconds << " ms" << std::endl;
+  vkDestroyPipelineCache(device_, cache_, nullptr);
+  cache_ = VK_NULL_HANDLE;
+}
+
+void PipelineCache::Save() const {
+  if (path_.empty()) {
+    return;
+  }
+  std::size_t size{0};
+  if (vkGetPipelineCacheData(device_, cache_, &size, nullptr) != VK_SUCCESS) {
+    throw std::runtime_error("failed to get pipeline cache data!");
+  }
+  std::vector<char> data(size);
+  if (vkGetPipelineCacheData(device_, cache_, &size, data.data()) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to get pipeline cache data!");
+  }
+
+  // Write to a temporary file first, so an interrupted write never leaves a
+  // truncated cache behind:
+  const auto tmpPath = path_ + ".tmp";
+  {
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      throw std::runtime_error("failed to open pipeline cache file!");
+    }
+    file.write(data.data(), static_cast<std::streamsize>(size));
+  }
+  std::filesystem::rename(tmpPath, path_);
+}
+
+template <typename CreateInfo>
+CreateInfo PipelineCache::AddFeedback(
+    const CreateInfo &info, VkPipelineCreationFeedbackEXT &feedback,
+    VkPipelineCreationFeedbackCreateInfoEXT &feedbackInfo) {
+  CreateInfo pipelineInfo = info;
+  if (creationFeedback_) {
+    feedbackInfo.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+    feedbackInfo.pNext = pipelineInfo.pNext;
+    feedbackInfo.pPipelineCreationFeedback = &feedback;
+    pipelineInfo.pNext = &feedbackInfo;
+  }
+  return pipelineInfo;
+}
+
+void PipelineCache::AddStats(std::chrono::steady_clock::duration creationTime,
+                             const VkPipelineCreationFeedbackEXT &feedback) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  ++stats_.pipelineCount;
+  stats_.creationMilliseconds +=
+      std::chrono::duration<double, std::milli>(creationTime).count();
+  if ((feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT) &&
+      (feedback.flags &
+       VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT)) {
+    ++stats_.cacheHits;
+  }
+}
+
+VkPipeline PipelineCache::CreateGraphicsPipeline(
+    const VkGraphicsPipelineCreateInfo &info) {
+  VkPipelineCreationFeedbackEXT feedback{};
+  VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo{};
+  const auto pipelineInfo = AddFeedback(info, feedback, feedbackInfo);
+
+  const auto start = std::chrono::steady_clock::now();
+  VkPipeline pipeline{VK_NULL_HANDLE};
+  if (vkCreateGraphicsPipelines(device_, cache_, 1, &pipelineInfo, nullptr,
+                                &pipeline) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create graphics pipeline!");
+  }
+  AddStats(std::chrono::steady_clock::now() - start, feedback);
+  return pipeline;
+}
+
+VkPipeline
+PipelineCache::CreateComputePipeline(const VkComputePipelineCreateInfo &info) {
+  VkPipelineCreationFeedbackEXT feedback{};
+  VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo{};
+  const auto pipelineInfo = AddFeedback(info, feedback, feedbackInfo);
+
+  const auto start = std::chrono::steady_clock::now();
+  VkPipeline pipeline{VK_NULL_HANDLE};
+  if (vkCreateComputePipelines(device_, cache_, 1, &pipelineInfo, nullptr,
+                               &pipeline) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create compute pipeline!");
+  }
+  AddStats(std::chrono::steady_clock::now() - start, feedback);
+  return pipeline;
+}
+
+} // namespace render
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace render {
+
+struct PipelineCacheOptions final {
+  VkPhysicalDevice physicalDevice{VK_NULL_HANDLE};
+  VkDevice device{VK_NULL_HANDLE};
+  /// File the cache is loaded from and saved to, empty keeps it in memory.
+  std::string path{};
+  /// VK_EXT_pipeline_creation_feedback is enabled on the device.
+  bool creationFeedback{false};
+};
+
+/// Statistics of the pipelines created through the cache.
+struct PipelineCacheStats final {
+  std::uint32_t pipelineCount{};
+  /// Pipelines found in the cache. Counted only with creation feedback.
+  std::uint32_t cacheHits{};
+  /// Total time spent creating the pipelines.
+  double creationMilliseconds{};
+};
+
+/// VkPipelineCache persisted between runs.
+///
+/// The initial data is taken from the file only if its header matches the
+/// vendor ID, device ID and pipeline cache UUID of the physical device, data
+/// of another device or driver version is dropped and the cache starts
+/// empty. The cache data is written back to the file on Cleanup.
+///
+/// The pipelines may be created from several threads at once, the Vulkan
+/// pipeline cache is internally synchronized.
+class PipelineCache final {
+public:
+  /// Creates the cache, warm-starting it from the file if it is compatible.
+  void Initialize(const PipelineCacheOptions &options);
+
+  /// Saves and destroys the cache.
+  void Cleanup();
+
+  /// Writes the current cache data to the file.
+  void Save() const;
+
+  /// Creates a graphics pipeline with the cache and updates the statistics.
+  VkPipeline CreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo &info);
+
+  /// Creates a compute pipeline with the cache and updates the statistics.
+  VkPipeline CreateComputePipeline(const VkComputePipelineCreateInfo &info);
+
+  VkPipelineCache GetHandle() const { return cache_; }
+
+  PipelineCacheStats GetStats() const {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return stats_;
+  }
+
+private:
+  /// Chains the creation feedback into the create info, if it is enabled.
+  template <typename CreateInfo>
+  CreateInfo AddFeedback(const CreateInfo &info,
+                         VkPipelineCreationFeedbackEXT &feedback,
+                         VkPipelineCreationFeedbackCreateInfoEXT &feedbackInfo);
+
+  void AddStats(std::chrono::steady_clock::duration creationTime,
+                const VkPipelineCreationFeedbackEXT &feedback);
+
+  VkDevice device_{VK_NULL_HANDLE};
+  VkPipelineCache cache_{VK_NULL_HANDLE};
+  std::string path_{};
+  bool creationFeedback_{false};
+  /// Guards the statistics.
+  mutable std::mutex mutex_{};
+  PipelineCacheStats stats_{};
+};
+
+} // namespace render
@@ -0,0 +1,781 @@
+#include "render/render_graph.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace render {
+
+namespace {
+
+/// Synchronization scope of a RenderGraphUsage.
+struct UsageInfo final {
+  VkPipelineStageFlags stages{};
+  VkAccessFlags access{};
+  /// Write accesses among access, zero for reads.
+  VkAccessFlags writeAccess{};
+  /// Layout of image accesses.
+  VkImageLayout layout{VK_IMAGE_LAYOUT_UNDEFINED};
+  VkImageUsageFlags imageUsage{};
+};
+
+UsageInfo GetUsageInfo(RenderGraphUsage usage) {
+  constexpr VkPipelineStageFlags kFragmentTests{
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+      VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT};
+  constexpr VkAccessFlags kShaderRead{VK_ACCESS_SHADER_READ_BIT |
+                                      VK_ACCESS_UNIFORM_READ_BIT};
+  switch (usage) {
+  case RenderGraphUsage::ColorAttachment:
+    return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT};
+  case RenderGraphUsage::DepthAttachment:
+    return {kFragmentTests,
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+  case RenderGraphUsage::DepthReadOnly:
+    return {kFragmentTests, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, 0,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+  case RenderGraphUsage::FragmentSampled:
+    return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+            0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_IMAGE_USAGE_SAMPLED_BIT};
+  case RenderGraphUsage::ComputeSampled:
+    return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_IMAGE_USAGE_SAMPLED_BIT};
+  case RenderGraphUsage::ComputeRead:
+    return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, kShaderRead, 0,
+            VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT};
+  case RenderGraphUsage::ComputeWrite:
+    return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+            VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL,
+            VK_IMAGE_USAGE_STORAGE_BIT};
+  case RenderGraphUsage::IndirectRead:
+    return {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+            VK_ACCESS_INDIRECT_COMMAND_READ_BIT};
+  case RenderGraphUsage::VertexRead:
+    return {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+            VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT};
+  case RenderGraphUsage::VertexShaderRead:
+    return {VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, kShaderRead, 0,
+            VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT};
+  case RenderGraphUsage::FragmentShaderRead:
+    return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, kShaderRead, 0,
+            VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT};
+  case RenderGraphUsage::TransferSrc:
+    return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, 0,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_IMAGE_USAGE_TRANSFER_SRC_BIT};
+  case RenderGraphUsage::TransferDst:
+    return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT};
+  }
+  return {};
+}
+
+bool IsAttachment(RenderGraphUsage usage) {
+  return usage == RenderGraphUsage::ColorAttachment ||
+         usage == RenderGraphUsage::DepthAttachment ||
+         usage == RenderGraphUsage::DepthReadOnly;
+}
+
+/// Returns true if the access depends on the earlier content, attachments
+/// that are not cleared are loaded.
+bool ReadsContent(const RenderGraphAccess &access) {
+  if (IsAttachment(access.usage)) {
+    return !access.clear;
+  }
+  return GetUsageInfo(access.usage).writeAccess == 0;
+}
+
+bool WritesContent(const RenderGraphAccess &access) {
+  return GetUsageInfo(access.usage).writeAccess != 0;
+}
+
+VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+void RenderGraph::Initialize(const RenderGraphOptions &options) {
+  device_ = options.device;
+  allocator_ = options.allocator;
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(options.physicalDevice, &properties);
+  granularity_ =
+      std::max<VkDeviceSize>(properties.limits.bufferImageGranularity, 1);
+}
+
+void RenderGraph::Cleanup() {
+  DestroyCompiled(compiled_);
+  compiled_ = CompiledResources{};
+  compiledPasses_.clear();
+  compiledPassIndices_.clear();
+  finalBarriers_ = BarrierBatch{};
+  Reset();
+}
+
+void RenderGraph::Reset() {
+  resources_.clear();
+  passes_.clear();
+}
+
+RenderGraphResource
+RenderGraph::CreateImage(const RenderGraphImageOptions &options) {
+  Resource resource{};
+  resource.type = ResourceType::TransientImage;
+  resource.format = options.format;
+  resource.extent = options.extent;
+  resource.aspectMask = options.aspectMask;
+  resources_.push_back(resource);
+  return RenderGraphResource{
+      static_cast<std::uint32_t>(resources_.size() - 1)};
+}
+
+RenderGraphResource
+RenderGraph::ImportImage(const RenderGraphImportedImageOptions &options) {
+  Resource resource{};
+  resource.type = ResourceType::Image;
+  resource.image = options.image;
+  resource.imageView = options.imageView;
+  resource.format = options.format;
+  resource.extent = options.extent;
+  resource.aspectMask = options.aspectMask;
+  resource.initialLayout = options.initialLayout;
+  resource.finalLayout = options.finalLayout;
+  resources_.push_back(resource);
+  return RenderGraphResource{
+      static_cast<std::uint32_t>(resources_.size() - 1)};
+}
+
+RenderGraphResource
+RenderGraph::ImportBuffer(const RenderGraphImportedBufferOptions &options) {
+  Resource resource{};
+  resource.type = ResourceType::Buffer;
+  resource.buffer = options.buffer;
+  resources_.push_back(resource);
+  return RenderGraphResource{
+      static_cast<std::uint32_t>(resources_.size() - 1)};
+}
+
+void RenderGraph::SetImportedImage(RenderGraphResource resource,
+                                   VkImage image, VkImageView imageView) {
+  auto &importedImage = resources_.at(resource.index);
+  if (importedImage.type != ResourceType::Image) {
+    throw std::runtime_error("failed to set image of non-imported image!");
+  }
+  importedImage.image = image;
+  importedImage.imageView = imageView;
+}
+
+void RenderGraph::SetImportedBuffer(RenderGraphResource resource,
+                                    VkBuffer buffer) {
+  auto &importedBuffer = resources_.at(resource.index);
+  if (importedBuffer.type != ResourceType::Buffer) {
+    throw std::runtime_error("failed to set buffer of non-buffer resource!");
+  }
+  importedBuffer.buffer = buffer;
+}
+
+RenderGraphPass RenderGraph::AddPass(RenderGraphPassOptions options) {
+  for (const auto &access : options.accesses) {
+    if (access.resource.index >= resources_.size()) {
+      throw std::runtime_error("failed to add pass with unknown resource!");
+    }
+    const bool buffer =
+        resources_[access.resource.index].type == ResourceType::Buffer;
+    const bool attachment = IsAttachment(access.usage);
+    if ((attachment || access.usage == RenderGraphUsage::FragmentSampled ||
+         access.usage == RenderGraphUsage::ComputeSampled) &&
+        buffer) {
+      throw std::runtime_error("failed to add pass using buffer as image!");
+    }
+    if (attachment && options.type != RenderGraphPassType::Graphics) {
+      throw std::runtime_error("failed to add attachment to non-graphics "
+                               "pass!");
+    }
+  }
+  passes_.push_back(std::move(options));
+  return RenderGraphPass{static_cast<std::uint32_t>(passes_.size() - 1)};
+}
+
+RenderGraph::CompiledResources RenderGraph::Compile() {
+  auto previous = std::move(compiled_);
+  compiled_ = CompiledResources{};
+  compiledPasses_.clear();
+  finalBarriers_ = BarrierBatch{};
+  stats_ = RenderGraphStats{};
+
+  // 1) Culling and the lifetimes of the resources in the kept passes:
+  const auto kept = CullPasses();
+  compiledPassIndices_.assign(passes_.size(), ~0U);
+  std::vector<Lifetime> lifetimes(resources_.size());
+  for (std::uint32_t i{0}; i < passes_.size(); ++i) {
+    if (!kept[i]) {
+      ++stats_.culledPassCount;
+      continue;
+    }
+    const auto compiledIndex =
+        static_cast<std::uint32_t>(compiledPasses_.size());
+    compiledPassIndices_[i] = compiledIndex;
+    CompiledPass compiledPass{};
+    compiledPass.pass = i;
+    compiledPasses_.push_back(std::move(compiledPass));
+    for (const auto &access : passes_[i].accesses) {
+      auto &lifetime = lifetimes[access.resource.index];
+      lifetime.first = std::min(lifetime.first, compiledIndex);
+      lifetime.last = compiledIndex;
+      lifetime.usage |= GetUsageInfo(access.usage).imageUsage;
+    }
+  }
+  stats_.passCount = static_cast<std::uint32_t>(compiledPasses_.size());
+
+  // 2) Transient images and memory aliasing:
+  const auto predecessors = CreateTransientImages(lifetimes);
+
+  // 3) Load and store operations of the attachments. Content is stored if a
+  // later pass or the application reads it, it is loaded if it has been
+  // written before:
+  std::vector<std::vector<bool>> stores(compiledPasses_.size());
+  std::vector<bool> readLater(resources_.size(), false);
+  for (std::uint32_t i{0}; i < resources_.size(); ++i) {
+    readLater[i] = resources_[i].type != ResourceType::TransientImage;
+  }
+  for (auto i = compiledPasses_.size(); i-- > 0;) {
+    const auto &accesses = passes_[compiledPasses_[i].pass].accesses;
+    stores[i].resize(accesses.size());
+    for (std::size_t j{0}; j < accesses.size(); ++j) {
+      const auto index = accesses[j].resource.index;
+      stores[i][j] = resources_[index].type != ResourceType::TransientImage ||
+                     readLater[index];
+      if (accesses[j].clear) {
+        readLater[index] = false;
+      }
+      if (ReadsContent(accesses[j])) {
+        readLater[index] = true;
+      }
+    }
+  }
+  std::vector<bool> defined(resources_.size(), false);
+  for (std::uint32_t i{0}; i < resources_.size(); ++i) {
+    defined[i] = resources_[i].type == ResourceType::Buffer ||
+                 (resources_[i].type == ResourceType::Image &&
+                  resources_[i].initialLayout != VK_IMAGE_LAYOUT_UNDEFINED);
+  }
+  for (std::size_t i{0}; i < compiledPasses_.size(); ++i) {
+    const auto &pass = passes_[compiledPasses_[i].pass];
+    std::vector<bool> loads(pass.accesses.size());
+    for (std::size_t j{0}; j < pass.accesses.size(); ++j) {
+      const auto &access = pass.accesses[j];
+      const auto index = access.resource.index;
+      if (ReadsContent(access) && !defined[index]) {
+        throw std::runtime_error("failed to compile render graph, a pass "
+                                 "reads an image before it is written!");
+      }
+      loads[j] = ReadsContent(access);
+      defined[index] = defined[index] || WritesContent(access);
+    }
+    if (pass.type == RenderGraphPassType::Graphics) {
+      CreatePassRenderPass(pass, loads, stores[i], compiledPasses_[i]);
+    }
+  }
+
+  // 4) Barriers. The graph runs every frame, so the resources start in the
+  // state the previous frame leaves them in: the passes are walked once for
+  // the end states, and once more from them for the recorded barriers.
+  std::vector<ResourceState> states(resources_.size());
+  for (std::uint32_t i{0}; i < resources_.size(); ++i) {
+    states[i].layout = resources_[i].initialLayout;
+  }
+  WalkPasses(states, false);
+  auto startStates = states;
+  for (std::uint32_t i{0}; i < resources_.size(); ++i) {
+    auto &state = startStates[i];
+    const auto &resource = resources_[i];
+    if (resource.type == ResourceType::TransientImage) {
+      // The image starts once the previous image of its memory has ended, the
+      // content is discarded:
+      if (!lifetimes[i].IsUsed()) {
+        continue;
+      }
+      const auto &end = states[predecessors[i]];
+      state = ResourceState{};
+      state.writeStages = end.writeStages | end.readStages;
+      state.writeAccess = end.writeAccess;
+    } else if (resource.type == ResourceType::Image) {
+      state.layout = resource.initialLayout;
+    }
+  }
+  WalkPasses(startStates, true);
+  return previous;
+}
+
+void RenderGraph::DestroyCompiled(const CompiledResources &resources) {
+  for (const auto &framebuffer : resources.framebuffers) {
+    vkDestroyFramebuffer(device_, framebuffer, nullptr);
+  }
+  for (const auto &renderPass : resources.renderPasses) {
+    vkDestroyRenderPass(device_, renderPass, nullptr);
+  }
+  for (const auto &imageView : resources.imageViews) {
+    vkDestroyImageView(device_, imageView, nullptr);
+  }
+  for (const auto &image : resources.images) {
+    vkDestroyImage(device_, image, nullptr);
+  }
+  for (const auto &allocation : resources.allocations) {
+    allocator_->Free(allocation);
+  }
+}
+
+void RenderGraph::Execute(VkCommandBuffer commandBuffer) {
+  for (auto &compiledPass : compiledPasses_) {
+    RecordBarriers(commandBuffer, compiledPass.barriers);
+    const auto &pass = passes_[compiledPass.pass];
+    RenderGraphPassContext context{};
+    context.commandBuffer = commandBuffer;
+    context.renderPass = compiledPass.renderPass;
+    context.extent = compiledPass.extent;
+    if (compiledPass.renderPass == VK_NULL_HANDLE) {
+      if (pass.record) {
+        pass.record(context);
+      }
+      continue;
+    }
+
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = compiledPass.renderPass;
+    renderPassInfo.framebuffer = GetFramebuffer(compiledPass);
+    renderPassInfo.renderArea.extent = compiledPass.extent;
+    renderPassInfo.clearValueCount =
+        static_cast<std::uint32_t>(compiledPass.clearValues.size());
+    renderPassInfo.pClearValues = compiledPass.clearValues.data();
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
+                         VK_SUBPASS_CONTENTS_INLINE);
+    if (pass.record) {
+      pass.record(context);
+    }
+    vkCmdEndRenderPass(commandBuffer);
+  }
+  RecordBarriers(commandBuffer, finalBarriers_);
+}
+
+VkImage RenderGraph::GetImage(RenderGraphResource resource) const {
+  return resources_.at(resource.index).image;
+}
+
+VkImageView RenderGraph::GetImageView(RenderGraphResource resource) const {
+  return resources_.at(resource.index).imageView;
+}
+
+VkBuffer RenderGraph::GetBuffer(RenderGraphResource resource) const {
+  return resources_.at(resource.index).buffer;
+}
+
+VkRenderPass RenderGraph::GetRenderPass(RenderGraphPass pass) const {
+  if (IsCulled(pass)) {
+    return VK_NULL_HANDLE;
+  }
+  return compiledPasses_[compiledPassIndices_[pass.index]].renderPass;
+}
+
+bool RenderGraph::IsCulled(RenderGraphPass pass) const {
+  return pass.index >= compiledPassIndices_.size() ||
+         compiledPassIndices_[pass.index] == ~0U;
+}
+
+std::vector<bool> RenderGraph::CullPasses() const {
+  // Walking backwards, a pass is kept if a kept pass or the application
+  // reads what it writes:
+  std::vector<bool> kept(passes_.size(), false);
+  std::vector<bool> needed(resources_.size(), false);
+  for (std::uint32_t i{0}; i < resources_.size(); ++i) {
+    needed[i] = resources_[i].type != ResourceType::TransientImage;
+  }
+  for (auto i = passes_.size(); i-- > 0;) {
+    const auto &pass = passes_[i];
+    kept[i] = pass.sideEffects;
+    for (const auto &access : pass.accesses) {
+      const auto index = access.resource.index;
+      kept[i] = kept[i] || (WritesContent(access) && needed[index]);
+    }
+    if (!kept[i]) {
+      continue;
+    }
+    for (const auto &access : pass.accesses) {
+      const auto index = access.resource.index;
+      // A cleared transient image doesn't depend on earlier writes:
+      if (access.clear &&
+          resources_[index].type == ResourceType::TransientImage) {
+        needed[index] = false;
+      }
+      if (ReadsContent(access)) {
+        needed[index] = true;
+      }
+    }
+  }
+  return kept;
+}
+
+std::vector<std::uint32_t>
+RenderGraph::CreateTransientImages(const std::vector<Lifetime> &lifetimes) {
+  std::vector<std::uint32_t> images{};
+  std::vector<VkMemoryRequirements> requirements(resources_.size());
+  for (std::uint32_t i{0}; i < resources_.size(); ++i) {
+    auto &resource = resources_[i];
+    if (resource.type != ResourceType::TransientImage) {
+      continue;
+    }
+    resource.image = VK_NULL_HANDLE;
+    resource.imageView = VK_NULL_HANDLE;
+    if (!lifetimes[i].IsUsed()) {
+      continue;
+    }
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = resource.format;
+    imageInfo.extent = VkExtent3D{resource.extent.width,
+                                  resource.extent.height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = lifetimes[i].usage;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (vkCreateImage(device_, &imageInfo, nullptr, &resource.image) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create render graph image!");
+    }
+    compiled_.images.push_back(resource.image);
+    vkGetImageMemoryRequirements(device_, resource.image, &requirements[i]);
+    // Padded, so that the buffers sub-allocated next to the aliased memory
+    // don't share a bufferImageGranularity page with the image:
+    requirements[i].alignment =
+        std::max(requirements[i].alignment, granularity_);
+    requirements[i].size = AlignUp(requirements[i].size, granularity_);
+    stats_.unaliasedMemorySize += requirements[i].size;
+    images.push_back(i);
+  }
+  stats_.transientImageCount = static_cast<std::uint32_t>(images.size());
+
+  // Greedy aliasing, largest images first: an image joins the first memory
+  // whose images all have disjoint lifetimes with it.
+  struct SharedMemory final {
+    VkMemoryRequirements requirements{};
+    std::vector<std::uint32_t> images{};
+  };
+  std::sort(images.begin(), images.end(),
+            [&requirements](std::uint32_t lhs, std::uint32_t rhs) {
+              return requirements[lhs].size > requirements[rhs].size;
+            });
+  std::vector<SharedMemory> memories{};
+  for (const auto image : images) {
+    const auto &lifetime = lifetimes[image];
+    auto memory = std::find_if(
+        memories.begin(), memories.end(), [&](const SharedMemory &shared) {
+          if ((shared.requirements.memoryTypeBits &
+               requirements[image].memoryTypeBits) == 0) {
+            return false;
+          }
+          return std::all_of(
+              shared.images.begin(), shared.images.end(),
+              [&](std::uint32_t other) {
+                return lifetimes[other].last < lifetime.first ||
+                       lifetime.last < lifetimes[other].first;
+              });
+        });
+    if (memory == memories.end()) {
+      memories.push_back(SharedMemory{requirements[image], {image}});
+      continue;
+    }
+    memory->requirements.size =
+        std::max(memory->requirements.size, requirements[image].size);
+    memory->requirements.alignment =
+        std::max(memory->requirements.alignment, requirements[image].alignment);
+    memory->requirements.memoryTypeBits &= requirements[image].memoryTypeBits;
+    memory->images.push_back(image);
+  }
+
+  std::vector<std::uint32_t> predecessors(resources_.size(), 0);
+  for (auto &memory : memories) {
+    const auto allocation = allocator_->Allocate(
+        memory.requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    compiled_.allocations.push_back(allocation);
+    stats_.transientMemorySize += memory.requirements.size;
+    std::sort(memory.images.begin(), memory.images.end(),
+              [&lifetimes](std::uint32_t lhs, std::uint32_t rhs) {
+                return lifetimes[lhs].first < lifetimes[rhs].first;
+              });
+    for (std::size_t i{0}; i < memory.images.size(); ++i) {
+      const auto image = memory.images[i];
+      predecessors[image] =
+          memory.images[(i + memory.images.size() - 1) % memory.images.size()];
+      auto &resource = resources_[image];
+      vkBindImageMemory(device_, resource.image, allocation.memory,
+                        allocation.offset);
+
+      VkImageViewCreateInfo viewInfo{};
+      viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+      viewInfo.image = resource.image;
+      viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+      viewInfo.format = resource.format;
+      viewInfo.subresourceRange.aspectMask = resource.aspectMask;
+      viewInfo.subresourceRange.levelCount = 1;
+      viewInfo.subresourceRange.layerCount = 1;
+      if (vkCreateImageView(device_, &viewInfo, nullptr,
+                            &resource.imageView) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render graph image view!");
+      }
+      compiled_.imageViews.push_back(resource.imageView);
+    }
+  }
+  return predecessors;
+}
+
+void RenderGraph::AddBarrier(std::uint32_t resource, bool image,
+                             RenderGraphUsage usage, BarrierBatch &batch,
+                             ResourceState &state) {
+  const auto info = GetUsageInfo(usage);
+  const bool transition = image && state.layout != info.layout;
+  if (transition || info.writeAccess != 0) {
+    // Writes and layout transitions wait for all the earlier accesses, the
+    // earlier writes have to be available:
+    auto srcStages = state.writeStages | state.readStages;
+    if (srcStages != 0 || transition) {
+      batch.srcStages |=
+          srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+      batch.dstStages |= info.stages;
+      if (transition) {
+        batch.imageBarriers.push_back(ImageBarrier{
+            resource, state.writeAccess, info.access, state.layout,
+            info.layout});
+      } else {
+        batch.srcAccess |= state.writeAccess;
+        batch.dstAccess |= info.access;
+      }
+    }
+    // A layout transition is a write as well:
+    state.layout = info.layout;
+    state.writeStages = info.stages;
+    state.writeAccess = info.writeAccess;
+    state.visibleStages = info.stages;
+    state.visibleAccess = info.access;
+    state.readStages = info.writeAccess != 0 ? 0 : info.stages;
+    return;
+  }
+
+  // Reads only wait if the last write is not yet visible to them:
+  if (state.writeStages != 0 &&
+      ((info.stages & ~state.visibleStages) != 0 ||
+       (info.access & ~state.visibleAccess) != 0)) {
+    batch.srcStages |= state.writeStages;
+    batch.dstStages |= info.stages;
+    batch.srcAccess |= state.writeAccess;
+    batch.dstAccess |= info.access;
+    state.visibleStages |= info.stages;
+    state.visibleAccess |= info.access;
+  }
+  state.readStages |= info.stages;
+}
+
+void RenderGraph::AddFinalBarriers(BarrierBatch &batch,
+                                   std::vector<ResourceState> &states) const {
+  for (std::uint32_t i{0}; i < resources_.size(); ++i) {
+    const auto &resource = resources_[i];
+    auto &state = states[i];
+    if (resource.type != ResourceType::Image ||
+        resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED ||
+        state.layout == resource.finalLayout) {
+      continue;
+    }
+    // Whatever uses the image next, e.g. the presentation, synchronizes
+    // with the end of the command buffer:
+    const auto srcStages = state.writeStages | state.readStages;
+    batch.srcStages |=
+        srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    batch.dstStages |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    batch.imageBarriers.push_back(ImageBarrier{
+        i, state.writeAccess, 0, state.layout, resource.finalLayout});
+    state = ResourceState{};
+    state.layout = resource.finalLayout;
+    state.writeStages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+  }
+}
+
+void RenderGraph::WalkPasses(std::vector<ResourceState> &states,
+                             bool record) {
+  for (auto &compiledPass : compiledPasses_) {
+    BarrierBatch batch{};
+    for (const auto &access : passes_[compiledPass.pass].accesses) {
+      const auto index = access.resource.index;
+      AddBarrier(index, resources_[index].type != ResourceType::Buffer,
+                 access.usage, batch, states[index]);
+    }
+    if (record) {
+      stats_.barrierCount += batch.IsEmpty() ? 0 : 1;
+      stats_.imageBarrierCount +=
+          static_cast<std::uint32_t>(batch.imageBarriers.size());
+      compiledPass.barriers = std::move(batch);
+    }
+  }
+  BarrierBatch batch{};
+  AddFinalBarriers(batch, states);
+  if (record) {
+    stats_.barrierCount += batch.IsEmpty() ? 0 : 1;
+    stats_.imageBarrierCount +=
+        static_cast<std::uint32_t>(batch.imageBarriers.size());
+    finalBarriers_ = std::move(batch);
+  }
+}
+
+void RenderGraph::CreatePassRenderPass(const RenderGraphPassOptions &pass,
+                                       const std::vector<bool> &load,
+                                       const std::vector<bool> &store,
+                                       CompiledPass &compiledPass) {
+  // The barriers in front of the pass do the layout transitions, the
+  // attachments stay in the layouts of their accesses:
+  std::vector<VkAttachmentDescription> attachments{};
+  std::vector<VkAttachmentReference> colorReferences{};
+  VkAttachmentReference depthReference{};
+  bool depth{false};
+  for (std::size_t i{0}; i < pass.accesses.size(); ++i) {
+    const auto &access = pass.accesses[i];
+    if (!IsAttachment(access.usage)) {
+      continue;
+    }
+    const auto &resource = resources_[access.resource.index];
+    const auto layout = GetUsageInfo(access.usage).layout;
+    VkAttachmentDescription attachment{};
+    attachment.format = resource.format;
+    attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    attachment.loadOp = access.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR
+                        : load[i]    ? VK_ATTACHMENT_LOAD_OP_LOAD
+                                     : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachment.storeOp = store[i] ? VK_ATTACHMENT_STORE_OP_STORE
+                                  : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachment.initialLayout = layout;
+    attachment.finalLayout = layout;
+    const VkAttachmentReference reference{
+        static_cast<std::uint32_t>(attachments.size()), layout};
+    if (access.usage == RenderGraphUsage::ColorAttachment) {
+      colorReferences.push_back(reference);
+    } else if (depth) {
+      throw std::runtime_error("failed to compile pass with two depth "
+                               "attachments!");
+    } else {
+      depthReference = reference;
+      depth = true;
+    }
+    attachments.push_back(attachment);
+    compiledPass.attachments.push_back(access.resource.index);
+    compiledPass.clearValues.push_back(access.clearValue);
+    if (compiledPass.extent.width == 0) {
+      compiledPass.extent = resource.extent;
+    }
+  }
+  if (attachments.empty()) {
+    throw std::runtime_error("failed to compile graphics pass without "
+                             "attachments!");
+  }
+
+  VkSubpassDescription subpass{};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount =
+      static_cast<std::uint32_t>(colorReferences.size());
+  subpass.pColorAttachments = colorReferences.data();
+  subpass.pDepthStencilAttachment = depth ? &depthReference : nullptr;
+  VkRenderPassCreateInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.attachmentCount =
+      static_cast<std::uint32_t>(attachments.size());
+  renderPassInfo.pAttachments = attachments.data();
+  renderPassInfo.subpassCount = 1;
+  renderPassInfo.pSubpasses = &subpass;
+  if (vkCreateRenderPass(device_, &renderPassInfo, nullptr,
+                         &compiledPass.renderPass) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create render graph render pass!");
+  }
+  compiled_.renderPasses.push_back(compiledPass.renderPass);
+}
+
+VkFramebuffer RenderGraph::GetFramebuffer(CompiledPass &compiledPass) {
+  std::vector<VkImageView> views{};
+  for (const auto attachment : compiledPass.attachments) {
+    views.push_back(resources_[attachment].imageView);
+  }
+  for (const auto &[cachedViews, framebuffer] : compiledPass.framebuffers) {
+    if (cachedViews == views) {
+      return framebuffer;
+    }
+  }
+
+  VkFramebufferCreateInfo framebufferInfo{};
+  framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+  framebufferInfo.renderPass = compiledPass.renderPass;
+  framebufferInfo.attachmentCount = static_cast<std::uint32_t>(views.size());
+  framebufferInfo.pAttachments = views.data();
+  framebufferInfo.width = compiledPass.extent.width;
+  framebufferInfo.height = compiledPass.extent.height;
+  framebufferInfo.layers = 1;
+  VkFramebuffer framebuffer{VK_NULL_HANDLE};
+  if (vkCreateFramebuffer(device_, &framebufferInfo, nullptr, &framebuffer) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create render graph framebuffer!");
+  }
+  compiled_.framebuffers.push_back(framebuffer);
+  compiledPass.framebuffers.emplace_back(std::move(views), framebuffer);
+  return framebuffer;
+}
+
+void RenderGraph::RecordBarriers(VkCommandBuffer commandBuffer,
+                                 const BarrierBatch &batch) const {
+  if (batch.IsEmpty()) {
+    return;
+  }
+  VkMemoryBarrier memoryBarrier{};
+  memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  memoryBarrier.srcAccessMask = batch.srcAccess;
+  memoryBarrier.dstAccessMask = batch.dstAccess;
+  const bool memory = batch.srcAccess != 0 || batch.dstAccess != 0;
+  std::vector<VkImageMemoryBarrier> imageBarriers{};
+  imageBarriers.reserve(batch.imageBarriers.size());
+  for (const auto &barrier : batch.imageBarriers) {
+    const auto &resource = resources_[barrier.resource];
+    VkImageMemoryBarrier imageBarrier{};
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier.srcAccessMask = barrier.srcAccess;
+    imageBarrier.dstAccessMask = barrier.dstAccess;
+    imageBarrier.oldLayout = barrier.oldLayout;
+    imageBarrier.newLayout = barrier.newLayout;
+    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image = resource.image;
+    imageBarrier.subresourceRange.aspectMask = resource.aspectMask;
+    imageBarrier.subresourceRange.levelCount = 1;
+    imageBarrier.subresourceRange.layerCount = 1;
+    imageBarriers.push_back(imageBarrier);
+  }
+  vkCmdPipelineBarrier(
+      commandBuffer, batch.srcStages, batch.dstStages, 0, memory ? 1 : 0,
+      memory ? &memoryBarrier : nullptr, 0, nullptr,
+      static_cast<std::uint32_t>(imageBarriers.size()), imageBarriers.data());
+}
+
+} // namespace render
@@ -0,0 +1,349 @@
+#pragma once
+
+#include "render/memory_allocator.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace render {
+
+/// Index of an image or buffer declared in a RenderGraph.
+struct RenderGraphResource final {
+  std::uint32_t index{~0U};
+
+  bool IsNull() const { return index == ~0U; }
+};
+
+/// How a pass accesses a resource, it determines the pipeline stages, the
+/// access types and the image layout of the access.
+enum class RenderGraphUsage : std::uint8_t {
+  /// Image attachments of graphics passes.
+  ColorAttachment,
+  DepthAttachment,
+  /// Depth test without depth writes.
+  DepthReadOnly,
+  /// Sampled images.
+  FragmentSampled,
+  ComputeSampled,
+  /// Storage images and buffers of compute passes.
+  ComputeRead,
+  ComputeWrite,
+  /// Buffers read by draws.
+  IndirectRead,
+  VertexRead,
+  VertexShaderRead,
+  FragmentShaderRead,
+  /// Copies.
+  TransferSrc,
+  TransferDst
+};
+
+struct RenderGraphAccess final {
+  RenderGraphResource resource{};
+  RenderGraphUsage usage{};
+  /// Attachments are cleared at the start of the render pass, otherwise
+  /// their content is loaded and the access reads it.
+  bool clear{false};
+  VkClearValue clearValue{};
+};
+
+/// Image created and owned by the graph. Transient images whose lifetimes do
+/// not overlap share memory.
+struct RenderGraphImageOptions final {
+  VkFormat format{};
+  VkExtent2D extent{};
+  VkImageAspectFlags aspectMask{VK_IMAGE_ASPECT_COLOR_BIT};
+};
+
+/// Image owned by the application, e.g. the frame image of the Context.
+struct RenderGraphImportedImageOptions final {
+  /// May be replaced before every Execute with SetImportedImage.
+  VkImage image{VK_NULL_HANDLE};
+  VkImageView imageView{VK_NULL_HANDLE};
+  VkFormat format{};
+  VkExtent2D extent{};
+  VkImageAspectFlags aspectMask{VK_IMAGE_ASPECT_COLOR_BIT};
+  /// Layout the image is in when the graph starts, UNDEFINED discards the
+  /// content.
+  VkImageLayout initialLayout{VK_IMAGE_LAYOUT_UNDEFINED};
+  /// Layout the image is left in, e.g. PRESENT_SRC_KHR. UNDEFINED keeps the
+  /// layout of the last access, which then has to be the initial layout.
+  VkImageLayout finalLayout{VK_IMAGE_LAYOUT_UNDEFINED};
+};
+
+/// Buffer owned by the application.
+struct RenderGraphImportedBufferOptions final {
+  VkBuffer buffer{VK_NULL_HANDLE};
+};
+
+enum class RenderGraphPassType : std::uint8_t {
+  /// Runs in a render pass over its attachment accesses.
+  Graphics,
+  Compute,
+  Transfer
+};
+
+/// Command buffer and render pass a pass records into.
+struct RenderGraphPassContext final {
+  VkCommandBuffer commandBuffer{VK_NULL_HANDLE};
+  /// Render pass instance of graphics passes, VK_NULL_HANDLE otherwise.
+  VkRenderPass renderPass{VK_NULL_HANDLE};
+  VkExtent2D extent{};
+};
+
+struct RenderGraphPassOptions final {
+  /// Pass name with static storage duration.
+  const char *name{nullptr};
+  RenderGraphPassType type{RenderGraphPassType::Graphics};
+  /// Every resource the pass reads or writes.
+  std::vector<RenderGraphAccess> accesses{};
+  /// Keeps the pass even if nothing reads its writes, e.g. it writes host
+  /// visible buffers.
+  bool sideEffects{false};
+  /// Records the pass, inside the render pass instance for graphics passes.
+  std::function<void(const RenderGraphPassContext &)> record{};
+};
+
+/// Index of a pass declared in a RenderGraph.
+struct RenderGraphPass final {
+  std::uint32_t index{~0U};
+};
+
+struct RenderGraphStats final {
+  std::uint32_t passCount{};
+  std::uint32_t culledPassCount{};
+  /// Recorded vkCmdPipelineBarrier calls and image layout transitions.
+  std::uint32_t barrierCount{};
+  std::uint32_t imageBarrierCount{};
+  std::uint32_t transientImageCount{};
+  /// Memory of the transient images with and without aliasing.
+  VkDeviceSize transientMemorySize{};
+  VkDeviceSize unaliasedMemorySize{};
+};
+
+struct RenderGraphOptions final {
+  VkPhysicalDevice physicalDevice{VK_NULL_HANDLE};
+  VkDevice device{VK_NULL_HANDLE};
+  MemoryAllocator *allocator{nullptr};
+};
+
+/// Frame graph of passes declaring the resources they read and write.
+///
+/// The passes are declared in execution order, so every read refers to the
+/// writes of earlier passes. Compile then
+///
+/// - culls the passes whose writes are never read by a pass that is kept.
+///   Passes writing imported resources or with side effects are always kept;
+/// - computes the barriers in front of every pass: one vkCmdPipelineBarrier
+///   with a global memory barrier for all the hazards and image barriers for
+///   the layout transitions only. Reads of data that is already visible to
+///   their stages need no barrier;
+/// - creates the transient images and aliases them: images whose pass ranges
+///   do not overlap are bound to the same memory, and the first access of an
+///   image waits for the last accesses of the previous one;
+/// - creates a render pass for every graphics pass. Attachments are loaded
+///   only if their content is used and stored only if a later pass or the
+///   application reads them.
+///
+/// The compiled graph is executed every frame on the same queue. Resources
+/// persist across frames, so the first accesses of a frame also wait for the
+/// last accesses of the previous one, the same as for the depth image shared
+/// by the frames in flight.
+///
+/// Render passes of graphics passes stay compatible across recompiles with
+/// the same attachment formats, pipelines created for them remain valid.
+class RenderGraph final {
+public:
+  /// Objects created by Compile, destroyed once no frame uses them.
+  struct CompiledResources final {
+    std::vector<VkImage> images{};
+    std::vector<VkImageView> imageViews{};
+    std::vector<Allocation> allocations{};
+    std::vector<VkRenderPass> renderPasses{};
+    std::vector<VkFramebuffer> framebuffers{};
+  };
+
+  void Initialize(const RenderGraphOptions &options);
+
+  /// Destroys the compiled resources, the device has to be idle.
+  void Cleanup();
+
+  /// Removes the declared passes and resources, e.g. to declare the graph of
+  /// a new swapchain extent. The graph has to be compiled again before the
+  /// next Execute.
+  void Reset();
+
+  RenderGraphResource CreateImage(const RenderGraphImageOptions &options);
+  RenderGraphResource
+  ImportImage(const RenderGraphImportedImageOptions &options);
+  RenderGraphResource
+  ImportBuffer(const RenderGraphImportedBufferOptions &options);
+
+  /// Replaces the imported image, e.g. with the swapchain image of the frame.
+  /// It must have the declared format and extent.
+  void SetImportedImage(RenderGraphResource resource, VkImage image,
+                        VkImageView imageView);
+
+  /// Replaces the imported buffer.
+  void SetImportedBuffer(RenderGraphResource resource, VkBuffer buffer);
+
+  RenderGraphPass AddPass(RenderGraphPassOptions options);
+
+  /// Compiles the declared graph.
+  ///
+  /// @return Resources of the previous compile, to be destroyed with
+  /// DestroyCompiled once the frames using them have completed.
+  CompiledResources Compile();
+
+  void DestroyCompiled(const CompiledResources &resources);
+
+  /// Records the passes that are kept together with their barriers.
+  void Execute(VkCommandBuffer commandBuffer);
+
+  /// Returns the image or view of a compiled or imported image.
+  VkImage GetImage(RenderGraphResource resource) const;
+  VkImageView GetImageView(RenderGraphResource resource) const;
+  VkBuffer GetBuffer(RenderGraphResource resource) const;
+
+  /// Returns the render pass of a compiled graphics pass, VK_NULL_HANDLE if
+  /// the pass has been culled.
+  VkRenderPass GetRenderPass(RenderGraphPass pass) const;
+
+  bool IsCulled(RenderGraphPass pass) const;
+
+  const RenderGraphStats &GetStats() const { return stats_; }
+
+private:
+  enum class ResourceType : std::uint8_t { TransientImage, Image, Buffer };
+
+  struct Resource final {
+    ResourceType type{};
+    VkImage image{VK_NULL_HANDLE};
+    VkImageView imageView{VK_NULL_HANDLE};
+    VkBuffer buffer{VK_NULL_HANDLE};
+    VkFormat format{};
+    VkExtent2D extent{};
+    VkImageAspectFlags aspectMask{};
+    VkImageLayout initialLayout{VK_IMAGE_LAYOUT_UNDEFINED};
+    VkImageLayout finalLayout{VK_IMAGE_LAYOUT_UNDEFINED};
+  };
+
+  /// Synchronization state of a resource while the passes are walked.
+  struct ResourceState final {
+    VkImageLayout layout{VK_IMAGE_LAYOUT_UNDEFINED};
+    /// Stages and accesses of the last write or layout transition.
+    VkPipelineStageFlags writeStages{};
+    VkAccessFlags writeAccess{};
+    /// Stages and accesses the last write has been made visible to.
+    VkPipelineStageFlags visibleStages{};
+    VkAccessFlags visibleAccess{};
+    /// Stages of the reads since the last write.
+    VkPipelineStageFlags readStages{};
+  };
+
+  /// Range of compiled passes accessing a resource.
+  struct Lifetime final {
+    std::uint32_t first{~0U};
+    std::uint32_t last{};
+    VkImageUsageFlags usage{};
+
+    bool IsUsed() const { return first != ~0U; }
+  };
+
+  /// Image layout transition, the image is looked up at Execute.
+  struct ImageBarrier final {
+    std::uint32_t resource{};
+    VkAccessFlags srcAccess{};
+    VkAccessFlags dstAccess{};
+    VkImageLayout oldLayout{};
+    VkImageLayout newLayout{};
+  };
+
+  /// Barriers recorded by a single vkCmdPipelineBarrier.
+  struct BarrierBatch final {
+    VkPipelineStageFlags srcStages{};
+    VkPipelineStageFlags dstStages{};
+    VkAccessFlags srcAccess{};
+    VkAccessFlags dstAccess{};
+    std::vector<ImageBarrier> imageBarriers{};
+
+    bool IsEmpty() const { return srcStages == 0 && dstStages == 0; }
+  };
+
+  struct CompiledPass final {
+    std::uint32_t pass{};
+    BarrierBatch barriers{};
+    VkRenderPass renderPass{VK_NULL_HANDLE};
+    VkExtent2D extent{};
+    /// Attachment resources and clear values in attachment order.
+    std::vector<std::uint32_t> attachments{};
+    std::vector<VkClearValue> clearValues{};
+    /// Framebuffers by attachment views, imported views may change.
+    std::vector<std::pair<std::vector<VkImageView>, VkFramebuffer>>
+        framebuffers{};
+  };
+
+  /// Marks the passes that are kept.
+  std::vector<bool> CullPasses() const;
+
+  /// Creates the transient images of the kept passes and binds the images
+  /// with disjoint lifetimes to shared memory.
+  ///
+  /// @return Image that used the memory of every transient image before it,
+  /// the last one of the memory for the first one.
+  std::vector<std::uint32_t>
+  CreateTransientImages(const std::vector<Lifetime> &lifetimes);
+
+  /// Adds the barrier of the access to the batch and updates the state.
+  static void AddBarrier(std::uint32_t resource, bool image,
+                         RenderGraphUsage usage, BarrierBatch &batch,
+                         ResourceState &state);
+
+  /// Adds the final layout transitions of the imported images.
+  void AddFinalBarriers(BarrierBatch &batch,
+                        std::vector<ResourceState> &states) const;
+
+  /// Computes the barriers of the compiled passes.
+  ///
+  /// @param states  Resource states at the start, the end states on return.
+  /// @param record  Stores the barriers, otherwise only the states are
+  /// computed.
+  void WalkPasses(std::vector<ResourceState> &states, bool record);
+
+  /// Creates the render pass of a graphics pass.
+  ///
+  /// @param load  Per access, the attachment content is used by the pass.
+  /// @param store  Per access, the content is read after the pass.
+  void CreatePassRenderPass(const RenderGraphPassOptions &pass,
+                            const std::vector<bool> &load,
+                            const std::vector<bool> &store,
+                            CompiledPass &compiledPass);
+
+  VkFramebuffer GetFramebuffer(CompiledPass &compiledPass);
+
+  void RecordBarriers(VkCommandBuffer commandBuffer,
+                      const BarrierBatch &batch) const;
+
+  VkDevice device_{VK_NULL_HANDLE};
+  MemoryAllocator *allocator_{nullptr};
+  /// bufferImageGranularity of the device, the transient images are padded
+  /// to it.
+  VkDeviceSize granularity_{1};
+
+  std::vector<Resource> resources_{};
+  std::vector<RenderGraphPassOptions> passes_{};
+
+  /// Compiled graph.
+  std::vector<CompiledPass> compiledPasses_{};
+  /// Compiled pass index of every declared pass, ~0U if it is culled.
+  std::vector<std::uint32_t> compiledPassIndices_{};
+  BarrierBatch finalBarriers_{};
+  CompiledResources compiled_{};
+  RenderGraphStats stats_{};
+};
+
+} // namespace render
@@ -0,0 +1,224 @@
+#include "render/shader_library.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <system_error>
+
+namespace render {
+
+namespace {
+
+constexpr std::uint32_t kSpirvMagic{0x07230203};
+
+/// FNV-1a over the 32-bit words of the code.
+std::uint64_t HashCode(Span<const char> code) {
+  std::uint64_t hash{14695981039346656037ULL};
+  for (std::size_t i{0}; i + 4 <= code.size(); i += 4) {
+    std::uint32_t word{};
+    std::memcpy(&word, code.data() + i, sizeof(word));
+    hash = (hash ^ word) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+/// Returns false for files that are no complete SPIR-V, e.g. while the
+/// compiler is still writing them.
+bool IsSpirv(const std::vector<char> &code) {
+  if (code.size() < 20 || code.size() % 4 != 0) {
+    return false;
+  }
+  std::uint32_t magic{};
+  std::memcpy(&magic, code.data(), sizeof(magic));
+  return magic == kSpirvMagic;
+}
+
+} // namespace
+
+void ShaderLibrary::Initialize(const ShaderLibraryOptions &options) {
+  device_ = options.device;
+  hotReload_ = options.hotReload;
+  compiler_ = options.compiler;
+  pollInterval_ = options.pollInterval;
+  if (hotReload_) {
+    ThreadPoolOptions threadOptions{};
+    threadOptions.threadCount = 1;
+    reloadThread_.Initialize(threadOptions);
+  }
+}
+
+void ShaderLibrary::Cleanup() {
+  reloadThread_.Cleanup();
+  shaders_.clear();
+
+  std::lock_guard<std::mutex> lock{mutex_};
+  for (const auto &[hash, module] : modules_) {
+    vkDestroyShaderModule(device_, module.module, nullptr);
+  }
+  modules_.clear();
+  std::cout << "Shader library: " << stats_.cacheHits << " of "
+            << stats_.moduleCount + stats_.cacheHits
+            << " modules shared, " << stats_.reloadCount << " reloads"
+            << std::endl;
+  stats_ = ShaderLibraryStats{};
+}
+
+VkShaderModule ShaderLibrary::CreateModule(Span<const char> code) {
+  const auto hash = HashCode(code);
+  std::lock_guard<std::mutex> lock{mutex_};
+  const auto range = modules_.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    const auto &cached = it->second.code;
+    if (cached.size() == code.size() &&
+        std::memcmp(cached.data(), code.data(), code.size()) == 0) {
+      ++stats_.cacheHits;
+      return it->second.module;
+    }
+  }
+
+  VkShaderModuleCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  createInfo.codeSize = code.size();
+  // Heap buffers and file mappings are 4-byte aligned:
+  createInfo.pCode = reinterpret_cast<const std::uint32_t *>(code.data());
+  VkShaderModule shaderModule{VK_NULL_HANDLE};
+  if (vkCreateShaderModule(device_, &createInfo, nullptr, &shaderModule) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create shader module!");
+  }
+  modules_.emplace(
+      hash,
+      Module{std::vector<char>(code.data(), code.data() + code.size()),
+             shaderModule});
+  ++stats_.moduleCount;
+  return shaderModule;
+}
+
+ShaderHandle ShaderLibrary::Load(const ShaderFileOptions &options) {
+  auto reload = ReloadShader(compiler_, options, false);
+  if (reload.code.empty()) {
+    throw std::runtime_error("failed to load shader " + options.spirvPath +
+                             "!");
+  }
+  Shader shader{};
+  shader.files = options;
+  shader.module = CreateModule(
+      Span<const char>{reload.code.data(), reload.code.size()});
+  shader.spirvTime = reload.spirvTime;
+  if (!options.sourcePath.empty()) {
+    std::error_code error{};
+    shader.sourceTime =
+        std::filesystem::last_write_time(options.sourcePath, error);
+  }
+  shaders_.push_back(std::move(shader));
+  return ShaderHandle{static_cast<std::uint32_t>(shaders_.size() - 1)};
+}
+
+std::vector<ShaderHandle> ShaderLibrary::Poll() {
+  std::vector<ShaderHandle> reloaded{};
+  if (!hotReload_) {
+    return reloaded;
+  }
+
+  // 1) Completed reloads replace the modules:
+  for (std::uint32_t i{0}; i < shaders_.size(); ++i) {
+    auto &shader = shaders_[i];
+    if (!shader.reload.valid() ||
+        shader.reload.wait_for(std::chrono::seconds{0}) !=
+            std::future_status::ready) {
+      continue;
+    }
+    const auto reload = shader.reload.get();
+    if (reload.code.empty()) {
+      std::lock_guard<std::mutex> lock{mutex_};
+      ++stats_.failedReloadCount;
+      continue;
+    }
+    shader.spirvTime = reload.spirvTime;
+    const auto module = CreateModule(
+        Span<const char>{reload.code.data(), reload.code.size()});
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      ++stats_.reloadCount;
+    }
+    if (module != shader.module) {
+      shader.module = module;
+      reloaded.push_back(ShaderHandle{i});
+      std::cout << "Shader library: Reloaded " << shader.files.spirvPath
+                << std::endl;
+    }
+  }
+
+  // 2) Changed files start new reloads, at most once per poll interval:
+  const auto now = std::chrono::steady_clock::now();
+  if (now - lastPoll_ < pollInterval_) {
+    return reloaded;
+  }
+  lastPoll_ = now;
+  for (auto &shader : shaders_) {
+    if (shader.reload.valid()) {
+      continue;
+    }
+    std::error_code error{};
+    bool compile{false};
+    if (!shader.files.sourcePath.empty() && !compiler_.empty()) {
+      const auto sourceTime =
+          std::filesystem::last_write_time(shader.files.sourcePath, error);
+      if (!error && sourceTime != shader.sourceTime) {
+        shader.sourceTime = sourceTime;
+        compile = true;
+      }
+    }
+    const auto spirvTime =
+        std::filesystem::last_write_time(shader.files.spirvPath, error);
+    if (compile || (!error && spirvTime != shader.spirvTime)) {
+      shader.reload = reloadThread_.Submit(
+          [compiler = compiler_, files = shader.files, compile] {
+            return ReloadShader(compiler, files, compile);
+          });
+    }
+  }
+  return reloaded;
+}
+
+ShaderLibraryStats ShaderLibrary::GetStats() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return stats_;
+}
+
+ShaderLibrary::Reload
+ShaderLibrary::ReloadShader(const std::string &compiler,
+                            const ShaderFileOptions &files, bool compile) {
+  if (compile) {
+    const auto command = compiler + " \"" + files.sourcePath + "\" -o \"" +
+                         files.spirvPath + "\"";
+    if (std::system(command.c_str()) != 0) {
+      std::cout << "Shader library: Failed to compile " << files.sourcePath
+                << ", keeping the previous module" << std::endl;
+      return Reload{};
+    }
+  }
+
+  // The time is taken before the read, a write during the read is picked up
+  // by the next poll:
+  Reload reload{};
+  std::error_code error{};
+  reload.spirvTime = std::filesystem::last_write_time(files.spirvPath, error);
+  std::ifstream file(files.spirvPath, std::ios::in | std::ios::binary);
+  if (error || !file.is_open()) {
+    return Reload{};
+  }
+  reload.code.assign(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+  if (!IsSpirv(reload.code)) {
+    std::cout << "Shader library: Ignoring " << files.spirvPath
+              << ", it is no complete SPIR-V" << std::endl;
+    return Reload{};
+  }
+  return reload;
+}
+
+} // namespace render
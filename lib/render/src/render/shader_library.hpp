@@ -0,0 +1,150 @@
+#pragma once
+
+#include "render/span.hpp"
+#include "render/thread_pool.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace render {
+
+/// Index of a shader loaded from a file by a ShaderLibrary.
+struct ShaderHandle final {
+  std::uint32_t index{~0U};
+
+  bool IsNull() const { return index == ~0U; }
+};
+
+struct ShaderLibraryOptions final {
+  VkDevice device{VK_NULL_HANDLE};
+  /// Watches the shader files and reloads them when they change.
+  bool hotReload{false};
+  /// Compiler run as `<compiler> <source> -o <spirv>` for edited GLSL
+  /// sources, e.g. glslc as in shaders/compile.sh. Empty reloads the SPIR-V
+  /// files only.
+  std::string compiler{"glslc"};
+  /// Minimum time between two checks of the watched files.
+  std::chrono::milliseconds pollInterval{250};
+};
+
+struct ShaderFileOptions final {
+  /// Compiled shader, loaded at once.
+  std::string spirvPath{};
+  /// GLSL source of the SPIR-V file, empty if it is compiled elsewhere.
+  std::string sourcePath{};
+};
+
+struct ShaderLibraryStats final {
+  /// Distinct shader modules created.
+  std::uint32_t moduleCount{};
+  /// Module requests served by an existing module with identical SPIR-V.
+  std::uint32_t cacheHits{};
+  std::uint32_t reloadCount{};
+  /// Reloads that kept the previous module, e.g. on a compile error.
+  std::uint32_t failedReloadCount{};
+};
+
+/// Shader module cache keyed by the SPIR-V content, with hot reload.
+///
+/// Modules are looked up by a hash of their code and compared byte by byte,
+/// so identical SPIR-V never becomes two modules, whichever file or caller
+/// it comes from. Modules are kept until Cleanup: pipelines still compiling
+/// may use a module that has been replaced, and reverting an edit reuses
+/// the earlier module.
+///
+/// With hot reload, Poll compares the modification times of the watched
+/// files. Changed sources are compiled and the SPIR-V is read on a
+/// background thread. The new module replaces the old one on the thread
+/// calling Poll, which does the rest at a frame boundary, e.g. recompiles
+/// the pipelines using the shader.
+class ShaderLibrary final {
+public:
+  /// Starts the reload thread if hot reload is enabled.
+  void Initialize(const ShaderLibraryOptions &options);
+
+  /// Waits for the running reloads and destroys all the modules, no
+  /// pipeline may still be compiling.
+  void Cleanup();
+
+  /// Returns the module of the SPIR-V, creating it if there is none yet.
+  ///
+  /// Thread-safe.
+  ///
+  /// @param code  Shader SPIR-V bytecode, 4-byte aligned.
+  VkShaderModule CreateModule(Span<const char> code);
+
+  /// Loads a shader file and watches it with hot reload, throws if the file
+  /// can't be read or is no SPIR-V.
+  ShaderHandle Load(const ShaderFileOptions &options);
+
+  /// Returns the current module of the shader.
+  VkShaderModule GetModule(ShaderHandle shader) const {
+    return shaders_.at(shader.index).module;
+  }
+
+  const std::string &GetPath(ShaderHandle shader) const {
+    return shaders_.at(shader.index).files.spirvPath;
+  }
+
+  /// Starts the reloads of changed files and applies the completed ones,
+  /// never blocks.
+  ///
+  /// @return Shaders whose module has been replaced since the last call.
+  std::vector<ShaderHandle> Poll();
+
+  ShaderLibraryStats GetStats() const;
+
+private:
+  using FileTime = std::filesystem::file_time_type;
+
+  struct Module final {
+    /// Copy of the code, compared on hash collisions.
+    std::vector<char> code{};
+    VkShaderModule module{VK_NULL_HANDLE};
+  };
+
+  /// Result of a background reload.
+  struct Reload final {
+    /// Empty if the compilation or the read failed.
+    std::vector<char> code{};
+    FileTime spirvTime{};
+  };
+
+  struct Shader final {
+    ShaderFileOptions files{};
+    VkShaderModule module{VK_NULL_HANDLE};
+    /// Modification times the module is up to date with.
+    FileTime spirvTime{};
+    FileTime sourceTime{};
+    std::future<Reload> reload{};
+  };
+
+  /// Compiles the source if requested and reads the SPIR-V file.
+  static Reload ReloadShader(const std::string &compiler,
+                             const ShaderFileOptions &files, bool compile);
+
+  VkDevice device_{VK_NULL_HANDLE};
+  bool hotReload_{false};
+  std::string compiler_{};
+  std::chrono::milliseconds pollInterval_{};
+  std::chrono::steady_clock::time_point lastPoll_{};
+
+  /// Modules by the FNV-1a hash of their code.
+  mutable std::mutex mutex_{};
+  std::unordered_multimap<std::uint64_t, Module> modules_{};
+  ShaderLibraryStats stats_{};
+
+  std::vector<Shader> shaders_{};
+  /// Compiles and reads the changed shaders.
+  ThreadPool reloadThread_{};
+};
+
+} // namespace render
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace render {
+
+/// Non-owning view of a contiguous array, a minimal std::span for C++17.
+///
+/// Upload options take spans, so the data is read in place wherever it
+/// lives, e.g. in a std::vector or a memory mapped file. The viewed memory
+/// has to outlive the span.
+template <typename T> class Span final {
+public:
+  using element_type = T;
+  using value_type = std::remove_cv_t<T>;
+
+  constexpr Span() = default;
+  constexpr Span(T *data, std::size_t size) : data_{data}, size_{size} {}
+
+  /// Views the elements of a contiguous container, e.g. a std::vector or a
+  /// std::array.
+  template <typename Container,
+            typename = std::enable_if_t<std::is_convertible_v<
+                decltype(std::declval<Container &>().data()), T *>>>
+  constexpr Span(Container &container)
+      : data_{container.data()}, size_{container.size()} {}
+
+  /// Converts e.g. Span<T> into Span<const T>.
+  template <typename U,
+            typename = std::enable_if_t<std::is_convertible_v<U *, T *>>>
+  constexpr Span(const Span<U> &other)
+      : data_{other.data()}, size_{other.size()} {}
+
+  constexpr T *data() const { return data_; }
+  constexpr std::size_t size() const { return size_; }
+  constexpr std::size_t size_bytes() const { return size_ * sizeof(T); }
+  constexpr bool empty() const { return size_ == 0; }
+
+  constexpr T *begin() const { return data_; }
+  constexpr T *end() const { return data_ + size_; }
+
+  constexpr T &operator[](std::size_t index) const { return data_[index]; }
+
+private:
+  T *data_{nullptr};
+  std::size_t size_{};
+};
+
+/// Views the bytes of the elements.
+template <typename T> Span<const char> AsBytes(Span<T> span) {
+  return Span<const char>{reinterpret_cast<const char *>(span.data()),
+                          span.size_bytes()};
+}
+
+} // namespace render
@@ -0,0 +1,402 @@
+#include "render/staging_ring.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace render {
+
+namespace {
+
+/// Alignment of the data placed into the ring.
+constexpr VkDeviceSize kStagingAlignment{16U};
+
+/// Accesses that may consume the uploaded buffers.
+constexpr VkAccessFlags kUploadConsumerAccess{
+    VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+    VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT |
+    VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT};
+
+} // namespace
+
+void StagingRing::Initialize(const StagingRingOptions &options) {
+  device_ = options.device;
+  allocator_ = options.allocator;
+  queue_ = options.queue;
+  size_ = options.size;
+
+  // Staging buffer creation:
+  VkBufferCreateInfo bufferInfo{};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = size_;
+  bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create staging buffer!");
+  }
+  VkMemoryRequirements memRequirements;
+  vkGetBufferMemoryRequirements(device_, buffer_, &memRequirements);
+  allocation_ = allocator_->Allocate(memRequirements,
+                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  vkBindBufferMemory(device_, buffer_, allocation_.memory, allocation_.offset);
+
+  // Command buffers are short-lived and re-recorded for every batch:
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                   VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  poolInfo.queueFamilyIndex = options.queueFamilyIndex;
+  if (vkCreateCommandPool(device_, &poolInfo, nullptr, &commandPool_) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create staging command pool!");
+  }
+
+  // Acquire barriers are recorded on the destination queue family:
+  srcQueueFamilyIndex_ = options.queueFamilyIndex;
+  dstQueueFamilyIndex_ = options.dstQueueFamilyIndex;
+  ownershipTransfer_ = srcQueueFamilyIndex_ != dstQueueFamilyIndex_;
+  if (ownershipTransfer_) {
+    poolInfo.queueFamilyIndex = dstQueueFamilyIndex_;
+    if (vkCreateCommandPool(device_, &poolInfo, nullptr,
+                            &acquireCommandPool_) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create acquire command pool!");
+    }
+  }
+
+  if (options.timelineFunctions.IsLoaded()) {
+    TimelineOptions timelineOptions{};
+    timelineOptions.device = device_;
+    timelineOptions.functions = options.timelineFunctions;
+    timeline_.Initialize(timelineOptions);
+  }
+
+  head_ = 0;
+  tail_ = 0;
+}
+
+void StagingRing::Cleanup() {
+  WaitIdle();
+
+  for (const auto &batch : freeBatches_) {
+    vkDestroyFence(device_, batch.fence, nullptr);
+  }
+  freeBatches_.clear();
+  vkDestroyCommandPool(device_, commandPool_, nullptr);
+  commandPool_ = VK_NULL_HANDLE;
+
+  for (const auto &semaphore : pendingSemaphores_) {
+    vkDestroySemaphore(device_, semaphore, nullptr);
+  }
+  pendingSemaphores_.clear();
+  pendingAcquireBarriers_.clear();
+  pendingTimelineValue_ = 0;
+  for (const auto &semaphore : freeSemaphores_) {
+    vkDestroySemaphore(device_, semaphore, nullptr);
+  }
+  freeSemaphores_.clear();
+  freeAcquireCommandBuffers_.clear();
+  if (acquireCommandPool_ != VK_NULL_HANDLE) {
+    vkDestroyCommandPool(device_, acquireCommandPool_, nullptr);
+    acquireCommandPool_ = VK_NULL_HANDLE;
+  }
+  if (timeline_.IsInitialized()) {
+    timeline_.Cleanup();
+  }
+
+  vkDestroyBuffer(device_, buffer_, nullptr);
+  buffer_ = VK_NULL_HANDLE;
+  allocator_->Free(allocation_);
+  allocation_ = Allocation{};
+}
+
+void StagingRing::Upload(VkBuffer dstBuffer, VkDeviceSize dstOffset,
+                         const void *data, VkDeviceSize size) {
+  Retire();
+
+  // Uploads larger than the ring are split into chunks:
+  const auto *bytes = static_cast<const char *>(data);
+  while (size > 0) {
+    const auto chunkSize = std::min(size, size_);
+    const auto offset = Reserve(chunkSize);
+    std::memcpy(static_cast<char *>(allocation_.mappedData) + offset, bytes,
+                static_cast<size_t>(chunkSize));
+
+    BeginBatch();
+    VkBufferCopy copyRegion{};
+    copyRegion.srcOffset = offset;
+    copyRegion.dstOffset = dstOffset;
+    copyRegion.size = chunkSize;
+    vkCmdCopyBuffer(current_.commandBuffer, buffer_, dstBuffer, 1,
+                    &copyRegion);
+    if (ownershipTransfer_) {
+      VkBufferMemoryBarrier release{};
+      release.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+      release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      release.dstAccessMask = 0;
+      release.srcQueueFamilyIndex = srcQueueFamilyIndex_;
+      release.dstQueueFamilyIndex = dstQueueFamilyIndex_;
+      release.buffer = dstBuffer;
+      release.offset = dstOffset;
+      release.size = chunkSize;
+      releaseBarriers_.push_back(release);
+    }
+
+    bytes += chunkSize;
+    dstOffset += chunkSize;
+    size -= chunkSize;
+  }
+}
+
+void StagingRing::Flush() {
+  if (!recording_) {
+    return;
+  }
+
+  VkSemaphore signalSemaphore{VK_NULL_HANDLE};
+  if (ownershipTransfer_) {
+    // Release the buffers to the destination queue family, the memory
+    // dependency is completed by the acquire barriers there:
+    vkCmdPipelineBarrier(
+        current_.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+        static_cast<std::uint32_t>(releaseBarriers_.size()),
+        releaseBarriers_.data(), 0, nullptr);
+    for (auto barrier : releaseBarriers_) {
+      barrier.srcAccessMask = 0;
+      barrier.dstAccessMask = kUploadConsumerAccess;
+      pendingAcquireBarriers_.push_back(barrier);
+    }
+    releaseBarriers_.clear();
+    if (!timeline_.IsInitialized()) {
+      signalSemaphore = AcquireSemaphore();
+      pendingSemaphores_.push_back(signalSemaphore);
+    }
+  } else {
+    // Make the copies visible to everything that may consume the uploaded
+    // buffers later on the queue:
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = kUploadConsumerAccess;
+    vkCmdPipelineBarrier(current_.commandBuffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, kUploadConsumerStages,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+  }
+  if (vkEndCommandBuffer(current_.commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record staging command buffer!");
+  }
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &current_.commandBuffer;
+  if (signalSemaphore != VK_NULL_HANDLE) {
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &signalSemaphore;
+  }
+  VkTimelineSemaphoreSubmitInfoKHR timelineInfo{};
+  if (timeline_.IsInitialized()) {
+    current_.timelineValue = timeline_.Advance();
+    signalSemaphore = timeline_.GetSemaphore();
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &current_.timelineValue;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &signalSemaphore;
+    if (ownershipTransfer_) {
+      pendingTimelineValue_ = current_.timelineValue;
+    }
+  }
+  if (vkQueueSubmit(queue_, 1, &submitInfo, current_.fence) != VK_SUCCESS) {
+    throw std::runtime_error("failed to submit staging command buffer!");
+  }
+
+  current_.end = head_;
+  inFlight_.push_back(current_);
+  current_ = Batch{};
+  recording_ = false;
+}
+
+void StagingRing::Retire() {
+  while (!inFlight_.empty() && IsOldestCompleted()) {
+    WaitOldest();
+  }
+}
+
+void StagingRing::WaitIdle() {
+  Flush();
+  while (!inFlight_.empty()) {
+    WaitOldest();
+  }
+}
+
+StagingRing::UploadAcquire StagingRing::TakeAcquire() {
+  UploadAcquire acquire{};
+  if (pendingAcquireBarriers_.empty()) {
+    return acquire;
+  }
+
+  if (!freeAcquireCommandBuffers_.empty()) {
+    acquire.commandBuffer = freeAcquireCommandBuffers_.back();
+    freeAcquireCommandBuffers_.pop_back();
+  } else {
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = acquireCommandPool_;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(device_, &allocInfo,
+                                 &acquire.commandBuffer) != VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate acquire command buffer!");
+    }
+  }
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (vkBeginCommandBuffer(acquire.commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("failed to begin acquire command buffer!");
+  }
+  // The semaphores are waited at the consumer stages, which chains them with
+  // the acquire barriers:
+  vkCmdPipelineBarrier(
+      acquire.commandBuffer, kUploadConsumerStages, kUploadConsumerStages, 0,
+      0, nullptr, static_cast<std::uint32_t>(pendingAcquireBarriers_.size()),
+      pendingAcquireBarriers_.data(), 0, nullptr);
+  if (vkEndCommandBuffer(acquire.commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record acquire command buffer!");
+  }
+
+  acquire.semaphores = std::move(pendingSemaphores_);
+  pendingSemaphores_.clear();
+  if (pendingTimelineValue_ > 0) {
+    acquire.timelineSemaphore = timeline_.GetSemaphore();
+    acquire.timelineValue = pendingTimelineValue_;
+    pendingTimelineValue_ = 0;
+  }
+  pendingAcquireBarriers_.clear();
+  return acquire;
+}
+
+void StagingRing::RecycleAcquire(UploadAcquire &acquire) {
+  if (acquire.commandBuffer != VK_NULL_HANDLE) {
+    freeAcquireCommandBuffers_.push_back(acquire.commandBuffer);
+  }
+  freeSemaphores_.insert(freeSemaphores_.end(), acquire.semaphores.begin(),
+                         acquire.semaphores.end());
+  acquire = UploadAcquire{};
+}
+
+VkDeviceSize StagingRing::Reserve(VkDeviceSize size) {
+  head_ = (head_ + kStagingAlignment - 1) / kStagingAlignment *
+          kStagingAlignment;
+  // The data must be contiguous, skip the rest of the ring if it doesn't fit:
+  const auto offset = head_ % size_;
+  if (offset + size > size_) {
+    head_ += size_ - offset;
+  }
+
+  while (head_ + size - tail_ > size_) {
+    // The space may still be owned by the batch being recorded:
+    if (inFlight_.empty() && recording_) {
+      Flush();
+    }
+    if (inFlight_.empty()) {
+      tail_ = head_;
+      break;
+    }
+    WaitOldest();
+  }
+
+  const auto reserved = head_ % size_;
+  head_ += size;
+  return reserved;
+}
+
+void StagingRing::WaitOldest() {
+  auto batch = inFlight_.front();
+  inFlight_.pop_front();
+  if (timeline_.IsInitialized()) {
+    timeline_.Wait(batch.timelineValue);
+  } else {
+    vkWaitForFences(device_, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+    vkResetFences(device_, 1, &batch.fence);
+  }
+  tail_ = batch.end;
+  freeBatches_.push_back(batch);
+}
+
+bool StagingRing::IsOldestCompleted() {
+  const auto &batch = inFlight_.front();
+  if (timeline_.IsInitialized()) {
+    return timeline_.IsCompleted(batch.timelineValue);
+  }
+  return vkGetFenceStatus(device_, batch.fence) == VK_SUCCESS;
+}
+
+void StagingRing::BeginBatch() {
+  if (recording_) {
+    return;
+  }
+
+  current_ = AcquireBatch();
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (vkBeginCommandBuffer(current_.commandBuffer, &beginInfo) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to begin staging command buffer!");
+  }
+  recording_ = true;
+}
+
+StagingRing::Batch StagingRing::AcquireBatch() {
+  if (!freeBatches_.empty()) {
+    const auto batch = freeBatches_.back();
+    freeBatches_.pop_back();
+    return batch;
+  }
+
+  Batch batch{};
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.commandPool = commandPool_;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = 1;
+  if (vkAllocateCommandBuffers(device_, &allocInfo, &batch.commandBuffer) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate staging command buffer!");
+  }
+  // The completion of timeline batches is tracked by their values:
+  if (timeline_.IsInitialized()) {
+    return batch;
+  }
+  VkFenceCreateInfo fenceInfo{};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  if (vkCreateFence(device_, &fenceInfo, nullptr, &batch.fence) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create staging fence!");
+  }
+  return batch;
+}
+
+VkSemaphore StagingRing::AcquireSemaphore() {
+  if (!freeSemaphores_.empty()) {
+    const auto semaphore = freeSemaphores_.back();
+    freeSemaphores_.pop_back();
+    return semaphore;
+  }
+
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  VkSemaphore semaphore{VK_NULL_HANDLE};
+  if (vkCreateSemaphore(device_, &semaphoreInfo, nullptr, &semaphore) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create staging semaphore!");
+  }
+  return semaphore;
+}
+
+} // namespace render
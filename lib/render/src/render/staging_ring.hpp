@@ -0,0 +1,177 @@
+#pragma once
+
+#include "render/memory_allocator.hpp"
+#include "render/timeline.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace render {
+
+/// Pipeline stages that may consume the uploaded buffers, transfers included
+/// as buffers are also copied from, e.g. the culling command templates.
+constexpr VkPipelineStageFlags kUploadConsumerStages{
+    VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+    VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT};
+
+struct StagingRingOptions final {
+  VkDevice device{VK_NULL_HANDLE};
+  MemoryAllocator *allocator{nullptr};
+  /// Queue the copies are submitted to and its family.
+  VkQueue queue{VK_NULL_HANDLE};
+  std::uint32_t queueFamilyIndex{};
+  /// Queue family using the uploaded buffers. If it differs from the upload
+  /// queue family, buffer ownership is transferred after every batch.
+  std::uint32_t dstQueueFamilyIndex{};
+  /// Size of the persistently mapped staging memory.
+  VkDeviceSize size{32U * 1024U * 1024U};
+  /// Loaded timeline semaphore functions make the batches signal a timeline
+  /// instead of fences and binary semaphores.
+  TimelineFunctions timelineFunctions{};
+};
+
+/// Persistently mapped staging ring buffer for buffer uploads.
+///
+/// Upload copies the data into the ring and records a copy command into the
+/// current batch command buffer. Flush submits the batch together with a
+/// fence, so there is a single submission for any number of uploads and the
+/// CPU never waits on the queue. The ring space of a batch is reclaimed once
+/// its fence is signaled, the CPU blocks only if the ring wraps onto memory
+/// that is still read by the GPU.
+///
+/// Every batch ends with a memory barrier making the transfer writes visible
+/// to vertex input, shader and indirect reads of later submissions on the same
+/// queue.
+///
+/// When the ring runs on a dedicated transfer queue, batches end with queue
+/// family ownership release barriers and signal a semaphore instead. The
+/// matching acquire barriers are recorded by TakeAcquire into a command buffer
+/// for the destination queue, which has to be submitted waiting on the
+/// semaphores before the uploaded buffers are used.
+///
+/// With timeline semaphores, batch N signals value N of the upload timeline
+/// instead of a fence and a semaphore of its own. The ring space is reclaimed
+/// by comparing the batch values with the counter, and the destination queue
+/// waits on the latest value only, which covers all earlier batches.
+class StagingRing final {
+public:
+  /// Acquire side of the ownership transfers of the flushed batches.
+  struct UploadAcquire final {
+    /// Command buffer with the acquire barriers for the destination queue.
+    VkCommandBuffer commandBuffer{VK_NULL_HANDLE};
+    /// Semaphores signaled by the batches, to be waited at
+    /// kUploadConsumerStages.
+    std::vector<VkSemaphore> semaphores{};
+    /// Upload timeline and the value to be waited at kUploadConsumerStages
+    /// instead of the semaphores, zero if there is none.
+    VkSemaphore timelineSemaphore{VK_NULL_HANDLE};
+    std::uint64_t timelineValue{};
+  };
+
+  /// Creates the staging buffer and the command pool.
+  void Initialize(const StagingRingOptions &options);
+
+  /// Waits for the in-flight batches and destroys the ring resources.
+  void Cleanup();
+
+  /// Schedules an upload into the destination buffer.
+  ///
+  /// @param dstBuffer  Destination buffer, must have TRANSFER_DST usage.
+  /// @param dstOffset  Offset in the destination buffer.
+  /// @param data  Data to upload.
+  /// @param size  Data size in bytes.
+  void Upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void *data,
+              VkDeviceSize size);
+
+  /// Submits the uploads recorded since the last flush, doesn't wait.
+  void Flush();
+
+  /// Reclaims the ring space of completed batches without blocking.
+  void Retire();
+
+  /// Flushes and blocks until all the uploads are completed.
+  void WaitIdle();
+
+  /// Records the acquire barriers of all batches flushed since the last call.
+  ///
+  /// @return Empty UploadAcquire if there is no ownership transfer pending.
+  UploadAcquire TakeAcquire();
+
+  /// Returns the acquire resources once their submission has completed.
+  void RecycleAcquire(UploadAcquire &acquire);
+
+  /// Returns true if uploads transfer the buffer ownership between queues.
+  bool TransfersOwnership() const { return ownershipTransfer_; }
+
+  /// Returns true if the batches signal the upload timeline.
+  bool UsesTimeline() const { return timeline_.IsInitialized(); }
+
+private:
+  struct Batch final {
+    VkCommandBuffer commandBuffer{VK_NULL_HANDLE};
+    /// Fence or upload timeline value signaled by the batch.
+    VkFence fence{VK_NULL_HANDLE};
+    std::uint64_t timelineValue{};
+    /// Ring head right after the data of the batch.
+    std::uint64_t end{};
+  };
+
+  /// Reserves ring space, blocks while the space is in use by the GPU.
+  ///
+  /// @return Ring offset of the reserved space.
+  VkDeviceSize Reserve(VkDeviceSize size);
+
+  /// Waits for the oldest in-flight batch and reclaims its space.
+  void WaitOldest();
+
+  /// Returns true if the oldest in-flight batch has completed.
+  bool IsOldestCompleted();
+
+  /// Begins the recording of the current batch unless it is already begun.
+  void BeginBatch();
+
+  /// Takes a batch from the free list or creates a new one.
+  Batch AcquireBatch();
+
+  /// Takes a semaphore from the free list or creates a new one.
+  VkSemaphore AcquireSemaphore();
+
+  VkDevice device_{VK_NULL_HANDLE};
+  MemoryAllocator *allocator_{nullptr};
+  VkQueue queue_{VK_NULL_HANDLE};
+  VkCommandPool commandPool_{VK_NULL_HANDLE};
+
+  VkBuffer buffer_{VK_NULL_HANDLE};
+  Allocation allocation_{};
+  VkDeviceSize size_{};
+  /// Monotonic write and reclaim positions, the ring offset is position % size.
+  std::uint64_t head_{};
+  std::uint64_t tail_{};
+
+  bool recording_{false};
+  Batch current_{};
+  std::deque<Batch> inFlight_{};
+  std::vector<Batch> freeBatches_{};
+  Timeline timeline_{};
+
+  /// Queue family ownership transfer resources.
+  bool ownershipTransfer_{false};
+  std::uint32_t srcQueueFamilyIndex_{};
+  std::uint32_t dstQueueFamilyIndex_{};
+  VkCommandPool acquireCommandPool_{VK_NULL_HANDLE};
+  /// Release barriers of the batch being recorded.
+  std::vector<VkBufferMemoryBarrier> releaseBarriers_{};
+  /// Acquire barriers and semaphores of the flushed batches.
+  std::vector<VkBufferMemoryBarrier> pendingAcquireBarriers_{};
+  std::vector<VkSemaphore> pendingSemaphores_{};
+  std::uint64_t pendingTimelineValue_{};
+  std::vector<VkSemaphore> freeSemaphores_{};
+  std::vector<VkCommandBuffer> freeAcquireCommandBuffers_{};
+};
+
+} // namespace render
@@ -0,0 +1,40 @@
+#include "render/thread_pool.hpp"
+
+namespace render {
+
+void ThreadPool::Initialize(const ThreadPoolOptions &options) {
+  stopping_ = false;
+  for (std::size_t i{0}; i < options.threadCount; ++i) {
+    threads_.emplace_back([this] { Work(); });
+  }
+}
+
+void ThreadPool::Cleanup() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stopping_ = true;
+  }
+  condition_.notify_all();
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
+}
+
+void ThreadPool::Work() {
+  while (true) {
+    std::function<void()> task{};
+    {
+      std::unique_lock<std::mutex> lock{mutex_};
+      condition_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+      if (tasks_.empty()) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop();
+    }
+    task();
+  }
+}
+
+} // namespace render
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace render {
+
+struct ThreadPoolOptions final {
+  /// Number of worker threads.
+  std::size_t threadCount{1};
+};
+
+/// Fixed-size pool of worker threads executing tasks in submission order.
+///
+/// Tasks never hold Vulkan objects that are externally synchronized (command
+/// pools, descriptor pools) across each other: whoever submits the tasks is
+/// responsible for giving each of them disjoint objects.
+class ThreadPool final {
+public:
+  /// Starts the worker threads.
+  void Initialize(const ThreadPoolOptions &options);
+
+  /// Finishes the queued tasks and joins the worker threads.
+  void Cleanup();
+
+  /// Queues a task.
+  ///
+  /// @param task  Callable without arguments.
+  ///
+  /// @return Future of the task result, rethrows exceptions of the task.
+  template <typename Task>
+  std::future<std::invoke_result_t<Task>> Submit(Task &&task) {
+    using Result = std::invoke_result_t<Task>;
+    auto packagedTask = std::make_shared<std::packaged_task<Result()>>(
+        std::forward<Task>(task));
+    auto future = packagedTask->get_future();
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      tasks_.emplace([packagedTask] { (*packagedTask)(); });
+    }
+    condition_.notify_one();
+    return future;
+  }
+
+  std::size_t GetThreadCount() const { return threads_.size(); }
+
+private:
+  /// Worker thread loop.
+  void Work();
+
+  std::vector<std::thread> threads_{};
+  std::queue<std::function<void()>> tasks_{};
+  std::mutex mutex_{};
+  std::condition_variable condition_{};
+  bool stopping_{false};
+};
+
+} // namespace render
@@ -0,0 +1,61 @@
+#include "render/timeline.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace render {
+
+void Timeline::Initialize(const TimelineOptions &options) {
+  device_ = options.device;
+  functions_ = options.functions;
+  if (!functions_.IsLoaded()) {
+    throw std::runtime_error("failed to load timeline semaphore functions!");
+  }
+
+  VkSemaphoreTypeCreateInfoKHR typeInfo{};
+  typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+  typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+  typeInfo.initialValue = 0;
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreInfo.pNext = &typeInfo;
+  if (vkCreateSemaphore(device_, &semaphoreInfo, nullptr, &semaphore_) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create timeline semaphore!");
+  }
+  pendingValue_ = 0;
+  completedValue_ = 0;
+}
+
+void Timeline::Cleanup() {
+  vkDestroySemaphore(device_, semaphore_, nullptr);
+  semaphore_ = VK_NULL_HANDLE;
+}
+
+std::uint64_t Timeline::GetCompletedValue() {
+  std::uint64_t value{};
+  if (functions_.getSemaphoreCounterValue(device_, semaphore_, &value) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to query timeline semaphore!");
+  }
+  completedValue_ = std::max(completedValue_, value);
+  return completedValue_;
+}
+
+void Timeline::Wait(std::uint64_t value) {
+  if (value <= completedValue_) {
+    return;
+  }
+  VkSemaphoreWaitInfoKHR waitInfo{};
+  waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores = &semaphore_;
+  waitInfo.pValues = &value;
+  if (functions_.waitSemaphores(device_, &waitInfo, UINT64_MAX) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to wait for timeline semaphore!");
+  }
+  completedValue_ = value;
+}
+
+} // namespace render
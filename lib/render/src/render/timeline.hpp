@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+namespace render {
+
+/// Timeline semaphore entry points of VK_KHR_timeline_semaphore or Vulkan
+/// 1.2, loaded with vkGetDeviceProcAddr.
+struct TimelineFunctions final {
+  PFN_vkGetSemaphoreCounterValueKHR getSemaphoreCounterValue{nullptr};
+  PFN_vkWaitSemaphoresKHR waitSemaphores{nullptr};
+
+  bool IsLoaded() const {
+    return getSemaphoreCounterValue != nullptr && waitSemaphores != nullptr;
+  }
+};
+
+struct TimelineOptions final {
+  VkDevice device{VK_NULL_HANDLE};
+  TimelineFunctions functions{};
+};
+
+/// Monotonically increasing GPU counter of the submissions to one queue.
+///
+/// Every submission signals the next value of a single timeline semaphore
+/// instead of a fence of its own. Work is complete once the counter has
+/// reached its value, so the CPU polls or waits for exactly the value it
+/// needs, and there are no fences to reset or recycle.
+///
+/// Signal operations have to execute in increasing value order, so a
+/// timeline is signaled by a single queue only.
+class Timeline final {
+public:
+  /// Creates the timeline semaphore with the counter at 0.
+  void Initialize(const TimelineOptions &options);
+
+  /// Destroys the semaphore, the device has to be idle.
+  void Cleanup();
+
+  /// Returns the value for the next signal operation.
+  std::uint64_t Advance() { return ++pendingValue_; }
+
+  /// Returns the value of the latest signal operation.
+  std::uint64_t GetPendingValue() const { return pendingValue_; }
+
+  /// Returns the current counter value, never blocks.
+  std::uint64_t GetCompletedValue();
+
+  /// Returns true once the counter has reached the value, never blocks.
+  bool IsCompleted(std::uint64_t value) {
+    return value <= completedValue_ || value <= GetCompletedValue();
+  }
+
+  /// Blocks until the counter has reached the value.
+  void Wait(std::uint64_t value);
+
+  VkSemaphore GetSemaphore() const { return semaphore_; }
+
+  bool IsInitialized() const { return semaphore_ != VK_NULL_HANDLE; }
+
+private:
+  VkDevice device_{VK_NULL_HANDLE};
+  TimelineFunctions functions_{};
+  VkSemaphore semaphore_{VK_NULL_HANDLE};
+  std::uint64_t pendingValue_{};
+  /// Latest known counter value, spares the queries of completed values.
+  std::uint64_t completedValue_{};
+};
+
+} // namespace render
@@ -0,0 +1,271 @@
+#include "render/transform_batch.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <future>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) ||                                 \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RENDER_TRANSFORM_SSE
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define RENDER_TRANSFORM_NEON
+#endif
+
+namespace render {
+
+namespace {
+
+using ComponentPointers = std::array<const float *, kTransformComponentCount>;
+
+constexpr std::size_t kMatrixSize{16 * sizeof(float)};
+
+/// Lane types of the kernel: Vector holds one value of kWidth transforms.
+struct ScalarLanes final {
+  using Vector = float;
+  static constexpr std::size_t kWidth{1};
+  static constexpr const char *kName{"Scalar"};
+
+  static Vector Load(const float *data) { return *data; }
+  static Vector Set(float value) { return value; }
+  static Vector Add(Vector lhs, Vector rhs) { return lhs + rhs; }
+  static Vector Sub(Vector lhs, Vector rhs) { return lhs - rhs; }
+  static Vector Mul(Vector lhs, Vector rhs) { return lhs * rhs; }
+
+  /// Stores the matrices, columns[c][r] is row r of column c.
+  static void Store(char *matrices, std::size_t,
+                    const Vector (&columns)[4][4]) {
+    std::memcpy(matrices, columns, kMatrixSize);
+  }
+};
+
+#if defined(__AVX__)
+struct AvxLanes final {
+  using Vector = __m256;
+  static constexpr std::size_t kWidth{8};
+  static constexpr const char *kName{"AVX"};
+
+  static Vector Load(const float *data) { return _mm256_loadu_ps(data); }
+  static Vector Set(float value) { return _mm256_set1_ps(value); }
+  static Vector Add(Vector lhs, Vector rhs) { return _mm256_add_ps(lhs, rhs); }
+  static Vector Sub(Vector lhs, Vector rhs) { return _mm256_sub_ps(lhs, rhs); }
+  static Vector Mul(Vector lhs, Vector rhs) { return _mm256_mul_ps(lhs, rhs); }
+
+  /// Transposes the 4 rows of a column into the columns of the transforms,
+  /// 4 transforms per 128-bit half.
+  static void Store(char *matrices, std::size_t stride,
+                    const Vector (&columns)[4][4]) {
+    for (std::size_t c{0}; c < 4; ++c) {
+      __m128 low[4];
+      __m128 high[4];
+      for (std::size_t r{0}; r < 4; ++r) {
+        low[r] = _mm256_castps256_ps128(columns[c][r]);
+        high[r] = _mm256_extractf128_ps(columns[c][r], 1);
+      }
+      _MM_TRANSPOSE4_PS(low[0], low[1], low[2], low[3]);
+      _MM_TRANSPOSE4_PS(high[0], high[1], high[2], high[3]);
+      for (std::size_t k{0}; k < 4; ++k) {
+        _mm_storeu_ps(reinterpret_cast<float *>(matrices + k * stride) + 4 * c,
+                      low[k]);
+        _mm_storeu_ps(
+            reinterpret_cast<float *>(matrices + (4 + k) * stride) + 4 * c,
+            high[k]);
+      }
+    }
+  }
+};
+using SimdLanes = AvxLanes;
+#elif defined(RENDER_TRANSFORM_SSE)
+struct SseLanes final {
+  using Vector = __m128;
+  static constexpr std::size_t kWidth{4};
+  static constexpr const char *kName{"SSE"};
+
+  static Vector Load(const float *data) { return _mm_loadu_ps(data); }
+  static Vector Set(float value) { return _mm_set1_ps(value); }
+  static Vector Add(Vector lhs, Vector rhs) { return _mm_add_ps(lhs, rhs); }
+  static Vector Sub(Vector lhs, Vector rhs) { return _mm_sub_ps(lhs, rhs); }
+  static Vector Mul(Vector lhs, Vector rhs) { return _mm_mul_ps(lhs, rhs); }
+
+  static void Store(char *matrices, std::size_t stride,
+                    const Vector (&columns)[4][4]) {
+    for (std::size_t c{0}; c < 4; ++c) {
+      auto r0 = columns[c][0];
+      auto r1 = columns[c][1];
+      auto r2 = columns[c][2];
+      auto r3 = columns[c][3];
+      _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+      _mm_storeu_ps(reinterpret_cast<float *>(matrices) + 4 * c, r0);
+      _mm_storeu_ps(reinterpret_cast<float *>(matrices + stride) + 4 * c, r1);
+      _mm_storeu_ps(reinterpret_cast<float *>(matrices + 2 * stride) + 4 * c,
+                    r2);
+      _mm_storeu_ps(reinterpret_cast<float *>(matrices + 3 * stride) + 4 * c,
+                    r3);
+    }
+  }
+};
+using SimdLanes = SseLanes;
+#elif defined(RENDER_TRANSFORM_NEON)
+struct NeonLanes final {
+  using Vector = float32x4_t;
+  static constexpr std::size_t kWidth{4};
+  static constexpr const char *kName{"NEON"};
+
+  static Vector Load(const float *data) { return vld1q_f32(data); }
+  static Vector Set(float value) { return vdupq_n_f32(value); }
+  static Vector Add(Vector lhs, Vector rhs) { return vaddq_f32(lhs, rhs); }
+  static Vector Sub(Vector lhs, Vector rhs) { return vsubq_f32(lhs, rhs); }
+  static Vector Mul(Vector lhs, Vector rhs) { return vmulq_f32(lhs, rhs); }
+
+  static void Store(char *matrices, std::size_t stride,
+                    const Vector (&columns)[4][4]) {
+    for (std::size_t c{0}; c < 4; ++c) {
+      // Two rounds of zips transpose the 4 x 4 block:
+      const auto even = vzipq_f32(columns[c][0], columns[c][2]);
+      const auto odd = vzipq_f32(columns[c][1], columns[c][3]);
+      const auto low = vzipq_f32(even.val[0], odd.val[0]);
+      const auto high = vzipq_f32(even.val[1], odd.val[1]);
+      vst1q_f32(reinterpret_cast<float *>(matrices) + 4 * c, low.val[0]);
+      vst1q_f32(reinterpret_cast<float *>(matrices + stride) + 4 * c,
+                low.val[1]);
+      vst1q_f32(reinterpret_cast<float *>(matrices + 2 * stride) + 4 * c,
+                high.val[0]);
+      vst1q_f32(reinterpret_cast<float *>(matrices + 3 * stride) + 4 * c,
+                high.val[1]);
+    }
+  }
+};
+using SimdLanes = NeonLanes;
+#else
+using SimdLanes = ScalarLanes;
+#endif
+
+/// Writes the matrices of [first, end) in steps of Lanes::kWidth.
+///
+/// @return First transform of the remainder that doesn't fill the lanes.
+template <typename Lanes>
+std::size_t WriteLanes(const ComponentPointers &components, std::size_t first,
+                       std::size_t end, char *matrices, std::size_t stride) {
+  using L = Lanes;
+  const auto zero = L::Set(0.0f);
+  const auto one = L::Set(1.0f);
+  auto i = first;
+  for (; i + L::kWidth <= end; i += L::kWidth) {
+    const auto load = [&components, i](TransformComponent component) {
+      return L::Load(components[static_cast<std::size_t>(component)] + i);
+    };
+    const auto x = load(TransformComponent::RotationX);
+    const auto y = load(TransformComponent::RotationY);
+    const auto z = load(TransformComponent::RotationZ);
+    const auto w = load(TransformComponent::RotationW);
+    const auto scaleX = load(TransformComponent::ScaleX);
+    const auto scaleY = load(TransformComponent::ScaleY);
+    const auto scaleZ = load(TransformComponent::ScaleZ);
+
+    // Rotation matrix of the unit quaternion, the products are doubled:
+    const auto x2 = L::Add(x, x);
+    const auto y2 = L::Add(y, y);
+    const auto z2 = L::Add(z, z);
+    const auto xx = L::Mul(x, x2);
+    const auto yy = L::Mul(y, y2);
+    const auto zz = L::Mul(z, z2);
+    const auto xy = L::Mul(x, y2);
+    const auto xz = L::Mul(x, z2);
+    const auto yz = L::Mul(y, z2);
+    const auto wx = L::Mul(w, x2);
+    const auto wy = L::Mul(w, y2);
+    const auto wz = L::Mul(w, z2);
+
+    const typename L::Vector columns[4][4]{
+        {L::Mul(L::Sub(one, L::Add(yy, zz)), scaleX),
+         L::Mul(L::Add(xy, wz), scaleX), L::Mul(L::Sub(xz, wy), scaleX), zero},
+        {L::Mul(L::Sub(xy, wz), scaleY),
+         L::Mul(L::Sub(one, L::Add(xx, zz)), scaleY),
+         L::Mul(L::Add(yz, wx), scaleY), zero},
+        {L::Mul(L::Add(xz, wy), scaleZ), L::Mul(L::Sub(yz, wx), scaleZ),
+         L::Mul(L::Sub(one, L::Add(xx, yy)), scaleZ), zero},
+        {load(TransformComponent::PositionX),
+         load(TransformComponent::PositionY),
+         load(TransformComponent::PositionZ), one}};
+    L::Store(matrices + i * stride, stride, columns);
+  }
+  return i;
+}
+
+} // namespace
+
+void TransformBatch::Reserve(std::size_t count) {
+  for (auto &component : components_) {
+    component.reserve(count);
+  }
+}
+
+void TransformBatch::Clear() {
+  for (auto &component : components_) {
+    component.clear();
+  }
+}
+
+std::uint32_t TransformBatch::Add(const glm::vec3 &position,
+                                  const glm::quat &rotation,
+                                  const glm::vec3 &scale) {
+  const auto index = static_cast<std::uint32_t>(GetSize());
+  for (auto &component : components_) {
+    component.emplace_back();
+  }
+  Set(index, position, rotation, scale);
+  return index;
+}
+
+void TransformBatch::Set(std::uint32_t index, const glm::vec3 &position,
+                         const glm::quat &rotation, const glm::vec3 &scale) {
+  const float values[kTransformComponentCount]{
+      position.x, position.y, position.z, rotation.x, rotation.y,
+      rotation.z, rotation.w, scale.x,    scale.y,    scale.z};
+  for (std::size_t i{0}; i < kTransformComponentCount; ++i) {
+    components_[i][index] = values[i];
+  }
+}
+
+void TransformBatch::Write(const TransformWriteOptions &options) const {
+  const auto size = GetSize();
+  if (options.threads == nullptr || options.chunkSize == 0 ||
+      size <= options.chunkSize) {
+    WriteRange(options, 0, size);
+    return;
+  }
+
+  // The calling thread writes the first chunk while the others are queued:
+  std::vector<std::future<void>> chunks{};
+  for (auto first = options.chunkSize; first < size;
+       first += options.chunkSize) {
+    const auto end = std::min(first + options.chunkSize, size);
+    chunks.push_back(options.threads->Submit(
+        [this, &options, first, end] { WriteRange(options, first, end); }));
+  }
+  WriteRange(options, 0, options.chunkSize);
+  for (auto &chunk : chunks) {
+    chunk.get();
+  }
+}
+
+const char *TransformBatch::GetSimdName() { return SimdLanes::kName; }
+
+void TransformBatch::WriteRange(const TransformWriteOptions &options,
+                                std::size_t first, std::size_t end) const {
+  ComponentPointers components{};
+  for (std::size_t i{0}; i < kTransformComponentCount; ++i) {
+    components[i] = components_[i].data();
+  }
+  auto matrices = static_cast<char *>(options.matrices);
+  if (options.simd) {
+    first = WriteLanes<SimdLanes>(components, first, end, matrices,
+                                  options.stride);
+  }
+  WriteLanes<ScalarLanes>(components, first, end, matrices, options.stride);
+}
+
+} // namespace render
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "render/span.hpp"
+#include "render/thread_pool.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace render {
+
+/// Arrays of a TransformBatch, one float per transform each.
+enum class TransformComponent : std::uint8_t {
+  PositionX,
+  PositionY,
+  PositionZ,
+  /// Unit quaternion.
+  RotationX,
+  RotationY,
+  RotationZ,
+  RotationW,
+  ScaleX,
+  ScaleY,
+  ScaleZ
+};
+
+constexpr std::size_t kTransformComponentCount{10};
+
+struct TransformWriteOptions final {
+  /// Matrix of the first transform, e.g. the model of the first InstanceData
+  /// in mapped memory.
+  void *matrices{nullptr};
+  /// Bytes from one matrix to the next, e.g. sizeof(InstanceData).
+  std::size_t stride{sizeof(glm::mat4)};
+  /// Threads writing chunks of the batch in parallel with the calling
+  /// thread, nullptr writes everything on the calling thread.
+  ThreadPool *threads{nullptr};
+  /// Transforms per chunk, smaller batches are never split and 0 never
+  /// splits.
+  std::size_t chunkSize{16384};
+  /// Uses the SIMD kernel, false runs the scalar kernel for comparison.
+  bool simd{true};
+};
+
+/// Positions, rotations and scales of many objects in structure-of-arrays
+/// layout.
+///
+/// Write turns them into column-major model matrices T * R * S, the same as
+/// glm::translate, glm::mat4_cast and glm::scale. Every component is a
+/// separate float array, so the kernel loads the components of 4 (SSE,
+/// NEON) or 8 (AVX) transforms with one load each and computes the matrices
+/// of all of them at once. The matrices are transposed into place and
+/// stored with unaligned stores at any stride, straight into the mapped
+/// instance data or uniform ring. The SIMD kernel is chosen at compile time
+/// from the enabled instruction sets, AVX needs e.g. -mavx.
+class TransformBatch final {
+public:
+  void Reserve(std::size_t count);
+
+  /// Removes all transforms.
+  void Clear();
+
+  /// @return Index of the transform.
+  std::uint32_t Add(const glm::vec3 &position, const glm::quat &rotation,
+                    const glm::vec3 &scale);
+
+  void Set(std::uint32_t index, const glm::vec3 &position,
+           const glm::quat &rotation, const glm::vec3 &scale);
+
+  std::size_t GetSize() const { return components_[0].size(); }
+
+  /// Returns a component array, e.g. to animate all positions in one loop.
+  Span<float> GetComponent(TransformComponent component) {
+    return components_[static_cast<std::size_t>(component)];
+  }
+  Span<const float> GetComponent(TransformComponent component) const {
+    return components_[static_cast<std::size_t>(component)];
+  }
+
+  /// Writes the model matrices of all transforms.
+  void Write(const TransformWriteOptions &options) const;
+
+  /// Returns the instruction set of the SIMD kernel, "Scalar" if there is
+  /// none.
+  static const char *GetSimdName();
+
+private:
+  /// Writes the matrices of the transforms [first, end).
+  void WriteRange(const TransformWriteOptions &options, std::size_t first,
+                  std::size_t end) const;
+
+  std::array<std::vector<float>, kTransformComponentCount> components_{};
+};
+
+} // namespace render
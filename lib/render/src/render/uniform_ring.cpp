@@ -0,0 +1,76 @@
+#include "render/uniform_ring.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace render {
+
+namespace {
+
+VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+void UniformRing::Initialize(const UniformRingOptions &options) {
+  device_ = options.device;
+  allocator_ = options.allocator;
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(options.physicalDevice, &properties);
+  alignment_ = std::max<VkDeviceSize>(
+      properties.limits.minUniformBufferOffsetAlignment, 1);
+  frameSize_ = AlignUp(options.frameSize, alignment_);
+
+  VkBufferCreateInfo bufferInfo{};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = frameSize_ * options.frameCount;
+  bufferInfo.usage =
+      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create uniform ring buffer!");
+  }
+  VkMemoryRequirements memRequirements;
+  vkGetBufferMemoryRequirements(device_, buffer_, &memRequirements);
+  allocation_ = allocator_->Allocate(memRequirements,
+                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  vkBindBufferMemory(device_, buffer_, allocation_.memory, allocation_.offset);
+
+  frameOffset_ = 0;
+  head_ = 0;
+}
+
+void UniformRing::Cleanup() {
+  vkDestroyBuffer(device_, buffer_, nullptr);
+  buffer_ = VK_NULL_HANDLE;
+  allocator_->Free(allocation_);
+  allocation_ = Allocation{};
+}
+
+void UniformRing::BeginFrame(std::uint32_t frameIndex) {
+  frameOffset_ = frameSize_ * frameIndex;
+  head_ = 0;
+}
+
+UniformAllocation UniformRing::Allocate(VkDeviceSize size) {
+  const auto offset = AlignUp(head_, alignment_);
+  if (offset + size > frameSize_) {
+    throw std::runtime_error("failed to push uniform data, frame is full!");
+  }
+  head_ = offset + size;
+  return UniformAllocation{static_cast<char *>(allocation_.mappedData) +
+                               frameOffset_ + offset,
+                           static_cast<std::uint32_t>(frameOffset_ + offset)};
+}
+
+std::uint32_t UniformRing::Push(const void *data, VkDeviceSize size) {
+  const auto allocation = Allocate(size);
+  std::memcpy(allocation.data, data, static_cast<size_t>(size));
+  return allocation.offset;
+}
+
+} // namespace render
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "render/memory_allocator.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+namespace render {
+
+/// Space of the current frame slice, written in place.
+struct UniformAllocation final {
+  void *data{nullptr};
+  /// Offset in the ring buffer, the dynamic or vertex buffer offset.
+  std::uint32_t offset{};
+};
+
+struct UniformRingOptions final {
+  VkPhysicalDevice physicalDevice{VK_NULL_HANDLE};
+  VkDevice device{VK_NULL_HANDLE};
+  MemoryAllocator *allocator{nullptr};
+  /// Number of frame slices, one per frame in flight.
+  std::uint32_t frameCount{};
+  /// Size of the uniform data a single frame may push.
+  VkDeviceSize frameSize{4U * 1024U * 1024U};
+};
+
+/// Persistently mapped uniform buffer split into one slice per frame in
+/// flight.
+///
+/// Push copies the data into the slice of the current frame and returns its
+/// offset in the buffer, aligned to minUniformBufferOffsetAlignment. A single
+/// VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptor covers the whole
+/// buffer and every draw selects its data with the dynamic offset, so any
+/// number of objects share one descriptor set. A slice is rewritten only
+/// after the fence of its frame is signaled.
+class UniformRing final {
+public:
+  /// Creates and maps the ring buffer.
+  void Initialize(const UniformRingOptions &options);
+
+  /// Destroys the ring buffer.
+  void Cleanup();
+
+  /// Starts writing into the slice of the frame.
+  void BeginFrame(std::uint32_t frameIndex);
+
+  /// Reserves space in the current frame slice, e.g. for data computed
+  /// straight into the mapped memory. The ring buffer is a vertex buffer as
+  /// well, so per-instance data of the frame can live in it.
+  UniformAllocation Allocate(VkDeviceSize size);
+
+  /// Copies the data into the current frame slice.
+  ///
+  /// @return Dynamic offset of the data.
+  std::uint32_t Push(const void *data, VkDeviceSize size);
+
+  template <typename T> std::uint32_t Push(const T &data) {
+    return Push(&data, sizeof(T));
+  }
+
+  VkBuffer GetBuffer() const { return buffer_; }
+
+  VkDeviceSize GetAlignment() const { return alignment_; }
+
+private:
+  VkDevice device_{VK_NULL_HANDLE};
+  MemoryAllocator *allocator_{nullptr};
+  VkBuffer buffer_{VK_NULL_HANDLE};
+  Allocation allocation_{};
+  VkDeviceSize alignment_{};
+  VkDeviceSize frameSize_{};
+  /// Current frame slice start and write position in it.
+  VkDeviceSize frameOffset_{};
+  VkDeviceSize head_{};
+};
+
+} // namespace render
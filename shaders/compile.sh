@@ -1,4 +1,8 @@
 #!/bin/bash
 
 glslc shader.vert -o ./vert.spv
+glslc shader_instanced.vert -o ./vert_instanced.spv
+glslc shader_push.vert -o ./vert_push.spv
+glslc shader_bindless.vert -o ./vert_bindless.spv
 glslc shader.frag -o ./frag.spv
+glslc shader_cull.comp -o ./cull.spv
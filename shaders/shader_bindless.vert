@@ -0,0 +1,37 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+  mat4 model;
+  mat4 view;
+  mat4 proj;
+} ubo;
+
+struct InstanceData {
+  mat4 model;
+  vec4 color;
+};
+
+// Storage buffers of the bindless set, the instances of the draws are in the
+// buffer selected by the push constant:
+layout(set = 1, binding = 0) readonly buffer InstanceBuffer {
+  InstanceData instances[];
+} buffers[];
+
+layout(push_constant) uniform PushConstants {
+  uint instanceBuffer;
+} pushConstants;
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+  // gl_InstanceIndex includes the first instance of the draw:
+  InstanceData instance =
+      buffers[pushConstants.instanceBuffer].instances[gl_InstanceIndex];
+  gl_Position = ubo.proj * ubo.view * ubo.model * instance.model *
+                vec4(inPosition, 0.0, 1.0);
+  fragColor = inColor * instance.color.rgb;
+}
@@ -0,0 +1,21 @@
+#version 450
+
+layout(binding = 0) uniform UniformBufferObject {
+  mat4 model;
+  mat4 view;
+  mat4 proj;
+} ubo;
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+// Per-instance attributes, the mat4 takes locations 2-5.
+layout(location = 2) in mat4 inInstanceModel;
+layout(location = 6) in vec4 inInstanceColor;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+  gl_Position = ubo.proj * ubo.view * ubo.model * inInstanceModel *
+                vec4(inPosition, 0.0, 1.0);
+  fragColor = inColor * inInstanceColor.rgb;
+}
@@ -0,0 +1,23 @@
+#version 450
+
+// The model matrix of the uniform buffer is ignored, it is pushed per draw.
+layout(binding = 0) uniform UniformBufferObject {
+  mat4 model;
+  mat4 view;
+  mat4 proj;
+} ubo;
+
+layout(push_constant) uniform PushConstants {
+  mat4 model;
+} pushConstants;
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+  gl_Position = ubo.proj * ubo.view * pushConstants.model *
+                vec4(inPosition, 0.0, 1.0);
+  fragColor = inColor;
+}